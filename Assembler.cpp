@@ -0,0 +1,1702 @@
+#include "Assembler.hpp"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <regex>
+#include <sstream>
+
+static const std::string hexNumbers = "0123456789abcdef";
+
+struct InstructionData
+{
+    std::string name;
+    int argumentCount;
+    Instruction instruction;
+};
+
+static const std::vector<std::string> AssembleDataOperationKeywords = {
+    "times", "db", "dw"};
+
+static const std::map<std::string, DataSize> DataStoreSizeKeywords = {
+    {"db", DataSize::Byte},
+    {"dw", DataSize::Word}};
+
+static const std::map<std::string, Instruction> Instructions = {
+    {"nop", Instruction::None},
+    {"call", Instruction::Call},
+    {"mov", Instruction::Move},
+    {"jmp", Instruction::Jump},
+    {"goto", Instruction::Jump},
+    {"hlt", Instruction::Halt},
+    {"end", Instruction::Halt},
+    {"ret", Instruction::Return},
+    {"draw", Instruction::Draw},
+    {"mem", Instruction::SetMemory},
+    {"clear", Instruction::Clear},
+    {"in", Instruction::In},
+    {"add", Instruction::Add},
+    {"sub", Instruction::Sub},
+    {"or", Instruction::Or},
+    {"and", Instruction::And},
+    {"xor", Instruction::Xor},
+    {"ror", Instruction::RotateRight},
+    {"rol", Instruction::RotateLeft},
+    {"eq", Instruction::Equals},
+    {"neq", Instruction::NotEquals},
+    {"keydown", Instruction::KeyPressed},
+    {"keyup", Instruction::KeyNotPressed},
+    {"memadd", Instruction::MemAdd},
+    {"beep", Instruction::SetAudioTimer},
+    {"settimer", Instruction::SetTimer},
+    {"gettimer", Instruction::GetTimer},
+    {"render", Instruction::Render},
+};
+
+ExpressionEvaluator::ExpressionEvaluator(std::string const &expression, int64_t currentAddress, SymbolLookup const &lookup, size_t column, size_t row)
+    : m_expression(expression), m_currentAddress(currentAddress), m_lookup(lookup), m_column(column), m_row(row)
+{
+}
+
+std::optional<int64_t> ExpressionEvaluator::evaluate()
+{
+    m_position = 0;
+    m_unresolved = false;
+    m_usesSymbols = false;
+    const int64_t value = parseBinaryOperation(0);
+    skipWhitespace();
+    if (m_position != m_expression.size())
+    {
+        throw AssemblingError(m_column + m_position, m_row, "Unexpected symbol in expression");
+    }
+    if (m_unresolved)
+    {
+        return {};
+    }
+    return value;
+}
+
+int64_t ExpressionEvaluator::parseBinaryOperation(size_t level)
+{
+    static const std::vector<std::vector<std::string>> OperatorPrecedence = {
+        {"|"}, {"^"}, {"&"}, {"<<", ">>"}, {"+", "-"}, {"*", "/", "%"}};
+    if (level == OperatorPrecedence.size())
+    {
+        return parseUnary();
+    }
+    int64_t left = parseBinaryOperation(level + 1);
+    while (true)
+    {
+        skipWhitespace();
+        std::optional<std::string> op = parseOperator(OperatorPrecedence[level]);
+        if (!op.has_value())
+        {
+            return left;
+        }
+        const size_t operatorColumn = m_column + m_position;
+        const int64_t right = parseBinaryOperation(level + 1);
+        left = applyOperator(op.value(), left, right, operatorColumn);
+    }
+}
+
+int64_t ExpressionEvaluator::applyOperator(std::string const &op, int64_t left, int64_t right, size_t column)
+{
+    if ((op == "/" || op == "%") && right == 0)
+    {
+        if (m_unresolved)
+        {
+            return 0;
+        }
+        throw AssemblingError(column, m_row, "Division by zero in expression");
+    }
+    if ((op == "<<" || op == ">>") && (right < 0 || right > 31))
+    {
+        if (m_unresolved)
+        {
+            return 0;
+        }
+        throw AssemblingError(column, m_row, "Shift amount must be between 0 and 31");
+    }
+    switch (op[0])
+    {
+    case '|':
+        return left | right;
+    case '^':
+        return left ^ right;
+    case '&':
+        return left & right;
+    case '<':
+        return left << right;
+    case '>':
+        return left >> right;
+    case '+':
+        return left + right;
+    case '-':
+        return left - right;
+    case '*':
+        return left * right;
+    case '/':
+        return left / right;
+    default:
+        return left % right;
+    }
+}
+
+int64_t ExpressionEvaluator::parseUnary()
+{
+    skipWhitespace();
+    if (m_position == m_expression.size())
+    {
+        throw AssemblingError(m_column + m_position, m_row, "Unexpected end of expression");
+    }
+    switch (m_expression[m_position])
+    {
+    case '-':
+        m_position++;
+        return -parseUnary();
+    case '+':
+        m_position++;
+        return parseUnary();
+    case '~':
+        m_position++;
+        return ~parseUnary();
+    }
+    return parsePrimary();
+}
+
+int64_t ExpressionEvaluator::parsePrimary()
+{
+    const char c = m_expression[m_position];
+    if (c == '(')
+    {
+        m_position++;
+        const int64_t value = parseBinaryOperation(0);
+        skipWhitespace();
+        if (m_position == m_expression.size() || m_expression[m_position] != ')')
+        {
+            throw AssemblingError(m_column + m_position, m_row, "Expected closing parenthesis");
+        }
+        m_position++;
+        return value;
+    }
+    if (c == '$')
+    {
+        m_position++;
+        m_usesSymbols = true;
+        return m_currentAddress;
+    }
+    if (std::isdigit(c))
+    {
+        return parseNumber();
+    }
+    if (std::isalpha(c) || c == '_')
+    {
+        std::string name;
+        for (; m_position < m_expression.size() && (std::isalnum(m_expression[m_position]) || m_expression[m_position] == '_'); m_position++)
+        {
+            name += m_expression[m_position];
+        }
+        m_usesSymbols = true;
+        if (std::optional<int64_t> value = m_lookup(name); value.has_value())
+        {
+            return value.value();
+        }
+        m_unresolved = true;
+        return 0;
+    }
+    throw AssemblingError(m_column + m_position, m_row, "Expected a number, label or expression");
+}
+
+int64_t ExpressionEvaluator::parseNumber()
+{
+    const size_t start = m_position;
+    int base = 10;
+    if (m_expression[m_position] == '0' && m_position + 1 < m_expression.size())
+    {
+        if (m_expression[m_position + 1] == 'x')
+        {
+            base = 16;
+            m_position += 2;
+        }
+        else if (m_expression[m_position + 1] == 'b')
+        {
+            base = 2;
+            m_position += 2;
+        }
+    }
+    int64_t value = 0;
+    size_t digits = 0;
+    for (; m_position < m_expression.size() && std::isalnum(m_expression[m_position]); m_position++, digits++)
+    {
+        const char c = std::tolower(m_expression[m_position]);
+        const int digit = std::isdigit(c) ? c - '0' : c - 'a' + 10;
+        if (digit >= base)
+        {
+            throw AssemblingError(m_column + m_position, m_row, "Invalid digit in number");
+        }
+        value = value * base + digit;
+        if (value > std::numeric_limits<uint32_t>::max())
+        {
+            throw AssemblingError(m_column + start, m_row, "Constant number is too large");
+        }
+    }
+    if (digits == 0)
+    {
+        throw AssemblingError(m_column + m_position, m_row, "Expected digits after number prefix");
+    }
+    return value;
+}
+
+std::optional<std::string> ExpressionEvaluator::parseOperator(std::vector<std::string> const &operators)
+{
+    for (std::string const &op : operators)
+    {
+        if (m_expression.compare(m_position, op.size(), op) == 0)
+        {
+            m_position += op.size();
+            return op;
+        }
+    }
+    return {};
+}
+
+void ExpressionEvaluator::skipWhitespace()
+{
+    for (; m_position < m_expression.size() && m_expression[m_position] == ' '; m_position++)
+        ;
+}
+
+Assembler::Assembler(std::vector<CodeLine> const &code) : m_code(code)
+{
+}
+
+void Assembler::parse()
+{
+
+    for (size_t lineIndex = 0; lineIndex < m_code.size(); lineIndex++)
+    {
+        m_currentLineNumber = m_code[lineIndex].sourceLine;
+        m_begin = m_code[lineIndex].text.begin();
+        m_current = m_code[lineIndex].text.begin();
+        m_end = m_code[lineIndex].text.end();
+        m_lineAddress = m_bytes.size();
+        const size_t lineStart = m_bytes.size();
+
+        skipWhitespace();
+        if (m_code[lineIndex].text.size() == 0)
+        {
+            continue;
+        }
+        std::optional<std::string> label = parseLabel();
+        if (label.has_value())
+        {
+            m_labelPositions[label.value()] = m_bytes.size();
+        }
+        skipWhitespace();
+
+        if (m_current == m_end)
+        {
+            continue;
+        }
+        if (tryDataOperation())
+        {
+            assembleDataOperations();
+            recordItem(lineStart, false);
+            continue;
+        }
+        std::optional<Instruction> instruction = parseInstruction();
+        if (!instruction.has_value())
+        {
+            throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Excepted an instruction");
+        }
+        switch (instruction.value())
+        {
+        case Instruction::None:
+            m_bytes.push_back(0);
+            break;
+        case Instruction::Move:
+        {
+            assembleMoveOperation();
+            break;
+        }
+        case Instruction::Clear:
+        {
+            m_bytes.push_back(0x00);
+            m_bytes.push_back(0xe0);
+            expectLineEnd();
+            break;
+        }
+        case Instruction::Render:
+        {
+            m_bytes.push_back(0x00);
+            m_bytes.push_back(0xe2);
+            expectLineEnd();
+            break;
+        }
+        case Instruction::Draw:
+        {
+            assembleDraw();
+            break;
+        }
+        case Instruction::SetMemory:
+        {
+            assembleAddressInstruction(0xA);
+            break;
+        }
+        case Instruction::Jump:
+        {
+            assembleAddressInstruction(0x1);
+            break;
+        }
+        case Instruction::Call:
+        {
+            assembleAddressInstruction(0x2);
+            break;
+        }
+
+        case Instruction::Return:
+        {
+            m_bytes.push_back(0x00);
+            m_bytes.push_back(0xee);
+            expectLineEnd();
+            break;
+        }
+        case Instruction::Add:
+        {
+            assembleAddOperation();
+
+            break;
+        }
+        case Instruction::Sub:
+        {
+            assembleMathOperations(0x5);
+            break;
+        }
+        case Instruction::Or:
+        {
+            assembleMathOperations(0x1);
+            break;
+        }
+        case Instruction::And:
+        {
+            assembleMathOperations(0x2);
+            break;
+        }
+        case Instruction::Xor:
+        {
+            assembleMathOperations(0x3);
+            break;
+        }
+        case Instruction::RotateRight:
+        {
+            assembleMathOperations(0x6);
+            break;
+        }
+        case Instruction::RotateLeft:
+        {
+            assembleMathOperations(0x8);
+            break;
+        }
+        case Instruction::Equals:
+        {
+            assembleEqualsOperation(0x3, 0x5);
+            break;
+        }
+        case Instruction::NotEquals:
+        {
+            assembleEqualsOperation(0x4, 0x9);
+            break;
+        }
+        case Instruction::KeyPressed:
+        {
+            assembleCheckKeyPress(0x9e);
+            break;
+        }
+        case Instruction::KeyNotPressed:
+        {
+            assembleCheckKeyPress(0xa1);
+            break;
+        }
+        case Instruction::In:
+        {
+            skipWhitespace();
+            if (std::optional<size_t> registerId = parseRegister(); registerId.has_value())
+            {
+                m_bytes.push_back(0xF0 | registerId.value());
+                m_bytes.push_back(0x0a);
+                expectLineEnd();
+            }
+            else
+            {
+                throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Expected destination register");
+            }
+
+            break;
+        }
+        case Instruction::MemAdd:
+        {
+            assembleSingleRegisterSpecials(0x1e);
+            break;
+        }
+        case Instruction::SetAudioTimer:
+        {
+            assembleSingleRegisterSpecials(0x18);
+            break;
+        }
+        case Instruction::GetTimer:
+        {
+            assembleSingleRegisterSpecials(0x07);
+            break;
+        }
+        case Instruction::SetTimer:
+        {
+            assembleSingleRegisterSpecials(0x15);
+            break;
+        }
+        case Instruction::Halt:
+        {
+            m_bytes.push_back(0x00);
+            m_bytes.push_back(0xe1);
+            expectLineEnd();
+            break;
+        }
+        default:
+            throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Unknown instruction");
+        }
+        // nop is a single byte and can't be treated as an instruction by the optimizer
+        recordItem(lineStart, m_bytes.size() - lineStart == 2);
+    }
+
+    if (m_optimizationEnabled)
+    {
+        optimize();
+    }
+
+    for (Fixup const &fixup : m_fixups)
+    {
+        ExpressionEvaluator evaluator(fixup.expression, fixup.origin, getLabelLookup(), fixup.column, fixup.row);
+        std::optional<int64_t> value = evaluator.evaluate();
+        if (!value.has_value())
+        {
+            throw AssemblingError(fixup.column, fixup.row, "Unknown label used");
+        }
+        writeValue(checkRange(value.value(), fixup.type, fixup.column, fixup.row), fixup.type, fixup.position);
+    }
+}
+
+SymbolTable Assembler::getSymbols(std::string const &sourceName) const
+{
+    SymbolTable table;
+    table.setSourceName(sourceName);
+    for (std::pair<const std::string, size_t> const &label : m_labelPositions)
+    {
+        table.addLabel(label.second, label.first);
+    }
+    std::optional<size_t> previousLine;
+    for (EmittedItem const &item : m_items)
+    {
+        if (item.sourceLine != previousLine)
+        {
+            table.addLine(item.offset, item.sourceLine + 1);
+            previousLine = item.sourceLine;
+        }
+    }
+    return table;
+}
+
+void Assembler::recordItem(size_t offset, bool isInstruction)
+{
+    if (m_bytes.size() > offset)
+    {
+        m_items.push_back(EmittedItem{offset, m_bytes.size() - offset, isInstruction, m_currentLineNumber});
+    }
+}
+
+void Assembler::optimize()
+{
+    const size_t maxPasses = 16;
+    m_removedInstructionCount = 0;
+    m_optimizationSkipReason = findOptimizationBlocker();
+    if (m_optimizationSkipReason.has_value())
+    {
+        return;
+    }
+    m_labeledItems.assign(m_items.size(), false);
+    m_protectedItems.assign(m_items.size(), false);
+    for (std::pair<const std::string, size_t> const &label : m_labelPositions)
+    {
+        if (std::optional<size_t> item = findItemAt(label.second); item.has_value())
+        {
+            m_labeledItems[item.value()] = true;
+        }
+    }
+    for (size_t i = 1; i < m_items.size(); i++)
+    {
+        // instruction after a skip must stay in place and keep its size, otherwise the skip lands somewhere else
+        m_protectedItems[i] = m_items[i - 1].isInstruction && isSkipInstruction(getOpcode(i - 1));
+    }
+
+    for (size_t pass = 0; pass < maxPasses; pass++)
+    {
+        bool changed = threadJumps();
+        changed |= removeJumpsToNext();
+        changed |= foldAdds();
+        changed |= removeDeadMoves();
+        changed |= replaceTailCalls();
+        if (!changed)
+        {
+            break;
+        }
+    }
+    relocate();
+}
+
+std::optional<std::string> Assembler::findOptimizationBlocker()
+{
+    for (size_t i = 0; i < m_items.size(); i++)
+    {
+        if (!m_items[i].isInstruction)
+        {
+            continue;
+        }
+        const uint16_t opcode = getOpcode(i);
+        const uint8_t type = (opcode & 0xf000) >> 12;
+        Fixup const *fixup = findFixup(m_items[i].offset);
+        if ((type == 0x1 || type == 0x2 || type == 0xA) && fixup == nullptr && (opcode & 0x0fff) < m_bytes.size())
+        {
+            return "literal address used at line " + std::to_string(m_items[i].sourceLine + 1);
+        }
+        for (size_t position = m_items[i].offset; position < m_items[i].offset + m_items[i].size; position++)
+        {
+            if (Fixup const *operand = findFixup(position); operand != nullptr && operand->expression.find('$') != std::string::npos)
+            {
+                return "`$` used in an instruction at line " + std::to_string(m_items[i].sourceLine + 1);
+            }
+        }
+    }
+    return {};
+}
+
+bool Assembler::threadJumps()
+{
+    bool changed = false;
+    for (size_t i = 0; i < m_items.size(); i++)
+    {
+        const uint16_t opcode = getOpcode(i);
+        if (m_items[i].removed || !m_items[i].isInstruction || ((opcode & 0xf000) != 0x1000 && (opcode & 0xf000) != 0x2000))
+        {
+            continue;
+        }
+        Fixup *fixup = findFixup(m_items[i].offset);
+        std::vector<bool> visited(m_items.size(), false);
+        visited[i] = true;
+        std::optional<std::string> finalTarget;
+        std::optional<size_t> target = findJumpTarget(i);
+        while (target.has_value())
+        {
+            const size_t next = firstKeptFrom(target.value());
+            if (next >= m_items.size() || visited[next] || !m_items[next].isInstruction || (getOpcode(next) & 0xf000) != 0x1000)
+            {
+                break;
+            }
+            Fixup const *nextFixup = findFixup(m_items[next].offset);
+            if (nextFixup == nullptr)
+            {
+                break;
+            }
+            visited[next] = true;
+            finalTarget = nextFixup->expression;
+            target = findJumpTarget(next);
+        }
+        if (finalTarget.has_value() && finalTarget.value() != fixup->expression)
+        {
+            fixup->expression = finalTarget.value();
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool Assembler::removeJumpsToNext()
+{
+    bool changed = false;
+    for (size_t i = 0; i < m_items.size(); i++)
+    {
+        if (m_items[i].removed || !m_items[i].isInstruction || m_protectedItems[i] || (getOpcode(i) & 0xf000) != 0x1000)
+        {
+            continue;
+        }
+        if (std::optional<size_t> target = findJumpTarget(i); target.has_value() && target.value() != i && firstKeptFrom(target.value()) == nextKeptItem(i))
+        {
+            removeItem(i);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool Assembler::foldAdds()
+{
+    bool changed = false;
+    for (size_t i = 0; i < m_items.size(); i++)
+    {
+        const uint16_t opcode = getOpcode(i);
+        if (m_items[i].removed || !m_items[i].isInstruction || m_protectedItems[i] || (opcode & 0xf000) != 0x7000 || findFixup(m_items[i].offset + 1) != nullptr)
+        {
+            continue;
+        }
+        const size_t next = nextKeptItem(i);
+        if (next >= m_items.size() || !m_items[next].isInstruction || hasLabelBetween(i, next) || findFixup(m_items[next].offset + 1) != nullptr)
+        {
+            continue;
+        }
+        const uint16_t nextOpcode = getOpcode(next);
+        if ((nextOpcode & 0xff00) != (opcode & 0xff00))
+        {
+            continue;
+        }
+        const uint8_t sum = (opcode & 0x00ff) + (nextOpcode & 0x00ff);
+        setOpcode(i, (opcode & 0xff00) | sum);
+        removeItem(next);
+        if (sum == 0)
+        {
+            removeItem(i);
+        }
+        changed = true;
+    }
+    return changed;
+}
+
+bool Assembler::removeDeadMoves()
+{
+    bool changed = false;
+    for (size_t i = 0; i < m_items.size(); i++)
+    {
+        const uint16_t opcode = getOpcode(i);
+        const bool isMove = (opcode & 0xf000) == 0x6000 || (opcode & 0xf00f) == 0x8000;
+        if (m_items[i].removed || !m_items[i].isInstruction || m_protectedItems[i] || !isMove)
+        {
+            continue;
+        }
+        const uint8_t reg = (opcode & 0x0f00) >> 8;
+        // moving register into itself does nothing
+        if ((opcode & 0xf00f) == 0x8000 && ((opcode & 0x00f0) >> 4) == reg)
+        {
+            removeItem(i);
+            changed = true;
+            continue;
+        }
+        const size_t next = nextKeptItem(i);
+        if (next >= m_items.size() || !m_items[next].isInstruction)
+        {
+            continue;
+        }
+        const uint16_t nextOpcode = getOpcode(next);
+        if (((nextOpcode & 0x0f00) >> 8) != reg)
+        {
+            continue;
+        }
+        // next instruction overwrites the register without reading it
+        const bool overwrites = (nextOpcode & 0xf000) == 0x6000 ||
+                                ((nextOpcode & 0xf00f) == 0x8000 && ((nextOpcode & 0x00f0) >> 4) != reg) ||
+                                (nextOpcode & 0xf0ff) == 0xf007 ||
+                                (nextOpcode & 0xf0ff) == 0xf00a;
+        if (overwrites)
+        {
+            removeItem(i);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool Assembler::replaceTailCalls()
+{
+    bool changed = false;
+    for (size_t i = 0; i < m_items.size(); i++)
+    {
+        const uint16_t opcode = getOpcode(i);
+        if (m_items[i].removed || !m_items[i].isInstruction || (opcode & 0xf000) != 0x2000)
+        {
+            continue;
+        }
+        const size_t next = nextKeptItem(i);
+        if (next >= m_items.size() || !m_items[next].isInstruction || getOpcode(next) != 0x00ee)
+        {
+            continue;
+        }
+        setOpcode(i, 0x1000 | (opcode & 0x0fff));
+        // return is still needed if something can get to it without going through the call
+        if (!m_protectedItems[i] && !hasLabelBetween(i, next))
+        {
+            removeItem(next);
+        }
+        changed = true;
+    }
+    return changed;
+}
+
+void Assembler::relocate()
+{
+    std::vector<size_t> newOffsets(m_items.size());
+    std::vector<uint8_t> bytes;
+    for (size_t i = 0; i < m_items.size(); i++)
+    {
+        // removed items are moved to the start of the next kept item
+        newOffsets[i] = bytes.size();
+        if (!m_items[i].removed)
+        {
+            bytes.insert(bytes.end(), m_bytes.begin() + m_items[i].offset, m_bytes.begin() + m_items[i].offset + m_items[i].size);
+        }
+    }
+    auto relocateOffset = [&](size_t offset) -> size_t
+    {
+        if (offset >= m_bytes.size())
+        {
+            return bytes.size() + (offset - m_bytes.size());
+        }
+        const size_t item = findItemContaining(offset);
+        return newOffsets[item] + (m_items[item].removed ? 0 : offset - m_items[item].offset);
+    };
+
+    for (std::pair<const std::string, size_t> &label : m_labelPositions)
+    {
+        label.second = relocateOffset(label.second);
+    }
+    std::vector<Fixup> fixups;
+    for (Fixup const &fixup : m_fixups)
+    {
+        if (m_items[findItemContaining(fixup.position)].removed)
+        {
+            continue;
+        }
+        Fixup relocated = fixup;
+        relocated.position = relocateOffset(fixup.position);
+        relocated.origin = relocateOffset(fixup.origin);
+        fixups.push_back(relocated);
+    }
+    m_fixups = fixups;
+
+    std::vector<EmittedItem> items;
+    for (size_t i = 0; i < m_items.size(); i++)
+    {
+        if (!m_items[i].removed)
+        {
+            items.push_back(m_items[i]);
+            items.back().offset = newOffsets[i];
+        }
+    }
+    m_items = items;
+    m_bytes = bytes;
+}
+
+void Assembler::removeItem(size_t item)
+{
+    m_items[item].removed = true;
+    m_removedInstructionCount++;
+}
+
+uint16_t Assembler::getOpcode(size_t item) const
+{
+    if (m_items[item].size < 2)
+    {
+        return 0;
+    }
+    return (m_bytes[m_items[item].offset] << 8) | m_bytes[m_items[item].offset + 1];
+}
+
+void Assembler::setOpcode(size_t item, uint16_t opcode)
+{
+    m_bytes[m_items[item].offset] = (opcode & 0xff00) >> 8;
+    m_bytes[m_items[item].offset + 1] = opcode & 0x00ff;
+}
+
+Fixup *Assembler::findFixup(size_t position)
+{
+    for (Fixup &fixup : m_fixups)
+    {
+        if (fixup.position == position)
+        {
+            return &fixup;
+        }
+    }
+    return nullptr;
+}
+
+std::optional<size_t> Assembler::findJumpTarget(size_t item)
+{
+    Fixup const *fixup = findFixup(m_items[item].offset);
+    if (fixup == nullptr)
+    {
+        return {};
+    }
+    ExpressionEvaluator evaluator(fixup->expression, fixup->origin, getLabelLookup(), fixup->column, fixup->row);
+    std::optional<int64_t> target = evaluator.evaluate();
+    if (!target.has_value())
+    {
+        return {};
+    }
+    std::optional<size_t> targetItem = findItemAt(target.value());
+    if (!targetItem.has_value() || !m_items[targetItem.value()].isInstruction)
+    {
+        return {};
+    }
+    return targetItem;
+}
+
+std::optional<size_t> Assembler::findItemAt(size_t offset) const
+{
+    std::vector<EmittedItem>::const_iterator it = std::lower_bound(m_items.begin(), m_items.end(), offset, [](EmittedItem const &item, size_t offset)
+                                                                   { return item.offset < offset; });
+    if (it == m_items.end() || it->offset != offset)
+    {
+        return {};
+    }
+    return it - m_items.begin();
+}
+
+size_t Assembler::findItemContaining(size_t offset) const
+{
+    std::vector<EmittedItem>::const_iterator it = std::upper_bound(m_items.begin(), m_items.end(), offset, [](size_t offset, EmittedItem const &item)
+                                                                   { return offset < item.offset; });
+    return (it - m_items.begin()) - 1;
+}
+
+size_t Assembler::nextKeptItem(size_t item) const
+{
+    return firstKeptFrom(item + 1);
+}
+
+size_t Assembler::firstKeptFrom(size_t item) const
+{
+    for (; item < m_items.size() && m_items[item].removed; item++)
+        ;
+    return item;
+}
+
+bool Assembler::hasLabelBetween(size_t first, size_t last) const
+{
+    for (size_t i = first + 1; i <= last; i++)
+    {
+        if (m_labeledItems[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Assembler::isSkipInstruction(uint16_t opcode)
+{
+    switch ((opcode & 0xf000) >> 12)
+    {
+    case 0x3:
+    case 0x4:
+    case 0x5:
+    case 0x9:
+        return true;
+    case 0xE:
+        return (opcode & 0x00ff) == 0x9e || (opcode & 0x00ff) == 0xa1;
+    }
+    return false;
+}
+
+void Assembler::assembleSingleRegisterSpecials(uint8_t dataByte)
+{
+    skipWhitespace();
+    if (std::optional<size_t> reg = parseRegister(); reg.has_value())
+    {
+        m_bytes.push_back(0xf0 | reg.value());
+        m_bytes.push_back(dataByte);
+        expectLineEnd();
+        return;
+    }
+    throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Expected register");
+}
+
+void Assembler::assembleCheckKeyPress(uint8_t dataByte)
+{
+    skipWhitespace();
+    if (std::optional<size_t> reg = parseRegister(); reg.has_value())
+    {
+        m_bytes.push_back(0xe0 | reg.value());
+        m_bytes.push_back(dataByte);
+        expectLineEnd();
+        return;
+    }
+    throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Expected register");
+}
+
+void Assembler::assembleEqualsOperation(uint8_t constOperationBit, uint8_t registerOperationBit)
+{
+    skipWhitespace();
+    std::optional<size_t> registerId = parseRegister();
+    if (!registerId.has_value())
+    {
+        throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Expected register");
+    }
+    skipWhitespace();
+    consumeComma();
+    skipWhitespace();
+    if (std::optional<size_t> register2Id = parseRegister(); register2Id.has_value())
+    {
+        m_bytes.push_back((registerOperationBit << 4) | registerId.value());
+        m_bytes.push_back((register2Id.value() << 4));
+    }
+    else
+    {
+        const uint16_t val = parseValue(ValueType::Byte, m_bytes.size() + 1, "Expected register or number");
+        m_bytes.push_back((constOperationBit << 4) | registerId.value());
+        m_bytes.push_back(val);
+    }
+    expectLineEnd();
+}
+
+void Assembler::assembleAddOperation()
+{
+    skipWhitespace();
+    std::optional<size_t> registerA = parseRegister();
+    if (!registerA.has_value())
+    {
+        throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Expected register");
+    }
+    skipWhitespace();
+    consumeComma();
+    skipWhitespace();
+    if (std::optional<size_t> registerB = parseRegister(); registerB.has_value())
+    {
+        m_bytes.push_back(0x80 | registerA.value());
+        m_bytes.push_back((registerB.value() << 4) | 4);
+    }
+    else
+    {
+        const uint16_t val = parseValue(ValueType::Byte, m_bytes.size() + 1, "Expected register or number");
+        m_bytes.push_back(0x70 | registerA.value());
+        m_bytes.push_back(val);
+    }
+    expectLineEnd();
+}
+
+void Assembler::assembleMathOperations(uint8_t operationTypeBit)
+{
+    skipWhitespace();
+    std::optional<size_t> registerA = parseRegister();
+    if (!registerA.has_value())
+    {
+        throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Expected register");
+    }
+    skipWhitespace();
+    consumeComma();
+    skipWhitespace();
+    if (std::optional<size_t> registerB = parseRegister(); registerB.has_value())
+    {
+        m_bytes.push_back(0x80 | registerA.value());
+        m_bytes.push_back((registerB.value() << 4) | operationTypeBit);
+    }
+    else
+    {
+        throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Expected register");
+    }
+    expectLineEnd();
+}
+
+void Assembler::assembleDraw()
+{
+    skipWhitespace();
+    std::optional<size_t> regX = parseRegister();
+    if (!regX.has_value())
+    {
+        throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Expected register for x");
+    }
+    skipWhitespace();
+    consumeComma();
+    std::optional<size_t> regY = parseRegister();
+    if (!regY.has_value())
+    {
+        throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Expected register for y");
+    }
+    skipWhitespace();
+    consumeComma();
+    const size_t heightColumn = m_current - m_begin;
+    const int64_t height = parseConstant("Expected value for height");
+    if (height > 16)
+    {
+        throw AssemblingError(heightColumn, m_currentLineNumber, "Height of sprite for draw can not be larger than 16");
+    }
+    else if (height <= 0)
+    {
+        throw AssemblingError(heightColumn, m_currentLineNumber, "Height of sprite can not be 0");
+    }
+    m_bytes.push_back(0xd0 | regX.value());
+    m_bytes.push_back(((regY.value() & 0xf) << 4) | (height - 1));
+    expectLineEnd();
+}
+
+void Assembler::assembleDataOperations()
+{
+    size_t total = 1;
+    if (std::optional<size_t> repeat = parseTimes(); repeat.has_value())
+    {
+        total = repeat.value();
+    }
+    skipWhitespace();
+    std::optional<DataSize> dataSize = parseDataStore();
+    if (!dataSize.has_value())
+    {
+        throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Expected data store operation");
+    }
+    skipWhitespace();
+    const StringConstIterator valuesBegin = m_current;
+    const ValueType valueType = dataSize.value() == DataSize::Byte ? ValueType::Byte : ValueType::Word;
+    // values are parsed again for every repetition so that values using `$` and labels are written into every copy
+    for (size_t i = 0; i < total; i++)
+    {
+        m_current = valuesBegin;
+        m_lineAddress = m_bytes.size();
+        while (true)
+        {
+            const uint16_t value = parseValue(valueType, m_bytes.size(), "Expected a number");
+            if (valueType == ValueType::Word)
+            {
+                m_bytes.push_back((value & 0xff00) >> 8);
+            }
+            m_bytes.push_back(value & 0x00ff);
+            skipWhitespace();
+            if (m_current == m_end || *m_current != ',')
+            {
+                break;
+            }
+            consumeComma();
+        }
+    }
+
+    expectLineEnd();
+}
+
+void Assembler::assembleAddressInstruction(uint8_t firstByte)
+{
+    skipWhitespace();
+    const uint16_t address = parseValue(ValueType::Address, m_bytes.size(), "Excepted address or label");
+    m_bytes.push_back((firstByte << 4) | ((address & 0x0f00) >> 8));
+    m_bytes.push_back(address & 0x00ff);
+    expectLineEnd();
+}
+
+void Assembler::assembleMoveOperation()
+{
+    skipWhitespace();
+    std::optional<size_t> registerId = parseRegister();
+    if (!registerId.has_value())
+    {
+        throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Excepted register name");
+    }
+    consumeComma();
+
+    if (std::optional<size_t> register2Id = parseRegister(); register2Id.has_value())
+    {
+        m_bytes.push_back((0x8 << 4) | registerId.value());
+        m_bytes.push_back(register2Id.value() << 4);
+    }
+    else
+    {
+        const uint16_t constVal = parseValue(ValueType::Byte, m_bytes.size() + 1, "Excepted register or number");
+        m_bytes.push_back((0x6 << 4) | registerId.value());
+        m_bytes.push_back(constVal);
+    }
+    expectLineEnd();
+}
+
+std::optional<uint32_t> Assembler::parseTimes()
+{
+    if (!tryText("times"))
+    {
+        return {};
+    }
+    m_current += std::string("times").size();
+    skipWhitespace();
+    const size_t column = m_current - m_begin;
+    // the count ends where the data store keyword starts
+    std::smatch matches;
+    const std::string rest(m_current, m_end);
+    if (!std::regex_search(rest, matches, std::regex("^(.+?) +(db|dw)\\b")))
+    {
+        throw AssemblingError(column, m_currentLineNumber, "Excepted the times value");
+    }
+    const int64_t times = evaluateConstant(matches[1].str(), column);
+    m_current += matches[1].length();
+    if (times < 0)
+    {
+        throw AssemblingError(column, m_currentLineNumber, "Times value can not be negative");
+    }
+    return times;
+}
+
+bool Assembler::tryDataOperation()
+{
+    for (std::string const &keyword : AssembleDataOperationKeywords)
+    {
+        if (tryText(keyword))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Assembler::tryText(std::string const &text)
+{
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if ((m_current + i) == m_end || *(m_current + i) != text[i])
+        {
+            return false;
+        }
+    }
+
+    // make sure the word is over
+    if (m_current + text.size() != m_end && !(*(m_current + text.size()) == ' ' || *(m_current + text.size()) == ','))
+    {
+        return false;
+    }
+    return true;
+}
+
+std::optional<Instruction> Assembler::parseInstruction()
+{
+    for (std::map<std::string, Instruction>::const_iterator inIt = Instructions.begin(); inIt != Instructions.end(); inIt++)
+    {
+        if (tryText(inIt->first))
+        {
+            m_current += inIt->first.size();
+            return inIt->second;
+        }
+    }
+    return {};
+}
+
+std::optional<DataSize> Assembler::parseDataStore()
+{
+    for (auto const &store : DataStoreSizeKeywords)
+    {
+        if (tryText(store.first))
+        {
+            m_current += store.first.size();
+            return store.second;
+        }
+    }
+    return {};
+}
+
+std::optional<std::string> Assembler::parseLabel()
+{
+    std::string res = "";
+    for (StringConstIterator it = m_current; it != m_end; it++)
+    {
+        if (*it == ':')
+        {
+            m_current += res.size() + 1;
+            return res;
+        }
+        if (!std::isalnum(*it) && *it != '_')
+        {
+            return {};
+        }
+        res += *it;
+    }
+    return {};
+}
+
+std::optional<size_t> Assembler::parseRegister()
+{
+    if (*m_current != 'v')
+    {
+        return {};
+    }
+    size_t it = hexNumbers.find(*(m_current + 1));
+    if (it == std::string::npos)
+    {
+        return {};
+    }
+    if (m_current + 2 == m_end || *(m_current + 2) == ' ' || *(m_current + 2) == ',')
+    {
+        m_current += 2;
+        return it;
+    }
+    return {};
+}
+
+std::string Assembler::readOperand()
+{
+    skipWhitespace();
+    std::string res;
+    for (; m_current != m_end && *m_current != ','; m_current++)
+    {
+        res += *m_current;
+    }
+    while (!res.empty() && res.back() == ' ')
+    {
+        res.pop_back();
+    }
+    return res;
+}
+
+int64_t Assembler::parseConstant(std::string const &missingMessage)
+{
+    const size_t column = m_current - m_begin;
+    std::string operand = readOperand();
+    if (operand.empty())
+    {
+        throw AssemblingError(column, m_currentLineNumber, missingMessage);
+    }
+    return evaluateConstant(operand, column);
+}
+
+int64_t Assembler::evaluateConstant(std::string const &expression, size_t column)
+{
+    ExpressionEvaluator evaluator(expression, m_lineAddress, getLabelLookup(), column, m_currentLineNumber);
+    std::optional<int64_t> value = evaluator.evaluate();
+    if (!value.has_value())
+    {
+        throw AssemblingError(column, m_currentLineNumber, "Value must be a constant or use labels declared before this line");
+    }
+    return value.value();
+}
+
+uint16_t Assembler::parseValue(ValueType type, size_t position, std::string const &missingMessage)
+{
+    const size_t column = m_current - m_begin;
+    std::string operand = readOperand();
+    if (operand.empty())
+    {
+        throw AssemblingError(column, m_currentLineNumber, missingMessage);
+    }
+    ExpressionEvaluator evaluator(operand, m_lineAddress, getLabelLookup(), column, m_currentLineNumber);
+    std::optional<int64_t> value = evaluator.evaluate();
+    if (evaluator.usesSymbols())
+    {
+        m_fixups.push_back(Fixup{operand, position, m_lineAddress, type, column, m_currentLineNumber});
+    }
+    if (!value.has_value())
+    {
+        return 0;
+    }
+    return checkRange(value.value(), type, column, m_currentLineNumber);
+}
+
+uint16_t Assembler::checkRange(int64_t value, ValueType type, size_t column, size_t row)
+{
+    int64_t min = 0;
+    int64_t max = 0;
+    switch (type)
+    {
+    case ValueType::Byte:
+        min = std::numeric_limits<int8_t>::min();
+        max = std::numeric_limits<uint8_t>::max();
+        break;
+    case ValueType::Word:
+        min = std::numeric_limits<int16_t>::min();
+        max = std::numeric_limits<uint16_t>::max();
+        break;
+    case ValueType::Address:
+        max = 0x0fff;
+        break;
+    }
+    if (value < min || value > max)
+    {
+        throw AssemblingError(column, row,
+                              "Constant number is too large, valid range is " +
+                                  std::to_string(min) + " <= x <= " + std::to_string(max) +
+                                  " but value is " + std::to_string(value));
+    }
+    return (uint16_t)value;
+}
+
+void Assembler::writeValue(uint16_t value, ValueType type, size_t position)
+{
+    switch (type)
+    {
+    case ValueType::Byte:
+        m_bytes[position] = value & 0x00ff;
+        break;
+    case ValueType::Word:
+        m_bytes[position] = (value & 0xff00) >> 8;
+        m_bytes[position + 1] = value & 0x00ff;
+        break;
+    case ValueType::Address:
+        m_bytes[position] = (m_bytes[position] & 0xf0) | ((value & 0x0f00) >> 8);
+        m_bytes[position + 1] = value & 0x00ff;
+        break;
+    }
+}
+
+ExpressionEvaluator::SymbolLookup Assembler::getLabelLookup()
+{
+    return [this](std::string const &name) -> std::optional<int64_t>
+    {
+        if (std::map<std::string, size_t>::const_iterator it = m_labelPositions.find(name); it != m_labelPositions.end())
+        {
+            return it->second;
+        }
+        return {};
+    };
+}
+
+void Assembler::skipWhitespace()
+{
+    for (; m_current != m_end && *m_current == ' '; m_current++)
+        ;
+}
+
+void Assembler::consumeComma()
+{
+    skipWhitespace();
+    if (*m_current != ',')
+    {
+        throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Excepted comma");
+    }
+    m_current++;
+    skipWhitespace();
+}
+
+void Assembler::expectLineEnd()
+{
+    skipWhitespace();
+    if (m_current != m_end)
+    {
+        throw AssemblingError(m_current - m_begin, m_currentLineNumber, "Unexpected symbol");
+    }
+}
+
+std::vector<std::string> getCodeLines(std::string const &code)
+{
+    std::stringstream stringStream(code);
+    std::vector<std::string> result;
+    std::string line;
+    while (std::getline(stringStream, line, '\n'))
+    {
+        result.push_back(line);
+    }
+    return result;
+}
+
+/**
+ * @brief Handles everything that happens before assembling: comments, equ substitutions, macros and rept blocks.
+ *
+ * Macros are declared as
+ * @code
+ * name macro param1, param2
+ *     local loop
+ * loop: add param1, param2
+ * endm
+ * @endcode
+ * where `local` lists labels that get a unique name for every expansion. Repeated blocks are declared as
+ * `rept count` or `rept count, counter` followed by lines and `endr`, where `counter` is replaced by the iteration index
+ */
+class CodePreprocessor
+{
+public:
+    std::vector<CodeLine> process(std::string const &code)
+    {
+        std::regex commentRegex("(;(\\S|\\s)+)");
+        std::regex equRegex("^([a-zA-Z_]\\w*) +equ +(.+)$");
+        std::vector<CodeLine> lines;
+        std::stringstream stringStream(code);
+        std::string line;
+        std::map<std::string, std::string> substitutions;
+
+        for (size_t lineNumber = 0; std::getline(stringStream, line, '\n'); lineNumber++)
+        {
+            std::string current = std::regex_replace(line, commentRegex, "");
+            std::smatch matches;
+            if (std::regex_search(current, matches, equRegex))
+            {
+                std::string value = trim(matches[2].str());
+                // expressions are wrapped so that the substitution keeps the precedence
+                if (!std::regex_match(value, std::regex("\\w+")))
+                {
+                    value = "(" + value + ")";
+                }
+                substitutions[matches[1].str()] = value;
+            }
+            else
+            {
+                lines.push_back(CodeLine{current, lineNumber});
+            }
+        }
+        for (CodeLine &codeLine : lines)
+        {
+            codeLine.text = substitute(codeLine, substitutions);
+        }
+        std::vector<CodeLine> result;
+        expand(lines, result, 0);
+        return result;
+    }
+
+private:
+    struct MacroDefinition
+    {
+        std::vector<std::string> parameters;
+        std::vector<std::string> locals;
+        std::vector<CodeLine> body;
+    };
+
+    /**
+     * @brief Apply equ substitutions until nothing changes, which allows equ values to use other equ names
+     *
+     * @param line Line to apply substitutions to
+     * @param substitutions Names and values
+     * @return std::string Line with all substitutions applied
+     */
+    std::string substitute(CodeLine const &line, std::map<std::string, std::string> const &substitutions)
+    {
+        const size_t maxDepth = 32;
+        std::string text = line.text;
+        for (size_t depth = 0; depth < maxDepth; depth++)
+        {
+            std::string before = text;
+            text = replaceWords(text, substitutions, true);
+            if (text == before)
+            {
+                return text;
+            }
+        }
+        throw AssemblingError(0, line.sourceLine, "Recursive equ substitution");
+    }
+
+    void expand(std::vector<CodeLine> const &lines, std::vector<CodeLine> &result, size_t depth)
+    {
+        const size_t maxDepth = 64;
+        std::regex macroRegex("^\\s*([a-zA-Z_]\\w*) +macro\\b *(.*)$");
+        std::regex reptRegex("^\\s*rept +(.+)$");
+        std::regex endRegex("^\\s*(endm|endr)\\s*$");
+        std::regex usageRegex("^(\\s*(?:[a-zA-Z_]\\w*:)?)\\s*([a-zA-Z_]\\w*)\\b *(.*)$");
+        if (depth > maxDepth)
+        {
+            throw AssemblingError(0, lines.empty() ? 0 : lines[0].sourceLine, "Macro expansion is too deep");
+        }
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            CodeLine const &line = lines[i];
+            std::smatch matches;
+            if (std::regex_match(line.text, matches, macroRegex))
+            {
+                MacroDefinition macro;
+                macro.parameters = splitArguments(matches[2].str());
+                std::vector<CodeLine> body = collectBlock(lines, i, "macro", "endm");
+                std::regex localRegex("^\\s*local +(.+)$");
+                for (CodeLine const &bodyLine : body)
+                {
+                    std::smatch localMatches;
+                    if (std::regex_match(bodyLine.text, localMatches, localRegex))
+                    {
+                        std::vector<std::string> locals = splitArguments(localMatches[1].str());
+                        macro.locals.insert(macro.locals.end(), locals.begin(), locals.end());
+                    }
+                    else
+                    {
+                        macro.body.push_back(bodyLine);
+                    }
+                }
+                m_macros[matches[1].str()] = macro;
+            }
+            else if (std::regex_match(line.text, matches, reptRegex))
+            {
+                std::vector<std::string> arguments = splitArguments(matches[1].str());
+                if (arguments.empty() || arguments.size() > 2)
+                {
+                    throw AssemblingError(0, line.sourceLine, "Expected repeat count and optional counter name");
+                }
+                ExpressionEvaluator evaluator(arguments[0], 0, [](std::string const &) -> std::optional<int64_t>
+                                              { return {}; },
+                                              0, line.sourceLine);
+                std::optional<int64_t> count = evaluator.evaluate();
+                if (!count.has_value() || count.value() < 0)
+                {
+                    throw AssemblingError(0, line.sourceLine, "Repeat count must be a non negative constant");
+                }
+                std::vector<CodeLine> body = collectBlock(lines, i, "rept", "endr");
+                for (int64_t iteration = 0; iteration < count.value(); iteration++)
+                {
+                    std::vector<CodeLine> copy = body;
+                    if (arguments.size() == 2)
+                    {
+                        const std::map<std::string, std::string> counter = {{arguments[1], std::to_string(iteration)}};
+                        for (CodeLine &bodyLine : copy)
+                        {
+                            bodyLine.text = replaceWords(bodyLine.text, counter, false);
+                        }
+                    }
+                    expand(copy, result, depth + 1);
+                }
+            }
+            else if (std::regex_match(line.text, matches, endRegex))
+            {
+                throw AssemblingError(0, line.sourceLine, "Unexpected " + matches[1].str() + " without matching block");
+            }
+            else if (std::regex_match(line.text, matches, usageRegex) && m_macros.count(matches[2].str()) > 0)
+            {
+                MacroDefinition const &macro = m_macros[matches[2].str()];
+                std::vector<std::string> arguments = splitArguments(matches[3].str());
+                if (arguments.size() != macro.parameters.size())
+                {
+                    throw AssemblingError(0, line.sourceLine, "Macro " + matches[2].str() + " expects " + std::to_string(macro.parameters.size()) + " arguments but got " + std::to_string(arguments.size()));
+                }
+                if (!trim(matches[1].str()).empty())
+                {
+                    result.push_back(CodeLine{trim(matches[1].str()), line.sourceLine});
+                }
+                const std::string localSuffix = "_" + std::to_string(m_expansionCounter++);
+                // parameters and locals are replaced in one pass, so text coming from arguments is never replaced again
+                std::map<std::string, std::string> replacements;
+                for (std::string const &local : macro.locals)
+                {
+                    replacements[local] = local + localSuffix;
+                }
+                for (size_t param = 0; param < macro.parameters.size(); param++)
+                {
+                    replacements[macro.parameters[param]] = arguments[param];
+                }
+                std::vector<CodeLine> copy = macro.body;
+                for (CodeLine &bodyLine : copy)
+                {
+                    bodyLine.text = replaceWords(bodyLine.text, replacements, false);
+                    // lines of the macro report errors at the place it was used
+                    bodyLine.sourceLine = line.sourceLine;
+                }
+                expand(copy, result, depth + 1);
+            }
+            else
+            {
+                result.push_back(line);
+            }
+        }
+    }
+
+    /**
+     * @brief Collect lines of a block up to the matching end keyword, supporting nested blocks of the same type
+     *
+     * @param lines All lines
+     * @param index Index of the line that opened the block, set to the index of the closing line
+     * @param openKeyword Keyword that opens the block
+     * @param closeKeyword Keyword that closes the block
+     * @return std::vector<CodeLine> Lines between the opening and closing line
+     */
+    std::vector<CodeLine> collectBlock(std::vector<CodeLine> const &lines, size_t &index, std::string const &openKeyword, std::string const &closeKeyword)
+    {
+        std::regex openRegex("^\\s*(?:[a-zA-Z_]\\w* +)?" + openKeyword + "\\b.*$");
+        std::regex closeRegex("^\\s*" + closeKeyword + "\\s*$");
+        const size_t start = index;
+        size_t nesting = 1;
+        std::vector<CodeLine> body;
+        for (index++; index < lines.size(); index++)
+        {
+            if (std::regex_match(lines[index].text, openRegex))
+            {
+                nesting++;
+            }
+            else if (std::regex_match(lines[index].text, closeRegex) && --nesting == 0)
+            {
+                return body;
+            }
+            body.push_back(lines[index]);
+        }
+        throw AssemblingError(0, lines[start].sourceLine, "Missing " + closeKeyword + " for " + openKeyword);
+    }
+
+    std::vector<std::string> splitArguments(std::string const &text)
+    {
+        std::vector<std::string> result;
+        if (trim(text).empty())
+        {
+            return result;
+        }
+        std::stringstream stream(text);
+        std::string argument;
+        while (std::getline(stream, argument, ','))
+        {
+            result.push_back(trim(argument));
+        }
+        return result;
+    }
+
+    /**
+     * @brief Replace every whole word of the text that has a replacement, in a single pass so replacements are never replaced again
+     *
+     * @param text Text to replace in
+     * @param replacements Words and the text to put instead of them
+     * @param skipLabels If true, label declarations are not replaced
+     */
+    static std::string replaceWords(std::string const &text, std::map<std::string, std::string> const &replacements, bool skipLabels)
+    {
+        auto isWordCharacter = [](char c)
+        { return std::isalnum((unsigned char)c) || c == '_'; };
+        std::string result;
+        for (size_t i = 0; i < text.size();)
+        {
+            if (!isWordCharacter(text[i]))
+            {
+                result.push_back(text[i++]);
+                continue;
+            }
+            size_t end = i;
+            while (end < text.size() && isWordCharacter(text[end]))
+            {
+                end++;
+            }
+            const std::string word = text.substr(i, end - i);
+            auto it = replacements.find(word);
+            const bool isLabel = skipLabels && end < text.size() && text[end] == ':';
+            result += it != replacements.end() && !isLabel ? it->second : word;
+            i = end;
+        }
+        return result;
+    }
+
+    static std::string trim(std::string const &text)
+    {
+        const size_t begin = text.find_first_not_of(" \t");
+        if (begin == std::string::npos)
+        {
+            return "";
+        }
+        return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+    }
+
+    std::map<std::string, MacroDefinition> m_macros;
+    size_t m_expansionCounter = 0;
+};
+
+std::vector<CodeLine> prepareCode(std::string const &code)
+{
+    return CodePreprocessor().process(code);
+}
+
+std::optional<std::vector<uint8_t>> assembleOrLoad(std::string const &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Unable to open " << filename << std::endl;
+        return {};
+    }
+    if (std::filesystem::path(filename).extension() != ".asm")
+    {
+        return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+    std::stringstream code;
+    code << file.rdbuf();
+    try
+    {
+        Assembler assembler(prepareCode(code.str()));
+        assembler.parse();
+        std::span<const uint8_t> result = assembler.getResult();
+        return std::vector<uint8_t>(result.begin(), result.end());
+    }
+    catch (AssemblingError const &e)
+    {
+        std::cerr << filename << ": " << e.what() << std::endl;
+    }
+    return {};
+}
@@ -0,0 +1,396 @@
+#pragma once
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "SymbolTable.hpp"
+
+enum class Instruction
+{
+    None,
+    Move,
+    Clear,
+    Render,
+    Draw,
+    SetMemory,
+    Jump,
+    Call,
+    Return,
+    Add,
+    Sub,
+    Or,
+    And,
+    Xor,
+    RotateRight,
+    RotateLeft,
+    Equals,
+    NotEquals,
+    In,
+    KeyPressed,
+    KeyNotPressed,
+    MemAdd,
+    SetAudioTimer,
+    GetTimer,
+    SetTimer,
+    Halt
+};
+
+enum class DataSize
+{
+    Byte,
+    Word
+};
+
+/// @brief Kind of the value written by the operand, used for range checking and writing values that depend on labels
+enum class ValueType
+{
+    /// @brief Single byte, such as register constants and db values
+    Byte,
+    /// @brief Two byte big endian value used by dw
+    Word,
+    /// @brief 12 bit address stored in the lower nibble of the first byte and the second byte of the opcode
+    Address
+};
+using StringConstIterator = std::string::const_iterator;
+
+class AssemblingError : public std::exception
+{
+public:
+    const char *what() const throw() override { return m_full.c_str(); }
+    AssemblingError(size_t column, size_t row, std::string const &msg) : m_row(row), m_column(column), m_message(msg)
+    {
+        m_full = ("Error at line " + std::to_string(m_row + 1) + " row " + std::to_string(m_column + 1) + ": " + m_message);
+    }
+
+    size_t getRow() const { return m_row; }
+    size_t getColumn() const { return m_column; }
+
+private:
+    std::string m_full;
+    size_t m_row;
+    size_t m_column;
+    std::string m_message;
+};
+
+/**
+ * @brief Single line of code after preprocessing together with the line of the source file it came from
+ *
+ */
+struct CodeLine
+{
+    std::string text;
+    size_t sourceLine;
+};
+
+/**
+ * @brief Value that depends on label positions or `$` and has to be written once all labels are known
+ *
+ */
+struct Fixup
+{
+    std::string expression;
+    /// @brief Position in the output to write the value to
+    size_t position;
+    /// @brief Value of `$` for the expression
+    size_t origin;
+    ValueType type;
+    size_t column;
+    size_t row;
+};
+
+/**
+ * @brief Bytes produced by a single line, used by the optimizer to move code around
+ *
+ */
+struct EmittedItem
+{
+    size_t offset;
+    size_t size;
+    bool isInstruction;
+    size_t sourceLine;
+    bool removed = false;
+};
+
+/**
+ * @brief Recursive descent evaluator for constant expressions used in operands.
+ * Supports decimal, hex(0x) and binary(0b) numbers, label names, `$`(address of the current line), parenthesis and
+ * C-like operators: unary - + ~, * / %, + -, << >>, &, ^, |
+ *
+ */
+class ExpressionEvaluator
+{
+public:
+    using SymbolLookup = std::function<std::optional<int64_t>(std::string const &)>;
+
+    /**
+     * @brief Construct a new Expression Evaluator
+     *
+     * @param expression Text of the expression
+     * @param currentAddress Value used for `$`
+     * @param lookup Function that returns value of a label or empty value if label is not known(yet)
+     * @param column Column of the expression in the line(for displaying errors)
+     * @param row Line of the expression(for displaying errors)
+     */
+    explicit ExpressionEvaluator(std::string const &expression, int64_t currentAddress, SymbolLookup const &lookup, size_t column, size_t row);
+
+    /**
+     * @brief Evaluate the expression
+     *
+     * @return std::optional<int64_t> Value of the expression or empty value if it uses labels that are not known yet
+     */
+    std::optional<int64_t> evaluate();
+
+    /// @brief True if the value of the last evaluated expression depends on label positions or `$`
+    bool usesSymbols() const { return m_usesSymbols; }
+
+private:
+    int64_t parseBinaryOperation(size_t level);
+
+    int64_t applyOperator(std::string const &op, int64_t left, int64_t right, size_t column);
+
+    int64_t parseUnary();
+
+    int64_t parsePrimary();
+
+    int64_t parseNumber();
+
+    std::optional<std::string> parseOperator(std::vector<std::string> const &operators);
+
+    void skipWhitespace();
+
+    std::string m_expression;
+    int64_t m_currentAddress;
+    SymbolLookup m_lookup;
+    size_t m_column;
+    size_t m_row;
+    size_t m_position = 0;
+    bool m_unresolved = false;
+    bool m_usesSymbols = false;
+};
+
+class Assembler
+{
+public:
+    explicit Assembler(std::vector<CodeLine> const &code);
+
+    /**
+     * @brief Get the assembled program. Only valid after a successful call to parse and while the assembler is alive
+     *
+     * @return std::span<const uint8_t> Bytes of the program
+     */
+    std::span<const uint8_t> getResult() const { return m_bytes; }
+
+    /**
+     * @brief Assemble the code, throws AssemblingError if the code is invalid
+     *
+     */
+    void parse();
+
+    /**
+     * @brief Enable peephole optimization pass that runs between parsing and writing label values.
+     * It removes jumps to the next instruction, threads jump chains, folds consecutive adds of constants, removes
+     * moves whose result is overwritten right away and replaces call followed by return with a jump.
+     * Code declared with db and dw is assumed to never be executed
+     *
+     * @param enabled
+     */
+    void setOptimizationEnabled(bool enabled) { m_optimizationEnabled = enabled; }
+
+    /// @brief Number of instructions removed by the optimizer during the last parse
+    size_t getRemovedInstructionCount() const { return m_removedInstructionCount; }
+
+    /**
+     * @brief Get labels and source lines of the assembled program. Only valid after a successful call to parse
+     *
+     * @param sourceName Name of the source file to store in the table
+     * @return SymbolTable
+     */
+    SymbolTable getSymbols(std::string const &sourceName) const;
+
+    /// @brief Reason the optimizer did not run or empty value if it did
+    std::optional<std::string> const &getOptimizationSkipReason() const { return m_optimizationSkipReason; }
+
+private:
+    void recordItem(size_t offset, bool isInstruction);
+
+    void optimize();
+
+    /**
+     * @brief Check if program does something that prevents the code from being moved, such as jumps to literal addresses or relative to `$`
+     *
+     * @return std::optional<std::string> Reason or empty value if code can be optimized
+     */
+    std::optional<std::string> findOptimizationBlocker();
+
+    bool threadJumps();
+    bool removeJumpsToNext();
+    bool foldAdds();
+    bool removeDeadMoves();
+    bool replaceTailCalls();
+
+    /**
+     * @brief Remove items marked as removed and move labels and fixups to the new positions
+     *
+     */
+    void relocate();
+
+    void removeItem(size_t item);
+    uint16_t getOpcode(size_t item) const;
+    void setOpcode(size_t item, uint16_t opcode);
+    Fixup *findFixup(size_t position);
+    std::optional<size_t> findJumpTarget(size_t item);
+    std::optional<size_t> findItemAt(size_t offset) const;
+    size_t findItemContaining(size_t offset) const;
+    size_t nextKeptItem(size_t item) const;
+    size_t firstKeptFrom(size_t item) const;
+
+    /**
+     * @brief Check if code can get to the last item without going through the first one
+     *
+     */
+    bool hasLabelBetween(size_t first, size_t last) const;
+
+    static bool isSkipInstruction(uint16_t opcode);
+
+    /**
+     * @brief Covers several opcodes that take register as input and only differ by the second byte
+     *
+     * @param dataByte
+     */
+    void assembleSingleRegisterSpecials(uint8_t dataByte);
+    void assembleCheckKeyPress(uint8_t dataByte);
+    void assembleEqualsOperation(uint8_t constOperationBit, uint8_t registerOperationBit);
+    void assembleAddOperation();
+    void assembleMathOperations(uint8_t operationTypeBit);
+    void assembleDraw();
+    void assembleDataOperations();
+
+    void assembleAddressInstruction(uint8_t firstByte);
+
+    void assembleMoveOperation();
+
+    std::optional<uint32_t> parseTimes();
+
+    bool tryDataOperation();
+
+    bool tryText(std::string const &text);
+
+    std::optional<Instruction> parseInstruction();
+    std::optional<DataSize> parseDataStore();
+
+    std::optional<std::string> parseLabel();
+
+    std::optional<size_t> parseRegister();
+
+    /**
+     * @brief Read the text of the operand up to the next comma or the end of the line
+     *
+     * @return std::string Operand without trailing whitespace
+     */
+    std::string readOperand();
+
+    /**
+     * @brief Parse an expression that has to be known at the point of use, such as sprite height or repeat count
+     *
+     * @param missingMessage Error message used if there is no value
+     * @return int64_t Value of the expression
+     */
+    int64_t parseConstant(std::string const &missingMessage);
+
+    int64_t evaluateConstant(std::string const &expression, size_t column);
+
+    /**
+     * @brief Parse an operand expression. Values that depend on labels or `$` are recorded as fixups and written once all labels are known
+     *
+     * @param type Type of the value for range checking
+     * @param position Position in the output the value will be written to
+     * @param missingMessage Error message used if there is no value
+     * @return uint16_t Value of the expression or 0 if it uses labels that are not declared yet
+     */
+    uint16_t parseValue(ValueType type, size_t position, std::string const &missingMessage);
+
+    uint16_t checkRange(int64_t value, ValueType type, size_t column, size_t row);
+
+    /**
+     * @brief Write the value into already emitted bytes
+     *
+     * @param value Value to write
+     * @param type Type of the value
+     * @param position Position in the output
+     */
+    void writeValue(uint16_t value, ValueType type, size_t position);
+
+    ExpressionEvaluator::SymbolLookup getLabelLookup();
+
+    void skipWhitespace();
+
+    /**
+     * @brief Try to grab a comma and throw an error if there is no comma
+     *
+     * @param begin Position to start from
+     * @param end End of the line
+     * @param lineBegin Start of the line(for displaying errors)
+     * @param lineNumber Number of the line(for displaying errors)
+     */
+    void consumeComma();
+
+    /**
+     * @brief Check if line ends after the given iterator
+     *
+     * @param begin Position to start from
+     * @param end End of the line
+     * @param lineBegin Start of the line(for displaying errors)
+     * @param lineNumber Number of the line(for displaying errors)
+     */
+    void expectLineEnd();
+
+private:
+    std::vector<CodeLine> m_code;
+    StringConstIterator m_end;
+    StringConstIterator m_current;
+    StringConstIterator m_begin;
+    size_t m_currentLineNumber;
+    /// @brief Address of the line that is being assembled, used as the value of `$`
+    size_t m_lineAddress = 0;
+    std::vector<uint8_t> m_bytes;
+    std::vector<Fixup> m_fixups;
+    std::map<std::string, size_t> m_labelPositions;
+    std::vector<EmittedItem> m_items;
+
+    bool m_optimizationEnabled = false;
+    size_t m_removedInstructionCount = 0;
+    std::optional<std::string> m_optimizationSkipReason;
+    std::vector<bool> m_labeledItems;
+    /// @brief Items right after skip instructions
+    std::vector<bool> m_protectedItems;
+};
+
+/**
+ * @brief Split the code into lines without any processing
+ *
+ * @param code Source code
+ * @return std::vector<std::string> Lines of the code
+ */
+std::vector<std::string> getCodeLines(std::string const &code);
+
+/**
+ * @brief Remove comments and expand equ substitutions, macros and rept blocks. Throws AssemblingError if the code is invalid
+ *
+ * @param code Source code
+ * @return std::vector<CodeLine> Lines ready to be passed to the assembler
+ */
+std::vector<CodeLine> prepareCode(std::string const &code);
+
+/**
+ * @brief Load the program for one of the tools, sources are assembled and anything else is treated as a binary.
+ * Errors are printed to the standard error stream
+ *
+ * @param filename Path to the program, sources are recognized by the .asm extension
+ * @return std::optional<std::vector<uint8_t>> Bytes of the program or empty value if it could not be loaded
+ */
+std::optional<std::vector<uint8_t>> assembleOrLoad(std::string const &filename);
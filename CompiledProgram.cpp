@@ -0,0 +1,82 @@
+#include "CompiledProgram.hpp"
+#include <algorithm>
+
+CompiledProgram::CompiledProgram(std::string const &name, std::span<const uint8_t> rom, RunFunction run) : m_name(name), m_rom(rom), m_run(run)
+{
+    getPrograms().push_back(this);
+}
+
+std::vector<CompiledProgram const *> &CompiledProgram::getPrograms()
+{
+    // function local so that generated sources can register during static initialization
+    static std::vector<CompiledProgram const *> programs;
+    return programs;
+}
+
+bool CompiledProgram::matches(std::span<const uint8_t> memory) const
+{
+    return memory.size() >= m_rom.size() && std::equal(m_rom.begin(), m_rom.end(), memory.begin());
+}
+
+bool CompiledProgram::matches(PagedMemory const &memory) const
+{
+    for (size_t offset = 0; offset < m_rom.size(); offset += PagedMemory::PageSize)
+    {
+        std::span<const uint8_t> page = memory.getPage(offset / PagedMemory::PageSize);
+        std::span<const uint8_t> rom = m_rom.subspan(offset, std::min(PagedMemory::PageSize, m_rom.size() - offset));
+        if (!std::equal(rom.begin(), rom.end(), page.begin()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+CompiledProgram const *CompiledProgram::find(std::span<const uint8_t> program)
+{
+    for (CompiledProgram const *compiled : getPrograms())
+    {
+        if (compiled->m_rom.size() == program.size() && compiled->matches(program))
+        {
+            return compiled;
+        }
+    }
+    return nullptr;
+}
+
+size_t CompiledProgram::run(Machine &machine, size_t steps) const
+{
+    bool intact = matches(machine.getMemory());
+    return run(machine, steps, intact);
+}
+
+size_t CompiledProgram::run(Machine &machine, size_t steps, bool &intact) const
+{
+    size_t executed = 0;
+    // stack grows down from the end of the memory and only overwrites the program once it gets there,
+    // native code returns right after such call so it is enough to check after every return
+    auto checkStack = [&]()
+    {
+        if (machine.getStackPointer() < m_rom.size())
+        {
+            intact = matches(machine.getMemory());
+        }
+    };
+    while (executed < steps && !machine.isHalted() && !machine.isAwaitingInput())
+    {
+        if (intact)
+        {
+            executed += m_run(machine, steps - executed);
+            checkStack();
+            if (executed >= steps || machine.isHalted() || machine.isAwaitingInput())
+            {
+                break;
+            }
+        }
+        // native code could not continue from here
+        machine.step();
+        executed++;
+        checkStack();
+    }
+    return executed;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Machine.hpp"
+
+/**
+ * @brief Program that was translated into native code by gob8rc. Generated sources create a static instance of this class
+ * which registers itself so that the emulator can find native code for the loaded program.
+ *
+ * Native code only covers code that could be found statically, every time it reaches something else(jump by register into
+ * unknown code, end of the step budget inside of a block) the machine executes instructions with the interpreter until
+ * native code can take over again. If memory of the program no longer matches the translated program the interpreter is used
+ * until it does
+ */
+class CompiledProgram
+{
+public:
+    /**
+     * @brief Function generated by gob8rc
+     *
+     * @param machine Machine to run
+     * @param maxSteps Maximum number of instructions to execute
+     * @return size_t Number of executed instructions
+     */
+    using RunFunction = size_t (*)(Machine &machine, size_t maxSteps);
+
+    explicit CompiledProgram(std::string const &name, std::span<const uint8_t> rom, RunFunction run);
+
+    /**
+     * @brief Execute instructions using native code where possible, behaves exactly as calling Machine::step the same number of times
+     *
+     * @param machine Machine to run
+     * @param steps Number of instructions to execute
+     * @return size_t Number of executed instructions, can be less if the machine halted or is waiting for input
+     */
+    size_t run(Machine &machine, size_t steps) const;
+
+    /**
+     * @brief Same as run, for callers that run the machine in small slices and don't want to compare the whole program on every call
+     *
+     * @param machine Machine to run
+     * @param steps Number of instructions to execute
+     * @param intact Whether memory still holds the program, updated by the call. Start it with matches and set it again after writing memory of the machine
+     * @return size_t Number of executed instructions
+     */
+    size_t run(Machine &machine, size_t steps, bool &intact) const;
+
+    /// @brief Check if the memory starts with the translated program
+    bool matches(std::span<const uint8_t> memory) const;
+
+    /// @brief Check if the memory of the machine starts with the translated program
+    bool matches(PagedMemory const &memory) const;
+
+    std::string const &getName() const { return m_name; }
+
+    /**
+     * @brief Find the native code for the program
+     *
+     * @param program Bytes of the program
+     * @return CompiledProgram const* Native code or nullptr if the program was not translated
+     */
+    static CompiledProgram const *find(std::span<const uint8_t> program);
+
+    // access to the state of the machine for the generated code
+
+    static std::array<uint8_t, 16> &getRegisters(Machine &machine) { return machine.m_registers; }
+    static size_t &getProgramCounter(Machine &machine) { return machine.m_programCounter; }
+    static size_t &getMemoryRegister(Machine &machine) { return machine.m_memoryRegister; }
+    static uint8_t &getTimer(Machine &machine) { return machine.m_timer; }
+    static uint8_t &getAudioTimer(Machine &machine) { return machine.m_audioTimer; }
+    static bool isKeyPressed(Machine &machine, uint8_t key) { return machine.isKeyPressed(key); }
+    static void swapBuffers(Machine &machine) { machine.m_usingPrimaryVideoBuffer = !machine.m_usingPrimaryVideoBuffer; }
+    static void draw(Machine &machine, uint16_t opcode) { machine.opDraw(opcode); }
+    static void awaitInput(Machine &machine, size_t destination) { machine.m_inputAwaitDestinationRegister = destination; }
+
+private:
+    static std::vector<CompiledProgram const *> &getPrograms();
+
+    std::string m_name;
+    std::span<const uint8_t> m_rom;
+    RunFunction m_run;
+};
@@ -0,0 +1,351 @@
+#include "Conformance.hpp"
+#include "CompiledProgram.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+MachineSnapshot MachineSnapshot::capture(Machine &machine)
+{
+    MachineSnapshot snapshot;
+    snapshot.registers = machine.getRegisters();
+    snapshot.programCounter = machine.getProgramCounter();
+    snapshot.memoryRegister = machine.getMemoryRegister();
+    snapshot.stackPointer = machine.getStackPointer();
+    snapshot.timer = machine.getTimer();
+    snapshot.audioTimer = machine.getAudioTimer();
+    snapshot.awaitingInput = machine.isAwaitingInput();
+    snapshot.memory = machine.getMemory().toArray();
+    snapshot.currentVideo = machine.getCurrentVideoMemory();
+    snapshot.workVideo = machine.getWorkVideoMemory();
+    snapshot.stateHashStale = machine.getStateHash() != machine.computeStateHash();
+    return snapshot;
+}
+
+MachineSnapshot MachineSnapshot::capture(LockstepEngine const &engine, size_t lane)
+{
+    MachineSnapshot snapshot;
+    for (size_t i = 0; i < snapshot.registers.size(); i++)
+    {
+        snapshot.registers[i] = engine.getRegister(lane, i);
+    }
+    snapshot.programCounter = engine.getProgramCounter(lane);
+    snapshot.memoryRegister = engine.getMemoryRegister(lane);
+    snapshot.stackPointer = engine.getStackPointer(lane);
+    snapshot.timer = engine.getTimer(lane);
+    snapshot.audioTimer = engine.getAudioTimer(lane);
+    snapshot.awaitingInput = engine.isAwaitingInput(lane);
+    snapshot.memory = engine.getMemory(lane);
+    std::copy_n(engine.getCurrentVideoMemory(lane).begin(), snapshot.currentVideo.size(), snapshot.currentVideo.begin());
+    std::copy_n(engine.getWorkVideoMemory(lane).begin(), snapshot.workVideo.size(), snapshot.workVideo.begin());
+    return snapshot;
+}
+
+/**
+ * @brief Describe the first difference between two blocks of memory
+ *
+ */
+template <typename T>
+static std::optional<std::string> findMemoryDifference(const char *name, T const &expected, T const &actual)
+{
+    auto mismatch = std::mismatch(expected.begin(), expected.end(), actual.begin());
+    if (mismatch.first == expected.end())
+    {
+        return {};
+    }
+    char buffer[96];
+    std::snprintf(buffer, sizeof(buffer), "%s[0x%03zx] is 0x%02x, expected 0x%02x", name, (size_t)(mismatch.first - expected.begin()), *mismatch.second, *mismatch.first);
+    return buffer;
+}
+
+std::optional<std::string> MachineSnapshot::findDifference(MachineSnapshot const &other) const
+{
+    char buffer[96];
+    for (size_t i = 0; i < registers.size(); i++)
+    {
+        if (registers[i] != other.registers[i])
+        {
+            std::snprintf(buffer, sizeof(buffer), "v%zx is 0x%02x, expected 0x%02x", i, other.registers[i], registers[i]);
+            return buffer;
+        }
+    }
+    const std::pair<const char *, std::pair<size_t, size_t>> values[] = {
+        {"program counter", {programCounter, other.programCounter}},
+        {"memory register", {memoryRegister, other.memoryRegister}},
+        {"stack pointer", {stackPointer, other.stackPointer}},
+        {"timer", {timer, other.timer}},
+        {"audio timer", {audioTimer, other.audioTimer}},
+        {"awaiting input", {awaitingInput, other.awaitingInput}}};
+    for (auto const &value : values)
+    {
+        if (value.second.first != value.second.second)
+        {
+            std::snprintf(buffer, sizeof(buffer), "%s is 0x%03zx, expected 0x%03zx", value.first, value.second.second, value.second.first);
+            return buffer;
+        }
+    }
+    if (std::optional<std::string> difference = findMemoryDifference("memory", memory, other.memory); difference.has_value())
+    {
+        return difference;
+    }
+    if (std::optional<std::string> difference = findMemoryDifference("current video", currentVideo, other.currentVideo); difference.has_value())
+    {
+        return difference;
+    }
+    if (std::optional<std::string> difference = findMemoryDifference("work video", workVideo, other.workVideo); difference.has_value())
+    {
+        return difference;
+    }
+    if (stateHashStale || other.stateHashStale)
+    {
+        return std::string(stateHashStale ? "expected" : "actual") + " state hash does not match the state";
+    }
+    return {};
+}
+
+/**
+ * @brief Core that owns a Machine, cores differ only in how they execute instructions
+ *
+ */
+class MachineCore : public ExecutionCore
+{
+public:
+    bool load(std::span<const uint8_t> program) override
+    {
+        m_machine = std::make_unique<Machine>(program);
+        return true;
+    }
+    void setKeyState(uint8_t key, bool pressed) override { m_machine->setKeyState(key, pressed); }
+    void advanceTimers() override { m_machine->advanceTimers(); }
+    void receiveInput(uint8_t key) override { m_machine->receiveInput(key); }
+    bool isHalted() override { return m_machine->isHalted(); }
+    bool isAwaitingInput() override { return m_machine->isAwaitingInput(); }
+    MachineSnapshot getSnapshot() override { return MachineSnapshot::capture(*m_machine); }
+
+protected:
+    std::unique_ptr<Machine> m_machine;
+};
+
+/**
+ * @brief Machine::stepReference, the reference every other core is compared against
+ *
+ */
+class ReferenceCore : public MachineCore
+{
+public:
+    std::string getName() const override { return "reference"; }
+    size_t run(size_t steps) override
+    {
+        size_t executed = 0;
+        for (; executed < steps && !m_machine->isHalted() && !m_machine->isAwaitingInput(); executed++)
+        {
+            m_machine->stepReference();
+        }
+        return executed;
+    }
+};
+
+/**
+ * @brief Machine::step which executes instructions through the opcode table
+ *
+ */
+class TableCore : public MachineCore
+{
+public:
+    std::string getName() const override { return "table"; }
+    size_t run(size_t steps) override
+    {
+        size_t executed = 0;
+        for (; executed < steps && !m_machine->isHalted() && !m_machine->isAwaitingInput(); executed++)
+        {
+            m_machine->step();
+        }
+        return executed;
+    }
+};
+
+/**
+ * @brief Machine::run which skips idle loops
+ *
+ */
+class BatchCore : public MachineCore
+{
+public:
+    std::string getName() const override { return "batch"; }
+    size_t run(size_t steps) override { return m_machine->run(steps); }
+};
+
+/**
+ * @brief Native code produced by gob8rc, only available for programs that were linked in
+ *
+ */
+class NativeCore : public MachineCore
+{
+public:
+    std::string getName() const override { return "native"; }
+    bool load(std::span<const uint8_t> program) override
+    {
+        m_program = CompiledProgram::find(program);
+        MachineCore::load(program);
+        return m_program != nullptr;
+    }
+    size_t run(size_t steps) override { return m_program->run(*m_machine, steps); }
+
+private:
+    CompiledProgram const *m_program = nullptr;
+};
+
+/**
+ * @brief LockstepEngine with several lanes, the first lane gets the same input as the reference and is compared,
+ * the others get different keys so that they diverge from it and the first lane has to run masked or regrouped
+ *
+ */
+class LockstepCore : public ExecutionCore
+{
+public:
+    std::string getName() const override { return "lockstep"; }
+    bool load(std::span<const uint8_t> program) override
+    {
+        m_engine = std::make_unique<LockstepEngine>(PagedMemory::createImage(program), LaneCount);
+        return true;
+    }
+    size_t run(size_t steps) override
+    {
+        const uint64_t executed = m_engine->getExecutedCount(0);
+        // other lanes can keep going after the first one stops, it does not change the first one
+        m_engine->run(steps);
+        return m_engine->getExecutedCount(0) - executed;
+    }
+    void setKeyState(uint8_t key, bool pressed) override
+    {
+        for (size_t lane = 0; lane < LaneCount; lane++)
+        {
+            m_engine->setKeyState(lane, (key + lane) % 16, pressed);
+        }
+    }
+    void advanceTimers() override { m_engine->advanceTimers(); }
+    void receiveInput(uint8_t key) override
+    {
+        for (size_t lane = 0; lane < LaneCount; lane++)
+        {
+            m_engine->receiveInput(lane, (key + lane) % 16);
+        }
+    }
+    bool isHalted() override { return m_engine->isHalted(0); }
+    bool isAwaitingInput() override { return m_engine->isAwaitingInput(0); }
+    MachineSnapshot getSnapshot() override { return MachineSnapshot::capture(*m_engine, 0); }
+
+private:
+    static constexpr size_t LaneCount = 8;
+    std::unique_ptr<LockstepEngine> m_engine;
+};
+
+std::vector<std::string> getExecutionCoreNames()
+{
+    return {"reference", "table", "batch", "native", "lockstep"};
+}
+
+std::unique_ptr<ExecutionCore> createExecutionCore(std::string const &name)
+{
+    if (name == "reference")
+    {
+        return std::make_unique<ReferenceCore>();
+    }
+    if (name == "table")
+    {
+        return std::make_unique<TableCore>();
+    }
+    if (name == "batch")
+    {
+        return std::make_unique<BatchCore>();
+    }
+    if (name == "native")
+    {
+        return std::make_unique<NativeCore>();
+    }
+    if (name == "lockstep")
+    {
+        return std::make_unique<LockstepCore>();
+    }
+    return nullptr;
+}
+
+ConformanceHarness::ConformanceHarness(size_t maxSteps, size_t compareInterval, size_t frameLength)
+    : m_maxSteps(maxSteps), m_compareInterval(std::max<size_t>(compareInterval, 1)), m_frameLength(std::max<size_t>(frameLength, 1))
+{
+}
+
+void ConformanceHarness::advanceFrame(ExecutionCore &core, size_t frame)
+{
+    core.advanceTimers();
+    // every key goes down and up again in turn so that programs waiting for keys make progress
+    core.setKeyState(frame % 16, (frame / 16) % 2 == 0);
+    if (core.isAwaitingInput())
+    {
+        core.receiveInput(frame % 16);
+    }
+}
+
+ConformanceResult ConformanceHarness::check(std::span<const uint8_t> program, ExecutionCore &candidate)
+{
+    ConformanceResult result;
+    if (!candidate.load(program))
+    {
+        result.supported = false;
+        return result;
+    }
+    std::unique_ptr<ExecutionCore> reference = createExecutionCore("reference");
+    reference->load(program);
+
+    size_t frame = 0;
+    size_t frameSteps = 0;
+    while (result.steps < m_maxSteps && !reference->isHalted())
+    {
+        if (frameSteps >= m_frameLength)
+        {
+            frame++;
+            frameSteps = 0;
+            advanceFrame(*reference, frame);
+            advanceFrame(candidate, frame);
+        }
+        const size_t steps = std::min({m_compareInterval, m_frameLength - frameSteps, m_maxSteps - result.steps});
+        // random numbers have to be the same for both cores
+        std::srand(result.steps);
+        const size_t expected = reference->run(steps);
+        std::srand(result.steps);
+        const size_t actual = candidate.run(steps);
+        result.steps += expected;
+        frameSteps += steps;
+        if (expected != actual)
+        {
+            result.difference = "executed " + std::to_string(actual) + " instructions, expected " + std::to_string(expected);
+            return result;
+        }
+        result.difference = reference->getSnapshot().findDifference(candidate.getSnapshot());
+        if (result.difference.has_value())
+        {
+            return result;
+        }
+    }
+    result.referenceInstructionsPerSecond = measure(program, *reference);
+    result.candidateInstructionsPerSecond = measure(program, candidate);
+    return result;
+}
+
+double ConformanceHarness::measure(std::span<const uint8_t> program, ExecutionCore &core)
+{
+    core.load(program);
+    std::srand(0);
+    size_t executed = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t frame = 0; executed < m_maxSteps && !core.isHalted(); frame++)
+    {
+        if (frame > 0)
+        {
+            advanceFrame(core, frame);
+        }
+        executed += core.run(std::min(m_frameLength, m_maxSteps - executed));
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return executed / std::max(seconds, 1e-9);
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Machine.hpp"
+#include "LockstepEngine.hpp"
+
+/**
+ * @brief Copy of everything that defines the state of the machine, used to compare execution cores against each other
+ *
+ */
+struct MachineSnapshot
+{
+    std::array<uint8_t, 16> registers;
+    size_t programCounter;
+    size_t memoryRegister;
+    size_t stackPointer;
+    uint8_t timer;
+    uint8_t audioTimer;
+    bool awaitingInput;
+    Machine::VirtualMemoryType memory;
+    Machine::VideoMemoryType currentVideo;
+    Machine::VideoMemoryType workVideo;
+    /// @brief Hash the machine keeps while running differs from the hash of its state, always false for cores without one
+    bool stateHashStale = false;
+
+    static MachineSnapshot capture(Machine &machine);
+
+    static MachineSnapshot capture(LockstepEngine const &engine, size_t lane);
+
+    /**
+     * @brief Find the first part of the state that differs
+     *
+     * @param other Snapshot to compare with
+     * @return std::optional<std::string> Description of the difference or empty value if states are equal
+     */
+    std::optional<std::string> findDifference(MachineSnapshot const &other) const;
+};
+
+/**
+ * @brief Something that can execute programs and must behave exactly like Machine::step, like the native code produced by gob8rc
+ *
+ */
+class ExecutionCore
+{
+public:
+    virtual ~ExecutionCore() = default;
+
+    virtual std::string getName() const = 0;
+
+    /**
+     * @brief Reset the core and load the program
+     *
+     * @param program Bytes of the program
+     * @return true If the core can run this program
+     */
+    virtual bool load(std::span<const uint8_t> program) = 0;
+
+    /**
+     * @brief Execute instructions. Same as calling Machine::step the given number of times, except that execution stops once the machine halts or waits for input
+     *
+     * @param steps Number of instructions to execute
+     * @return size_t Number of executed instructions
+     */
+    virtual size_t run(size_t steps) = 0;
+
+    /// @brief Advance timers, set keys and deliver input the same way the emulator does between frames
+    virtual void setKeyState(uint8_t key, bool pressed) = 0;
+    virtual void advanceTimers() = 0;
+    virtual void receiveInput(uint8_t key) = 0;
+
+    virtual bool isHalted() = 0;
+    virtual bool isAwaitingInput() = 0;
+
+    virtual MachineSnapshot getSnapshot() = 0;
+};
+
+/**
+ * @brief Get names of all cores that can be created with createExecutionCore
+ *
+ */
+std::vector<std::string> getExecutionCoreNames();
+
+/**
+ * @brief Create the execution core by name
+ *
+ * @param name Name of the core
+ * @return std::unique_ptr<ExecutionCore> Core or nullptr if there is no core with this name
+ */
+std::unique_ptr<ExecutionCore> createExecutionCore(std::string const &name);
+
+/**
+ * @brief Result of running a program on the reference interpreter and on a candidate core side by side
+ *
+ */
+struct ConformanceResult
+{
+    /// @brief False if the candidate core can't run the program
+    bool supported = true;
+    /// @brief Description of the first difference in state, empty if the cores agree
+    std::optional<std::string> difference;
+    /// @brief Number of instructions executed by the reference before the difference was found or the run finished
+    size_t steps = 0;
+    double referenceInstructionsPerSecond = 0;
+    double candidateInstructionsPerSecond = 0;
+};
+
+/**
+ * @brief Runs programs on the reference interpreter and a candidate core in lockstep
+ *
+ */
+class ConformanceHarness
+{
+public:
+    /**
+     * @brief Construct a new harness
+     *
+     * @param maxSteps Maximum number of instructions to execute per program
+     * @param compareInterval Number of instructions between comparisons of the state, 1 compares after every instruction
+     * @param frameLength Number of instructions between timer updates and key changes
+     */
+    explicit ConformanceHarness(size_t maxSteps, size_t compareInterval, size_t frameLength);
+
+    /**
+     * @brief Run the program on both cores comparing the state and then measure speed of each core separately
+     *
+     * @param program Bytes of the program
+     * @param candidate Core to check
+     */
+    ConformanceResult check(std::span<const uint8_t> program, ExecutionCore &candidate);
+
+private:
+    /**
+     * @brief Execute the program the same way check does, without comparing
+     *
+     * @return double Instructions per second
+     */
+    double measure(std::span<const uint8_t> program, ExecutionCore &core);
+
+    /// @brief Bring both cores to the start of the next frame: timers, keys and input
+    void advanceFrame(ExecutionCore &core, size_t frame);
+
+    size_t m_maxSteps;
+    size_t m_compareInterval;
+    size_t m_frameLength;
+};
@@ -0,0 +1,422 @@
+#include "Disassembler.hpp"
+#include <algorithm>
+#include <cstdio>
+
+static const char *RegisterNames[16] = {"v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "va", "vb", "vc", "vd", "ve", "vf"};
+
+/// @brief Maximum number of bytes written in a single db line
+static const size_t DataBytesPerLine = 8;
+
+/**
+ * @brief Check if the instruction skips the next one under some condition
+ *
+ */
+static bool isSkip(uint16_t opcode)
+{
+    switch ((opcode & 0xf000) >> 12)
+    {
+    case 0x3:
+    case 0x4:
+    case 0x5:
+    case 0x9:
+        return true;
+    case 0xE:
+        return (opcode & 0x00ff) == 0x9e || (opcode & 0x00ff) == 0xa1;
+    }
+    return false;
+}
+
+void Disassembler::analyze(std::span<const uint8_t> rom)
+{
+    m_romSize = std::min(rom.size(), m_rom.size());
+    std::copy_n(rom.begin(), m_romSize, m_rom.begin());
+    std::fill(m_rom.begin() + m_romSize, m_rom.end(), 0);
+    std::fill(m_flags.begin(), m_flags.end(), 0);
+    m_worklist.clear();
+    m_blocks.clear();
+    m_edges.clear();
+    m_codeSize = 0;
+    m_hasIndirectJumps = false;
+
+    if (m_romSize >= 2)
+    {
+        markTarget(0, BlockStart | JumpTarget);
+        decode();
+        buildBlocks();
+        markEmittedLayout();
+    }
+}
+
+void Disassembler::markEmittedLayout()
+{
+    for (size_t address = 0; address < m_romSize;)
+    {
+        if ((m_flags[address] & InstructionStart) && address + 1 < m_romSize)
+        {
+            m_flags[address + 1] |= EmittedBody;
+            // references to the second byte are written relative to the start of the instruction which needs a label then
+            if (m_flags[address + 1] & (JumpTarget | CallTarget | DataReference))
+            {
+                m_flags[address] |= JumpTarget;
+            }
+            address += 2;
+        }
+        else
+        {
+            address++;
+        }
+    }
+}
+
+void Disassembler::markTarget(uint16_t address, uint8_t flags)
+{
+    if (address >= m_romSize)
+    {
+        return;
+    }
+    m_flags[address] |= flags;
+    if ((flags & BlockStart) && !(m_flags[address] & InstructionStart))
+    {
+        m_worklist.push_back(address);
+    }
+}
+
+void Disassembler::decode()
+{
+    while (!m_worklist.empty())
+    {
+        size_t address = m_worklist.back();
+        m_worklist.pop_back();
+        // follow the straight line code until it ends or joins already decoded code
+        while (address + 1 < m_romSize && !(m_flags[address] & InstructionStart))
+        {
+            m_flags[address] |= InstructionStart | InstructionBody;
+            m_flags[address + 1] |= InstructionBody;
+            m_codeSize += 2;
+            const uint16_t opcode = getOpcode(address);
+            const size_t next = address + 2;
+            if (opcode == 0x00e1 || opcode == 0x00ee)
+            {
+                break;
+            }
+            switch ((opcode & 0xf000) >> 12)
+            {
+            case 0x1:
+                markTarget(opcode & 0x0fff, BlockStart | JumpTarget);
+                break;
+            case 0x2:
+                markTarget(opcode & 0x0fff, BlockStart | CallTarget);
+                markTarget(next, BlockStart);
+                break;
+            case 0xA:
+                if ((opcode & 0x0fff) < m_romSize)
+                {
+                    m_flags[opcode & 0x0fff] |= DataReference;
+                }
+                break;
+            case 0xB:
+                m_hasIndirectJumps = true;
+                break;
+            }
+            if (isSkip(opcode))
+            {
+                markTarget(next, BlockStart);
+                markTarget(next + 2, BlockStart);
+            }
+            const uint8_t type = (opcode & 0xf000) >> 12;
+            if (type == 0x1 || type == 0x2 || type == 0xB || isSkip(opcode))
+            {
+                break;
+            }
+            address = next;
+        }
+    }
+}
+
+void Disassembler::buildBlocks()
+{
+    for (size_t start = 0; start < m_romSize; start++)
+    {
+        if (!(m_flags[start] & BlockStart) || !(m_flags[start] & InstructionStart))
+        {
+            continue;
+        }
+        BasicBlock block = {(uint16_t)start, (uint16_t)start, (uint32_t)m_edges.size(), 0, false};
+        size_t address = start;
+        while (true)
+        {
+            const uint16_t opcode = getOpcode(address);
+            const uint16_t next = address + 2;
+            const uint8_t type = (opcode & 0xf000) >> 12;
+            if (opcode == 0x00e1 || opcode == 0x00ee || type == 0xB)
+            {
+                block.exits = true;
+                block.end = next;
+                break;
+            }
+            if (type == 0x1)
+            {
+                m_edges.push_back(Edge{block.start, (uint16_t)(opcode & 0x0fff), EdgeType::Jump});
+                block.end = next;
+                break;
+            }
+            if (type == 0x2)
+            {
+                m_edges.push_back(Edge{block.start, (uint16_t)(opcode & 0x0fff), EdgeType::Call});
+                m_edges.push_back(Edge{block.start, next, EdgeType::Fallthrough});
+                block.end = next;
+                break;
+            }
+            if (isSkip(opcode))
+            {
+                m_edges.push_back(Edge{block.start, next, EdgeType::Fallthrough});
+                m_edges.push_back(Edge{block.start, (uint16_t)(next + 2), EdgeType::Skip});
+                block.end = next;
+                break;
+            }
+            if (!isInstruction(next) || (m_flags[next] & BlockStart))
+            {
+                // ran into another block or out of the program
+                m_edges.push_back(Edge{block.start, next, EdgeType::Fallthrough});
+                block.end = next;
+                break;
+            }
+            address = next;
+        }
+        block.edgeCount = m_edges.size() - block.firstEdge;
+        m_blocks.push_back(block);
+    }
+}
+
+bool Disassembler::needsLabel(uint16_t address) const
+{
+    return address < m_romSize && (m_flags[address] & (JumpTarget | CallTarget | DataReference));
+}
+
+std::string Disassembler::getLabel(uint16_t address) const
+{
+    char buffer[16];
+    if (address == 0)
+    {
+        return "start";
+    }
+    const char *prefix = "data";
+    if (m_flags[address] & CallTarget)
+    {
+        prefix = "sub";
+    }
+    else if ((m_flags[address] & JumpTarget) || (m_flags[address] & InstructionStart))
+    {
+        prefix = "loc";
+    }
+    std::snprintf(buffer, sizeof(buffer), "%s_%03x", prefix, address);
+    return buffer;
+}
+
+std::string Disassembler::formatAddress(uint16_t address) const
+{
+    if (address >= m_romSize)
+    {
+        char buffer[8];
+        std::snprintf(buffer, sizeof(buffer), "0x%03x", address);
+        return buffer;
+    }
+    // labels can't be placed inside of an instruction so refer to it from the start of the instruction
+    if (m_flags[address] & EmittedBody)
+    {
+        return getLabel(address - 1) + "+1";
+    }
+    return getLabel(address);
+}
+
+std::string Disassembler::formatInstruction(uint16_t address) const
+{
+    char buffer[48];
+    const uint16_t opcode = getOpcode(address);
+    const char *x = RegisterNames[(opcode & 0x0f00) >> 8];
+    const char *y = RegisterNames[(opcode & 0x00f0) >> 4];
+    const uint8_t value = opcode & 0x00ff;
+    const char *name = nullptr;
+    switch ((opcode & 0xf000) >> 12)
+    {
+    case 0x0:
+        switch (opcode)
+        {
+        case 0x00e0:
+            return "clear";
+        case 0x00e1:
+            return "hlt";
+        case 0x00e2:
+            return "render";
+        case 0x00ee:
+            return "ret";
+        }
+        break;
+    case 0x1:
+        return "jmp " + formatAddress(opcode & 0x0fff);
+    case 0x2:
+        return "call " + formatAddress(opcode & 0x0fff);
+    case 0x3:
+        std::snprintf(buffer, sizeof(buffer), "eq %s, 0x%02x", x, value);
+        return buffer;
+    case 0x4:
+        std::snprintf(buffer, sizeof(buffer), "neq %s, 0x%02x", x, value);
+        return buffer;
+    case 0x5:
+    case 0x9:
+        if ((opcode & 0x000f) == 0)
+        {
+            std::snprintf(buffer, sizeof(buffer), "%s %s, %s", (opcode & 0xf000) == 0x5000 ? "eq" : "neq", x, y);
+            return buffer;
+        }
+        break;
+    case 0x6:
+        std::snprintf(buffer, sizeof(buffer), "mov %s, 0x%02x", x, value);
+        return buffer;
+    case 0x7:
+        std::snprintf(buffer, sizeof(buffer), "add %s, 0x%02x", x, value);
+        return buffer;
+    case 0x8:
+        switch (opcode & 0x000f)
+        {
+        case 0x0:
+            name = "mov";
+            break;
+        case 0x1:
+            name = "or";
+            break;
+        case 0x2:
+            name = "and";
+            break;
+        case 0x3:
+            name = "xor";
+            break;
+        case 0x4:
+            name = "add";
+            break;
+        case 0x5:
+            name = "sub";
+            break;
+        case 0x6:
+            name = "ror";
+            break;
+        case 0x8:
+            name = "rol";
+            break;
+        }
+        if (name != nullptr)
+        {
+            std::snprintf(buffer, sizeof(buffer), "%s %s, %s", name, x, y);
+            return buffer;
+        }
+        break;
+    case 0xA:
+        return "mem " + formatAddress(opcode & 0x0fff);
+    case 0xD:
+        std::snprintf(buffer, sizeof(buffer), "draw %s, %s, %d", x, y, (opcode & 0x000f) + 1);
+        return buffer;
+    case 0xE:
+        if (value == 0x9e || value == 0xa1)
+        {
+            std::snprintf(buffer, sizeof(buffer), "%s %s", value == 0x9e ? "keydown" : "keyup", x);
+            return buffer;
+        }
+        break;
+    case 0xF:
+        switch (value)
+        {
+        case 0x07:
+            name = "gettimer";
+            break;
+        case 0x0a:
+            name = "in";
+            break;
+        case 0x15:
+            name = "settimer";
+            break;
+        case 0x18:
+            name = "beep";
+            break;
+        case 0x1e:
+            name = "memadd";
+            break;
+        }
+        if (name != nullptr)
+        {
+            std::snprintf(buffer, sizeof(buffer), "%s %s", name, x);
+            return buffer;
+        }
+        break;
+    }
+    // opcodes that the assembler has no instruction for are kept as raw words
+    std::snprintf(buffer, sizeof(buffer), "dw 0x%04x", opcode);
+    return buffer;
+}
+
+void Disassembler::writeSource(std::ostream &stream) const
+{
+    stream << "; disassembled by gob8dis\n";
+    char buffer[8];
+    for (size_t address = 0; address < m_romSize;)
+    {
+        if (needsLabel(address) || address == 0)
+        {
+            stream << getLabel(address) << ":\n";
+        }
+        if ((m_flags[address] & InstructionStart) && address + 1 < m_romSize)
+        {
+            stream << "    " << formatInstruction(address) << "\n";
+            address += 2;
+            continue;
+        }
+        stream << "    db ";
+        for (size_t count = 0; count < DataBytesPerLine && address < m_romSize; count++, address++)
+        {
+            if (count > 0)
+            {
+                if (needsLabel(address) || (m_flags[address] & InstructionStart))
+                {
+                    break;
+                }
+                stream << ", ";
+            }
+            std::snprintf(buffer, sizeof(buffer), "0x%02x", m_rom[address]);
+            stream << buffer;
+        }
+        stream << "\n";
+    }
+}
+
+void Disassembler::writeDot(std::ostream &stream, std::string const &name) const
+{
+    static const char *EdgeNames[] = {"", "jmp", "call", "skip"};
+    char buffer[32];
+    stream << "digraph \"" << name << "\" {\n";
+    stream << "    node [shape=box fontname=monospace];\n";
+    for (BasicBlock const &block : m_blocks)
+    {
+        std::snprintf(buffer, sizeof(buffer), "b_%03x", block.start);
+        stream << "    " << buffer << " [label=\"" << getLabel(block.start) << ":\\l";
+        for (uint16_t address = block.start; address < block.end; address += 2)
+        {
+            std::snprintf(buffer, sizeof(buffer), "%03x  %04x  ", address, getOpcode(address));
+            stream << buffer << formatInstruction(address) << "\\l";
+        }
+        stream << "\"" << (block.exits ? " peripheries=2" : "") << "];\n";
+    }
+    for (Edge const &edge : m_edges)
+    {
+        if (edge.to >= m_romSize || !isInstruction(edge.to))
+        {
+            continue;
+        }
+        std::snprintf(buffer, sizeof(buffer), "b_%03x -> b_%03x", edge.from, edge.to);
+        stream << "    " << buffer;
+        if (edge.type != EdgeType::Fallthrough)
+        {
+            stream << " [label=\"" << EdgeNames[(int)edge.type] << "\"" << (edge.type == EdgeType::Call ? " style=dashed" : "") << "]";
+        }
+        stream << ";\n";
+    }
+    stream << "}\n";
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Type of the connection between two basic blocks
+ *
+ */
+enum class EdgeType
+{
+    /// @brief Execution continues to the next instruction
+    Fallthrough,
+    /// @brief Jump instruction
+    Jump,
+    /// @brief Call instruction, execution continues after the call once the subroutine returns
+    Call,
+    /// @brief Skip instruction skipped the next instruction
+    Skip
+};
+
+struct Edge
+{
+    uint16_t from;
+    uint16_t to;
+    EdgeType type;
+};
+
+/**
+ * @brief Sequence of instructions that is always executed from the start to the end
+ *
+ */
+struct BasicBlock
+{
+    uint16_t start;
+    /// @brief Address right after the last instruction of the block
+    uint16_t end;
+    /// @brief Index of the first outgoing edge in the edge list
+    uint32_t firstEdge;
+    uint32_t edgeCount;
+    /// @brief Block ends with an instruction that leaves the function: ret, halt or jump by register
+    bool exits;
+};
+
+/**
+ * @brief Decodes the program and recovers its control flow by following jumps, calls and skips from the entry point.
+ * Bytes that are never reached are treated as data. Results can be written as source that gob8asm can assemble back
+ * into the same bytes or as a graph in DOT format.
+ *
+ * Object can be reused for many programs, all buffers keep their capacity between calls to analyze
+ */
+class Disassembler
+{
+public:
+    /**
+     * @brief Decode the program and build the control flow graph
+     *
+     * @param rom Bytes of the program, loaded at address 0
+     */
+    void analyze(std::span<const uint8_t> rom);
+
+    /// @brief Check if an instruction starts at the address
+    bool isInstruction(uint16_t address) const { return address < m_romSize && (m_flags[address] & InstructionStart); }
+
+    /// @brief Check if the address is a target of a call instruction
+    bool isCallTarget(uint16_t address) const { return address < m_romSize && (m_flags[address] & CallTarget); }
+
+    uint16_t getOpcode(uint16_t address) const { return (m_rom[address] << 8) | m_rom[address + 1]; }
+
+    size_t getRomSize() const { return m_romSize; }
+
+    std::vector<BasicBlock> const &getBlocks() const { return m_blocks; }
+
+    std::vector<Edge> const &getEdges() const { return m_edges; }
+
+    /// @brief True if the program uses jumps by register(BNNN) which can't be followed statically
+    bool hasIndirectJumps() const { return m_hasIndirectJumps; }
+
+    /// @brief Number of bytes that were decoded as instructions
+    size_t getCodeSize() const { return m_codeSize; }
+
+    /**
+     * @brief Write the program as gob8asm source
+     *
+     * @param stream Stream to write to
+     */
+    void writeSource(std::ostream &stream) const;
+
+    /**
+     * @brief Write the control flow graph in DOT format
+     *
+     * @param stream Stream to write to
+     * @param name Name of the graph
+     */
+    void writeDot(std::ostream &stream, std::string const &name) const;
+
+    /**
+     * @brief Get text of the instruction in gob8asm syntax
+     *
+     * @param address Address of the instruction
+     * @return std::string Instruction or dw with the raw value for opcodes that the assembler can't produce
+     */
+    std::string formatInstruction(uint16_t address) const;
+
+private:
+    enum AddressFlags : uint8_t
+    {
+        InstructionStart = 1 << 0,
+        /// @brief Byte is part of an instruction
+        InstructionBody = 1 << 1,
+        BlockStart = 1 << 2,
+        JumpTarget = 1 << 3,
+        CallTarget = 1 << 4,
+        DataReference = 1 << 5,
+        /// @brief Second byte of an instruction that is written to the source, no label can be placed here
+        EmittedBody = 1 << 6
+    };
+
+    /// @brief Decode instructions starting from every address in the worklist
+    void decode();
+
+    void buildBlocks();
+
+    /// @brief Find second bytes of instructions that will be written to the source, since no label can be declared there
+    void markEmittedLayout();
+
+    void markTarget(uint16_t address, uint8_t flags);
+
+    /**
+     * @brief Get text used to refer to the address in the source. Addresses outside of the program are written as numbers
+     *
+     */
+    std::string formatAddress(uint16_t address) const;
+
+    std::string getLabel(uint16_t address) const;
+
+    bool needsLabel(uint16_t address) const;
+
+    std::array<uint8_t, TOTAL_MEMORY_SIZE> m_rom;
+    std::array<uint8_t, TOTAL_MEMORY_SIZE> m_flags;
+    size_t m_romSize = 0;
+    size_t m_codeSize = 0;
+    bool m_hasIndirectJumps = false;
+    std::vector<uint16_t> m_worklist;
+    std::vector<BasicBlock> m_blocks;
+    std::vector<Edge> m_edges;
+};
@@ -1,4 +1,21 @@
 #include "DisplaySDL.hpp"
+#include <algorithm>
+#include <cstring>
+
+static const int VideoWidth = 64;
+static const int VideoHeight = 32;
+
+/// @brief Title of the window when the overlay is hidden
+static const char *WindowTitle = "Gob-8";
+
+/// @brief Height of the overlay bar in pixels
+static const int OverlayHeight = 6;
+
+/// @brief Colors of the overlay bar parts, repeated if there are more parts
+static const SDL_Color OverlayColors[] = {{220, 60, 60, 255}, {230, 200, 50, 255}, {60, 120, 230, 255}, {90, 90, 90, 255}};
+
+/// @brief Part of the brightness out of 256 that pixels keep every frame after being turned off when phosphor persistence is enabled
+static const uint16_t PhosphorDecay = 160;
 
 DisplaySDL::DisplaySDL()
 {
@@ -6,7 +23,7 @@ DisplaySDL::DisplaySDL()
     {
         throw DisplayError(std::string("Failed to init sdl. Error: ") + SDL_GetError());
     }
-    m_window = SDL_CreateWindow("Gob-8", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 640, 320, SDL_WINDOW_SHOWN);
+    m_window = SDL_CreateWindow(WindowTitle, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 640, 320, SDL_WINDOW_SHOWN);
     if (m_window == nullptr)
     {
         throw DisplayError(std::string("Failed to create window. Error:") + SDL_GetError());
@@ -38,10 +55,57 @@ DisplaySDL::DisplaySDL()
     backgroundColor.r = 0;
     m_secondaryColor = backgroundColor;
     m_primaryColor = color;
+
+    std::fill(m_brightness.begin(), m_brightness.end(), 0);
+    // anything but 32 bit window surface or window that is too small goes through the general scaling blit instead
+    if (m_windowSurface->format->BytesPerPixel == 4)
+    {
+        m_scale = std::min(m_windowSurface->w / VideoWidth, m_windowSurface->h / VideoHeight);
+        m_offsetX = (m_windowSurface->w - VideoWidth * m_scale) / 2;
+        m_offsetY = (m_windowSurface->h - VideoHeight * m_scale) / 2;
+        m_scaledRow.resize(VideoWidth * m_scale);
+        buildPalette();
+        SDL_FillRect(m_windowSurface, nullptr, m_palette[0]);
+    }
+}
+
+void DisplaySDL::buildPalette()
+{
+    for (size_t i = 0; i < m_palette.size(); i++)
+    {
+        auto mix = [i](uint8_t background, uint8_t foreground)
+        { return (uint8_t)((background * (255 - i) + foreground * i) / 255); };
+        m_palette[i] = SDL_MapRGB(m_windowSurface->format,
+                                  mix(m_secondaryColor.r, m_primaryColor.r),
+                                  mix(m_secondaryColor.g, m_primaryColor.g),
+                                  mix(m_secondaryColor.b, m_primaryColor.b));
+    }
 }
 
 void DisplaySDL::update(std::array<uint8_t, TOTAL_VIDEO_MEMORY_SIZE> const &videoData)
 {
+    if (m_scale > 0)
+    {
+        // both loops are simple enough for the compiler to vectorize
+        if (m_phosphorEnabled)
+        {
+            for (size_t i = 0; i < videoData.size(); i++)
+            {
+                const uint8_t lit = videoData[i] ? 255 : 0;
+                const uint8_t faded = (m_brightness[i] * PhosphorDecay) >> 8;
+                m_brightness[i] = std::max(lit, faded);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < videoData.size(); i++)
+            {
+                m_brightness[i] = videoData[i] ? 255 : 0;
+            }
+        }
+        blitScaled();
+        return;
+    }
     SDL_LockSurface(m_surface);
     uint8_t *pixels = (uint8_t *)m_surface->pixels;
     // for (int i = 0; i < 64 * 32; i++)
@@ -65,12 +129,75 @@ void DisplaySDL::update(std::array<uint8_t, TOTAL_VIDEO_MEMORY_SIZE> const &vide
     SDL_UnlockSurface(m_surface);
 }
 
+void DisplaySDL::blitScaled()
+{
+    SDL_LockSurface(m_windowSurface);
+    uint8_t *pixels = (uint8_t *)m_windowSurface->pixels + m_offsetY * m_windowSurface->pitch + m_offsetX * sizeof(uint32_t);
+    const size_t rowSize = m_scaledRow.size() * sizeof(uint32_t);
+    for (int y = 0; y < VideoHeight; y++)
+    {
+        uint32_t *row = m_scaledRow.data();
+        for (int x = 0; x < VideoWidth; x++)
+        {
+            std::fill_n(row, m_scale, m_palette[m_brightness[y * VideoWidth + x]]);
+            row += m_scale;
+        }
+        for (int i = 0; i < m_scale; i++)
+        {
+            std::memcpy(pixels + (y * m_scale + i) * m_windowSurface->pitch, m_scaledRow.data(), rowSize);
+        }
+    }
+    SDL_UnlockSurface(m_windowSurface);
+}
+
 void DisplaySDL::render()
 {
-    SDL_BlitScaled(m_surface, 0, m_windowSurface, 0);
+    if (m_scale == 0)
+    {
+        SDL_BlitScaled(m_surface, 0, m_windowSurface, 0);
+    }
+    if (m_overlayVisible)
+    {
+        drawOverlay();
+    }
     SDL_UpdateWindowSurface(m_window);
 }
 
+void DisplaySDL::setOverlay(std::string const &text, std::vector<double> const &parts)
+{
+    m_overlayVisible = true;
+    m_overlayParts = parts;
+    SDL_SetWindowTitle(m_window, (std::string(WindowTitle) + " | " + text).c_str());
+}
+
+void DisplaySDL::hideOverlay()
+{
+    m_overlayVisible = false;
+    SDL_SetWindowTitle(m_window, WindowTitle);
+}
+
+void DisplaySDL::drawOverlay()
+{
+    SDL_Rect rect = {0, m_windowSurface->h - OverlayHeight, 0, OverlayHeight};
+    for (size_t i = 0; i < m_overlayParts.size(); i++)
+    {
+        SDL_Color const &color = OverlayColors[i % (sizeof(OverlayColors) / sizeof(OverlayColors[0]))];
+        rect.w = (int)(m_overlayParts[i] * m_windowSurface->w + 0.5);
+        SDL_FillRect(m_windowSurface, &rect, SDL_MapRGB(m_windowSurface->format, color.r, color.g, color.b));
+        rect.x += rect.w;
+    }
+}
+
+int DisplaySDL::getRefreshRate() const
+{
+    SDL_DisplayMode mode;
+    if (SDL_GetCurrentDisplayMode(0, &mode) != 0 || mode.refresh_rate <= 0)
+    {
+        return 60;
+    }
+    return mode.refresh_rate;
+}
+
 void DisplaySDL::handleInput()
 {
 }
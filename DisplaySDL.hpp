@@ -1,4 +1,5 @@
 #pragma once
+#include <vector>
 #include "Display.hpp"
 
 /**
@@ -13,12 +14,44 @@ public:
 
     SDL_Surface *getSurface() const { return m_surface; }
 
+    /// @brief Get refresh rate of the display the window is on, 60 if it is not known
+    int getRefreshRate() const;
+
+    /**
+     * @brief Enable phosphor persistence. Pixels that are turned off fade out over a few frames instead of disappearing at once,
+     * which hides flicker of sprites that are erased and redrawn with XOR every frame
+     *
+     * @param enabled
+     */
+    void setPhosphorEnabled(bool enabled) { m_phosphorEnabled = enabled; }
+
+    /// @brief Number of bytes of sound that are waiting to be played
+    uint32_t getQueuedAudioSize() const { return SDL_GetQueuedAudioSize(1); }
+
+    /**
+     * @brief Show performance information on top of the picture. Text goes into the window title and parts are drawn as a stacked bar along the bottom edge
+     *
+     * @param text Text to show
+     * @param parts Fractions of the window width for each part of the bar, every part has its own color
+     */
+    void setOverlay(std::string const &text, std::vector<double> const &parts);
+
+    void hideOverlay();
+
     void render() override;
     void handleInput() override;
     void playSound() override;
     virtual ~DisplaySDL();
 
 private:
+    /// @brief Fill the palette with colors between background and foreground in the format of the window surface
+    void buildPalette();
+
+    /// @brief Write brightness of every pixel straight into the window surface scaled by a whole number
+    void blitScaled();
+
+    void drawOverlay();
+
     SDL_Surface *m_surface;
     SDL_Surface *m_windowSurface;
     SDL_Color m_primaryColor;
@@ -27,4 +60,18 @@ private:
     uint8_t *m_beepAudioBuffer;
     uint32_t m_beepAudioLength;
     SDL_AudioSpec m_wavSpec;
+
+    /// @brief Whole number the video is scaled by when written directly into the window surface, 0 if the format of the window surface is not supported
+    int m_scale = 0;
+    int m_offsetX = 0;
+    int m_offsetY = 0;
+    bool m_phosphorEnabled = false;
+    /// @brief Window surface colors for every brightness value
+    std::array<uint32_t, 256> m_palette;
+    /// @brief Brightness of every pixel of the video memory
+    std::array<uint8_t, TOTAL_VIDEO_MEMORY_SIZE> m_brightness;
+    /// @brief Single scaled row which is then copied into the window surface as many times as the scale is
+    std::vector<uint32_t> m_scaledRow;
+    bool m_overlayVisible = false;
+    std::vector<double> m_overlayParts;
 };
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include "Fuzzer.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+/// @brief Number of mutations stacked on top of each other is chosen up to this
+static const size_t MaxStackedMutations = 4;
+
+std::string FuzzInput::serialize() const
+{
+    std::stringstream stream;
+    stream << std::hex;
+    for (KeyEvent const &event : keyEvents)
+    {
+        stream << "keys " << std::dec << event.frame << std::hex << " " << std::setw(4) << std::setfill('0') << event.keys << "\n";
+    }
+    for (Patch const &patch : patches)
+    {
+        stream << "patch " << std::setw(3) << std::setfill('0') << patch.address << " " << std::setw(2) << (int)patch.value << "\n";
+    }
+    return stream.str();
+}
+
+FuzzInput FuzzInput::parse(std::string const &text)
+{
+    FuzzInput input;
+    std::stringstream stream(text);
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(stream, line); lineNumber++)
+    {
+        std::stringstream lineStream(line);
+        std::string kind;
+        if (!(lineStream >> kind) || kind[0] == '#')
+        {
+            continue;
+        }
+        if (kind == "keys")
+        {
+            KeyEvent event;
+            if (!(lineStream >> std::dec >> event.frame >> std::hex >> event.keys))
+            {
+                throw FuzzError("Line " + std::to_string(lineNumber) + ": expected frame and key mask");
+            }
+            input.keyEvents.push_back(event);
+        }
+        else if (kind == "patch")
+        {
+            unsigned address, value;
+            if (!(lineStream >> std::hex >> address >> value) || address >= TOTAL_MEMORY_SIZE || value > 0xff)
+            {
+                throw FuzzError("Line " + std::to_string(lineNumber) + ": expected address and byte");
+            }
+            input.patches.push_back({(uint16_t)address, (uint8_t)value});
+        }
+        else
+        {
+            throw FuzzError("Line " + std::to_string(lineNumber) + ": unknown event " + kind);
+        }
+    }
+    std::stable_sort(input.keyEvents.begin(), input.keyEvents.end(), [](KeyEvent const &a, KeyEvent const &b)
+                     { return a.frame < b.frame; });
+    return input;
+}
+
+const char *getFuzzOutcomeName(FuzzOutcome outcome)
+{
+    switch (outcome)
+    {
+    case FuzzOutcome::Finished:
+        return "finished";
+    case FuzzOutcome::Stuck:
+        return "stuck";
+    case FuzzOutcome::Halted:
+        return "halted";
+    case FuzzOutcome::ProgramCounterOutOfMemory:
+        return "pc-out-of-memory";
+    case FuzzOutcome::StackUnderflow:
+        return "stack-underflow";
+    case FuzzOutcome::VideoOverflow:
+        return "video-overflow";
+    case FuzzOutcome::KeyOutOfRange:
+        return "key-out-of-range";
+    }
+    return "unknown";
+}
+
+Fuzzer::Fuzzer(std::vector<uint8_t> const &program, Config const &config)
+    : m_program(program), m_config(config), m_machine(program), m_random(config.seed)
+{
+    if (program.empty())
+    {
+        throw FuzzError("Program is empty");
+    }
+    if (program.size() > TOTAL_MEMORY_SIZE)
+    {
+        throw FuzzError("Program does not fit into memory");
+    }
+    m_machine.saveSnapshot();
+    m_traceEdges.reserve(MapSize);
+    // empty input is the seed of the corpus
+    size_t programCounter;
+    FuzzInput seed;
+    execute(seed, programCounter);
+    mergeCoverage();
+    m_corpus.push_back(seed);
+}
+
+void Fuzzer::fuzzOnce()
+{
+    FuzzInput input = mutate(m_corpus[m_random() % m_corpus.size()]);
+    size_t programCounter;
+    const FuzzOutcome outcome = execute(input, programCounter);
+    const bool interesting = mergeCoverage();
+    if (outcome > FuzzOutcome::Halted)
+    {
+        const bool known = std::any_of(m_findings.begin(), m_findings.end(), [&](Finding const &finding)
+                                       { return finding.outcome == outcome && finding.programCounter == programCounter; });
+        if (!known)
+        {
+            m_findings.push_back({outcome, programCounter, input});
+        }
+        return;
+    }
+    if (interesting)
+    {
+        m_corpus.push_back(std::move(input));
+    }
+}
+
+FuzzOutcome Fuzzer::execute(FuzzInput const &input, size_t &programCounter)
+{
+    m_executionCount++;
+    m_machine.reset();
+    // CXNN draws from rand, without a fresh seed an input would not replay the same way it was found
+    std::srand(m_config.seed);
+    for (FuzzInput::Patch const &patch : input.patches)
+    {
+        m_machine.writeMemory(patch.address, std::span<const uint8_t>(&patch.value, 1));
+    }
+    size_t nextEvent = 0;
+    uint16_t keys = 0;
+    size_t previous = 0;
+    programCounter = m_machine.getProgramCounter();
+    for (size_t frame = 0; frame < m_config.maxFrames; frame++)
+    {
+        if (nextEvent < input.keyEvents.size() && input.keyEvents[nextEvent].frame <= frame)
+        {
+            while (nextEvent < input.keyEvents.size() && input.keyEvents[nextEvent].frame <= frame)
+            {
+                keys = input.keyEvents[nextEvent++].keys;
+            }
+            m_machine.setKeyStates(keys);
+        }
+        if (!m_machine.beginFrame(keys))
+        {
+            if (m_machine.isAwaitingInput() && nextEvent == input.keyEvents.size())
+            {
+                return FuzzOutcome::Stuck;
+            }
+            continue;
+        }
+        for (size_t i = 0; i < m_config.instructionsPerFrame && !m_machine.isAwaitingInput(); i++)
+        {
+            programCounter = m_machine.getProgramCounter();
+            const uint16_t opcode = m_machine.getMemory().readWord(programCounter);
+            const FuzzOutcome bug = checkInstruction(opcode);
+            if (bug != FuzzOutcome::Finished)
+            {
+                return bug;
+            }
+            recordEdge(previous, programCounter);
+            previous = programCounter;
+            m_machine.step();
+            if (m_machine.isHalted())
+            {
+                return opcode == 0x00e1 ? FuzzOutcome::Halted : FuzzOutcome::ProgramCounterOutOfMemory;
+            }
+        }
+    }
+    return FuzzOutcome::Finished;
+}
+
+FuzzOutcome Fuzzer::checkInstruction(uint16_t opcode)
+{
+    std::array<uint8_t, 16> const &registers = m_machine.getRegisters();
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        if (opcode == 0x00ee && !m_machine.hasValueOnStack())
+        {
+            return FuzzOutcome::StackUnderflow;
+        }
+        break;
+    case 0xD:
+    {
+        // last pixel the sprite touches, see Machine::opDraw
+        const size_t x = registers[(opcode & 0x0f00) >> 8];
+        const size_t y = registers[(opcode & 0x00f0) >> 4];
+        if (x + (y + (opcode & 0x000f)) * 64 + 8 >= TOTAL_VIDEO_MEMORY_SIZE)
+        {
+            return FuzzOutcome::VideoOverflow;
+        }
+    }
+    break;
+    case 0xE:
+        if (((opcode & 0xff) == 0x9e || (opcode & 0xff) == 0xa1) && registers[(opcode & 0x0f00) >> 8] >= 16)
+        {
+            return FuzzOutcome::KeyOutOfRange;
+        }
+        break;
+    }
+    return FuzzOutcome::Finished;
+}
+
+void Fuzzer::recordEdge(size_t from, size_t to)
+{
+    const uint16_t edge = (uint32_t)((from * TOTAL_MEMORY_SIZE + to) * 2654435761u) >> 16;
+    if (m_trace[edge] == 0)
+    {
+        m_traceEdges.push_back(edge);
+    }
+    m_trace[edge] += m_trace[edge] != 0xff;
+}
+
+bool Fuzzer::mergeCoverage()
+{
+    bool interesting = false;
+    for (uint16_t edge : m_traceEdges)
+    {
+        // buckets of hit counts: 1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+
+        const uint8_t count = m_trace[edge];
+        const uint8_t bucket = count <= 3 ? 1 << (count - 1) : count < 8 ? 8 : count < 16 ? 16 : count < 32 ? 32 : count < 128 ? 64 : 128;
+        if ((m_coverage[edge] & bucket) == 0)
+        {
+            m_edgeCount += m_coverage[edge] == 0;
+            m_coverage[edge] |= bucket;
+            interesting = true;
+        }
+        m_trace[edge] = 0;
+    }
+    m_traceEdges.clear();
+    return interesting;
+}
+
+FuzzInput Fuzzer::mutate(FuzzInput input)
+{
+    const size_t mutationCount = 1 + m_random() % MaxStackedMutations;
+    for (size_t i = 0; i < mutationCount; i++)
+    {
+        const size_t mutation = m_random() % (m_config.mutateProgram ? 7 : 4);
+        std::vector<FuzzInput::KeyEvent> &events = input.keyEvents;
+        std::vector<FuzzInput::Patch> &patches = input.patches;
+        switch (mutation)
+        {
+        // add key event
+        case 0:
+            if (events.size() < MaxKeyEvents)
+            {
+                events.push_back({(uint32_t)(m_random() % m_config.maxFrames), (uint16_t)(1 << (m_random() % 16))});
+            }
+            break;
+        // flip a key of an event
+        case 1:
+            if (!events.empty())
+            {
+                events[m_random() % events.size()].keys ^= 1 << (m_random() % 16);
+            }
+            break;
+        // move an event to another frame
+        case 2:
+            if (!events.empty())
+            {
+                events[m_random() % events.size()].frame = m_random() % m_config.maxFrames;
+            }
+            break;
+        // remove an event, or take the events of another input
+        case 3:
+            if (!events.empty() && m_random() % 2 == 0)
+            {
+                events.erase(events.begin() + m_random() % events.size());
+            }
+            else
+            {
+                FuzzInput const &other = m_corpus[m_random() % m_corpus.size()];
+                events.insert(events.end(), other.keyEvents.begin(), other.keyEvents.end());
+                events.resize(std::min(events.size(), MaxKeyEvents));
+            }
+            break;
+        // replace a byte of the program with a random one
+        case 4:
+            if (patches.size() < MaxPatches)
+            {
+                patches.push_back({(uint16_t)(m_random() % m_program.size()), (uint8_t)m_random()});
+            }
+            break;
+        // flip a bit of a byte of the program
+        case 5:
+            if (patches.size() < MaxPatches)
+            {
+                const uint16_t address = m_random() % m_program.size();
+                patches.push_back({address, (uint8_t)(m_program[address] ^ (1 << (m_random() % 8)))});
+            }
+            break;
+        // remove a patch
+        case 6:
+            if (!patches.empty())
+            {
+                patches.erase(patches.begin() + m_random() % patches.size());
+            }
+            break;
+        }
+    }
+    std::stable_sort(input.keyEvents.begin(), input.keyEvents.end(), [](FuzzInput::KeyEvent const &a, FuzzInput::KeyEvent const &b)
+                     { return a.frame < b.frame; });
+    return input;
+}
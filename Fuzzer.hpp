@@ -0,0 +1,153 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Machine.hpp"
+
+/**
+ * @brief Exception class for errors in fuzzer inputs
+ *
+ */
+class FuzzError : public std::runtime_error
+{
+public:
+    explicit FuzzError(std::string const &msg) : std::runtime_error(msg) {}
+};
+
+/**
+ * @brief Everything the fuzzer controls in a single execution: keys held down from given frames on and bytes of the program replaced before the start.
+ * Stored as text with one event per line
+ * @code
+ * keys <frame> <key mask in hex>
+ * patch <address in hex> <byte in hex>
+ * @endcode
+ */
+struct FuzzInput
+{
+    struct KeyEvent
+    {
+        uint32_t frame;
+        /// @brief Bit N set means key N is held down
+        uint16_t keys;
+    };
+    struct Patch
+    {
+        uint16_t address;
+        uint8_t value;
+    };
+    /// @brief Sorted by frame
+    std::vector<KeyEvent> keyEvents;
+    std::vector<Patch> patches;
+
+    std::string serialize() const;
+
+    static FuzzInput parse(std::string const &text);
+};
+
+/**
+ * @brief How an execution ended, everything after Halted is a bug in the program that the fuzzer reports
+ *
+ */
+enum class FuzzOutcome
+{
+    /// @brief All frames were executed
+    Finished,
+    /// @brief Waiting for input with no more key events left
+    Stuck,
+    /// @brief Halt instruction was executed
+    Halted,
+    /// @brief Program counter left the memory without a halt instruction
+    ProgramCounterOutOfMemory,
+    /// @brief Return with an empty stack
+    StackUnderflow,
+    /// @brief Sprite would be drawn past the end of the video memory
+    VideoOverflow,
+    /// @brief Key instruction with a register that holds no valid key
+    KeyOutOfRange,
+};
+
+const char *getFuzzOutcomeName(FuzzOutcome outcome);
+
+/**
+ * @brief Coverage guided fuzzer for programs. Inputs from the corpus are mutated and executed on a machine that is reset to its snapshot
+ * between executions, so an execution only pays for the pages and buffers it modified. Coverage is counted per edge between the addresses
+ * of consecutive instructions, with hit counts put into buckets the same way AFL does. Inputs that reach a new edge or bucket join the corpus,
+ * inputs that end in a new kind of bug at a new address are kept as findings
+ */
+class Fuzzer
+{
+public:
+    struct Config
+    {
+        /// @brief Frames per execution, a frame advances the timers once
+        size_t maxFrames = 1000;
+        size_t instructionsPerFrame = 1;
+        /// @brief Also mutate bytes of the program, not only the keys
+        bool mutateProgram = true;
+        uint32_t seed = 1;
+    };
+
+    struct Finding
+    {
+        FuzzOutcome outcome;
+        /// @brief Address of the instruction that caused the bug
+        size_t programCounter;
+        FuzzInput input;
+    };
+
+    explicit Fuzzer(std::vector<uint8_t> const &program, Config const &config);
+
+    /// @brief Mutate an input from the corpus and execute it
+    void fuzzOnce();
+
+    /**
+     * @brief Execute the input and collect its coverage, without changing the corpus
+     *
+     * @param input Input to execute
+     * @param programCounter Set to the address of the last executed instruction
+     * @return FuzzOutcome How the execution ended
+     */
+    FuzzOutcome execute(FuzzInput const &input, size_t &programCounter);
+
+    size_t getExecutionCount() const { return m_executionCount; }
+    size_t getCorpusSize() const { return m_corpus.size(); }
+    /// @brief Number of distinct edges reached by any execution so far
+    size_t getEdgeCount() const { return m_edgeCount; }
+    std::vector<Finding> const &getFindings() const { return m_findings; }
+
+private:
+    static constexpr size_t MapSize = 1 << 16;
+    static constexpr size_t MaxKeyEvents = 64;
+    static constexpr size_t MaxPatches = 32;
+
+    /// @brief Check the instruction for bugs before it is executed
+    FuzzOutcome checkInstruction(uint16_t opcode);
+
+    void recordEdge(size_t from, size_t to);
+
+    /// @brief Merge coverage of the last execution into the total and clear it
+    bool mergeCoverage();
+
+    FuzzInput mutate(FuzzInput input);
+
+    std::vector<uint8_t> m_program;
+    Config m_config;
+    Machine m_machine;
+    std::mt19937 m_random;
+
+    std::vector<FuzzInput> m_corpus;
+    std::vector<Finding> m_findings;
+
+    /// @brief Hit counts of the edges in the current execution
+    std::array<uint8_t, MapSize> m_trace = {};
+    /// @brief Edges hit by the current execution, so that only they are merged and cleared
+    std::vector<uint16_t> m_traceEdges;
+    /// @brief Hit count buckets seen for every edge in any execution
+    std::array<uint8_t, MapSize> m_coverage = {};
+    size_t m_edgeCount = 0;
+    size_t m_executionCount = 0;
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <SDL.h>
+
+static const std::vector<SDL_Scancode> Keymap = {
+    // wasd
+    SDL_Scancode::SDL_SCANCODE_W, // 0x1
+    SDL_Scancode::SDL_SCANCODE_A, // 0x2
+    SDL_Scancode::SDL_SCANCODE_S, // 0x3
+    SDL_Scancode::SDL_SCANCODE_D, // 0x4
+    // arrows
+    SDL_Scancode::SDL_SCANCODE_UP,    // 0x5
+    SDL_Scancode::SDL_SCANCODE_DOWN,  // 0x6
+    SDL_Scancode::SDL_SCANCODE_LEFT,  // 0x7
+    SDL_Scancode::SDL_SCANCODE_RIGHT, // 0x8
+    // input right
+    SDL_Scancode::SDL_SCANCODE_LSHIFT, // 0x9
+    SDL_Scancode::SDL_SCANCODE_SPACE,  // 0xa
+    // input left
+    SDL_Scancode::SDL_SCANCODE_RSHIFT, // 0xb
+    SDL_Scancode::SDL_SCANCODE_RCTRL,  // 0xc
+    // pause
+    SDL_Scancode::SDL_SCANCODE_ESCAPE,   // 0xd
+    SDL_Scancode::SDL_SCANCODE_TAB,      // 0xe
+    SDL_Scancode::SDL_SCANCODE_BACKSPACE // 0xf
+};
+
+/**
+ * @brief Get the machine key for the keyboard key
+ *
+ * @return std::optional<uint8_t> Key of the machine or empty value if the keyboard key is not mapped
+ */
+inline std::optional<uint8_t> handleInput(SDL_Scancode key)
+{
+    std::vector<SDL_Scancode>::const_iterator it = std::find(Keymap.begin(), Keymap.end(), key);
+    if (it == Keymap.end())
+    {
+        return {};
+    }
+    return (it - Keymap.begin() + 1);
+}
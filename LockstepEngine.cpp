@@ -0,0 +1,489 @@
+#include "LockstepEngine.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+LockstepEngine::LockstepEngine(std::shared_ptr<const PagedMemory::Image> image, size_t laneCount)
+    : m_laneCount(laneCount), m_image(std::move(image)),
+      m_registers(16 * laneCount, 0),
+      m_programCounters(laneCount, 0),
+      m_memoryRegisters(laneCount, 0),
+      m_stackPointers(laneCount, TOTAL_MEMORY_SIZE - 1),
+      m_timers(laneCount, 0),
+      m_audioTimers(laneCount, 0),
+      m_keystates(laneCount, 0),
+      m_inputAwaitDestinationRegisters(laneCount, NotAwaitingInput),
+      m_usingPrimaryVideoBuffer(laneCount, 1),
+      m_executed(laneCount, 0),
+      m_memory(TOTAL_MEMORY_SIZE * laneCount),
+      m_video(2 * TOTAL_VIDEO_MEMORY_SIZE * laneCount, 0),
+      m_active(laneCount),
+      m_mask(laneCount),
+      m_condition(laneCount),
+      m_groupIndices(laneCount),
+      m_opcodes(laneCount),
+      m_random(laneCount)
+{
+    for (size_t address = 0; address < TOTAL_MEMORY_SIZE; address++)
+    {
+        std::memset(getMemoryRow(address), m_image->read(address), m_laneCount);
+    }
+}
+
+size_t LockstepEngine::run(size_t steps)
+{
+    size_t executed = 0;
+    for (size_t i = 0; i < steps; i++)
+    {
+        const size_t lanes = step();
+        if (lanes == 0)
+        {
+            break;
+        }
+        executed += lanes;
+    }
+    return executed;
+}
+
+size_t LockstepEngine::step()
+{
+    // lane count is read once, stores through the byte arrays could otherwise alias it and keep loops from vectorizing
+    const size_t laneCount = m_laneCount;
+    uint8_t *active = m_active.data();
+    const uint32_t *programCounters = m_programCounters.data();
+    const uint8_t *awaiting = m_inputAwaitDestinationRegisters.data();
+    size_t activeCount = 0;
+    for (size_t lane = 0; lane < laneCount; lane++)
+    {
+        active[lane] = (programCounters[lane] < TOTAL_MEMORY_SIZE) & (awaiting[lane] == NotAwaitingInput);
+        activeCount += active[lane];
+    }
+    if (activeCount == 0)
+    {
+        return 0;
+    }
+    const size_t leader = std::find(m_active.begin(), m_active.end(), 1) - m_active.begin();
+    const uint32_t leaderProgramCounter = programCounters[leader];
+    size_t diverged = 0;
+    for (size_t lane = 0; lane < laneCount; lane++)
+    {
+        diverged += active[lane] & (programCounters[lane] != leaderProgramCounter);
+    }
+    const size_t nextAddress = (leaderProgramCounter + 1) % TOTAL_MEMORY_SIZE;
+    const uint64_t codePages = (1ull << (leaderProgramCounter / PagedMemory::PageSize)) | (1ull << (nextAddress / PagedMemory::PageSize));
+    if (diverged == 0 && (m_writtenPages & codePages) == 0)
+    {
+        // every lane is at the same instruction which is still the same as in the image
+        const uint16_t opcode = (m_image->read(leaderProgramCounter) << 8) | m_image->read(nextAddress);
+        if ((opcode & 0xf000) == 0xC000)
+        {
+            for (size_t lane = 0; lane < laneCount; lane++)
+            {
+                m_random[lane] = active[lane] ? rand() : 0;
+            }
+        }
+        execute(opcode, active, 0, m_laneCount);
+    }
+    else
+    {
+        uint16_t *opcodes = m_opcodes.data();
+        // group index of every lane, lanes outside of any group run alone
+        uint8_t *groupIndices = m_groupIndices.data();
+        std::array<uint16_t, MaxGroups> groups;
+        size_t groupCount = 0;
+        bool ungrouped = false;
+        for (size_t lane = 0; lane < laneCount; lane++)
+        {
+            groupIndices[lane] = MaxGroups;
+            if (!active[lane])
+            {
+                continue;
+            }
+            opcodes[lane] = (readMemory(lane, programCounters[lane]) << 8) | readMemory(lane, programCounters[lane] + 1);
+            if ((opcodes[lane] & 0xf000) == 0xC000)
+            {
+                m_random[lane] = rand();
+            }
+            const size_t group = std::find(groups.begin(), groups.begin() + groupCount, opcodes[lane]) - groups.begin();
+            if (group < groupCount)
+            {
+                groupIndices[lane] = group;
+            }
+            else if (groupCount < MaxGroups)
+            {
+                groups[groupCount] = opcodes[lane];
+                groupIndices[lane] = groupCount++;
+            }
+            else
+            {
+                ungrouped = true;
+            }
+        }
+        uint8_t *mask = m_mask.data();
+        for (size_t group = 0; group < groupCount; group++)
+        {
+            for (size_t lane = 0; lane < laneCount; lane++)
+            {
+                mask[lane] = groupIndices[lane] == group;
+            }
+            execute(groups[group], mask, 0, m_laneCount);
+        }
+        if (ungrouped)
+        {
+            for (size_t lane = 0; lane < laneCount; lane++)
+            {
+                if (active[lane] && groupIndices[lane] == MaxGroups)
+                {
+                    execute(opcodes[lane], active, lane, lane + 1);
+                }
+            }
+        }
+    }
+    for (size_t lane = 0; lane < laneCount; lane++)
+    {
+        m_executed[lane] += active[lane];
+    }
+    return activeCount;
+}
+
+void LockstepEngine::setKeyState(size_t lane, uint8_t key, bool pressed)
+{
+    m_keystates[lane] = (m_keystates[lane] & ~(1 << key)) | (pressed << key);
+}
+
+void LockstepEngine::receiveInput(size_t lane, uint8_t key)
+{
+    if (isAwaitingInput(lane))
+    {
+        getRegisters(m_inputAwaitDestinationRegisters[lane])[lane] = key;
+        m_inputAwaitDestinationRegisters[lane] = NotAwaitingInput;
+    }
+}
+
+void LockstepEngine::advanceTimers()
+{
+    for (size_t lane = 0; lane < m_laneCount; lane++)
+    {
+        m_timers[lane] -= m_timers[lane] > 0;
+        m_audioTimers[lane] -= m_audioTimers[lane] > 0;
+    }
+}
+
+std::array<uint8_t, TOTAL_MEMORY_SIZE> LockstepEngine::getMemory(size_t lane) const
+{
+    std::array<uint8_t, TOTAL_MEMORY_SIZE> memory;
+    for (size_t address = 0; address < TOTAL_MEMORY_SIZE; address++)
+    {
+        memory[address] = m_memory[address * m_laneCount + lane];
+    }
+    return memory;
+}
+
+void LockstepEngine::skipIf(const uint8_t *condition, const uint8_t *mask, size_t begin, size_t end)
+{
+    uint32_t *programCounters = m_programCounters.data();
+    for (size_t lane = begin; lane < end; lane++)
+    {
+        programCounters[lane] += mask[lane] ? (condition[lane] ? 4 : 2) : 0;
+    }
+}
+
+void LockstepEngine::execute(uint16_t opcode, const uint8_t *mask, size_t begin, size_t end)
+{
+    uint32_t *programCounters = m_programCounters.data();
+    uint8_t *condition = m_condition.data();
+    uint8_t *rx = getRegisters((opcode & 0x0f00) >> 8);
+    const uint8_t *ry = getRegisters((opcode & 0x00f0) >> 4);
+    const uint8_t value = opcode & 0x00ff;
+    const uint32_t address = opcode & 0x0fff;
+    auto advance = [&]()
+    {
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            programCounters[lane] += mask[lane] ? 2 : 0;
+        }
+    };
+    switch ((opcode & 0xf000) >> 12)
+    {
+    case 0x0:
+        // halt instruction
+        if (opcode == 0x00e1)
+        {
+            for (size_t lane = begin; lane < end; lane++)
+            {
+                programCounters[lane] = mask[lane] ? TOTAL_MEMORY_SIZE : programCounters[lane];
+            }
+            return;
+        }
+        if ((opcode & 0x0f00) == 0)
+        {
+            switch (opcode & 0x000f)
+            {
+            // clear screen
+            case 0x0:
+                for (size_t lane = begin; lane < end; lane++)
+                {
+                    if (mask[lane])
+                    {
+                        std::memset(getWorkVideoBuffer(lane), 0, TOTAL_VIDEO_MEMORY_SIZE);
+                    }
+                }
+                break;
+            // swap buffer
+            case 0x2:
+                for (size_t lane = begin; lane < end; lane++)
+                {
+                    m_usingPrimaryVideoBuffer[lane] ^= mask[lane];
+                }
+                break;
+            case 0xe:
+                for (size_t lane = begin; lane < end; lane++)
+                {
+                    if (!mask[lane])
+                    {
+                        continue;
+                    }
+                    // same as Machine::popFromStack, empty stack gives -1
+                    const uint32_t stackPointer = m_stackPointers[lane];
+                    if (stackPointer >= TOTAL_MEMORY_SIZE)
+                    {
+                        programCounters[lane] = 0xffff;
+                        continue;
+                    }
+                    programCounters[lane] = (readMemory(lane, stackPointer) << 8) | readMemory(lane, stackPointer + 1);
+                    m_stackPointers[lane] = stackPointer + 1;
+                }
+                break;
+            }
+        }
+        advance();
+        return;
+    case 0x1:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            programCounters[lane] = mask[lane] ? address : programCounters[lane];
+        }
+        return;
+    case 0x2:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            if (!mask[lane])
+            {
+                continue;
+            }
+            const uint32_t stackPointer = m_stackPointers[lane];
+            getMemoryRow(stackPointer - 1)[lane] = (programCounters[lane] & 0xff00) >> 8;
+            getMemoryRow(stackPointer)[lane] = programCounters[lane] & 0x00ff;
+            m_writtenPages |= (1ull << ((stackPointer - 1) % TOTAL_MEMORY_SIZE / PagedMemory::PageSize)) | (1ull << (stackPointer % TOTAL_MEMORY_SIZE / PagedMemory::PageSize));
+            m_stackPointers[lane] = stackPointer - 1;
+            programCounters[lane] = address;
+        }
+        return;
+    case 0x3:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            condition[lane] = rx[lane] == value;
+        }
+        skipIf(condition, mask, begin, end);
+        return;
+    case 0x4:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            condition[lane] = rx[lane] != value;
+        }
+        skipIf(condition, mask, begin, end);
+        return;
+    case 0x5:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            condition[lane] = rx[lane] == ry[lane];
+        }
+        skipIf(condition, mask, begin, end);
+        return;
+    case 0x6:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            rx[lane] = mask[lane] ? value : rx[lane];
+        }
+        break;
+    case 0x7:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            rx[lane] += mask[lane] ? value : 0;
+        }
+        break;
+    case 0x8:
+        opRegisterToRegister(opcode, mask, begin, end);
+        break;
+    case 0xA:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            m_memoryRegisters[lane] = mask[lane] ? address : m_memoryRegisters[lane];
+        }
+        break;
+    case 0xB:
+    {
+        const uint8_t *v0 = getRegisters(0);
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            programCounters[lane] = mask[lane] ? ((v0[lane] + opcode) & 0x0fff) : programCounters[lane];
+        }
+    }
+    break;
+    case 0xC:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            rx[lane] = mask[lane] ? m_random[lane] & value : rx[lane];
+        }
+        break;
+    case 0xD:
+        opDraw(opcode, mask, begin, end);
+        break;
+    case 0xE:
+        if (value != 0x9e && value != 0xa1)
+        {
+            break;
+        }
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            // there are only 16 keys, anything above is never pressed
+            const bool pressed = rx[lane] < 16 && ((m_keystates[lane] >> rx[lane]) & 1);
+            condition[lane] = value == 0x9e ? pressed : !pressed;
+        }
+        skipIf(condition, mask, begin, end);
+        return;
+    case 0xF:
+        switch (value)
+        {
+        case 0x07:
+            for (size_t lane = begin; lane < end; lane++)
+            {
+                rx[lane] = mask[lane] ? m_timers[lane] : rx[lane];
+            }
+            break;
+        case 0x0a:
+            for (size_t lane = begin; lane < end; lane++)
+            {
+                m_inputAwaitDestinationRegisters[lane] = mask[lane] ? (opcode & 0x0f00) >> 8 : m_inputAwaitDestinationRegisters[lane];
+            }
+            break;
+        case 0x15:
+            for (size_t lane = begin; lane < end; lane++)
+            {
+                m_timers[lane] = mask[lane] ? rx[lane] : m_timers[lane];
+            }
+            break;
+        case 0x18:
+            for (size_t lane = begin; lane < end; lane++)
+            {
+                m_audioTimers[lane] = mask[lane] ? rx[lane] : m_audioTimers[lane];
+            }
+            break;
+        case 0x1e:
+            for (size_t lane = begin; lane < end; lane++)
+            {
+                m_memoryRegisters[lane] += mask[lane] ? rx[lane] : 0;
+            }
+            break;
+        }
+        break;
+    }
+    advance();
+}
+
+void LockstepEngine::opRegisterToRegister(uint16_t opcode, const uint8_t *mask, size_t begin, size_t end)
+{
+    uint8_t *rx = getRegisters((opcode & 0x0f00) >> 8);
+    uint8_t *ry = getRegisters((opcode & 0x00f0) >> 4);
+    uint8_t *flags = getRegisters(15);
+    // flag is written before the result, same as in Machine, which matters when the result goes into vf
+    auto arithmetic = [&](auto operation)
+    {
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            const uint16_t res = operation(rx[lane], ry[lane]);
+            flags[lane] = mask[lane] ? (flags[lane] & 0xfe) | (res & 1) : flags[lane];
+            rx[lane] = mask[lane] ? res : rx[lane];
+        }
+    };
+    auto rotate = [](uint8_t value, uint8_t amount, bool right)
+    {
+        const uint8_t shift = right ? amount & 7 : (8 - (amount & 7)) & 7;
+        return (uint8_t)((value >> shift) | (value << ((8 - shift) & 7)));
+    };
+    switch (opcode & 0x000f)
+    {
+    case 0:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            rx[lane] = mask[lane] ? ry[lane] : rx[lane];
+        }
+        break;
+    case 1:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            rx[lane] |= mask[lane] ? ry[lane] : 0;
+        }
+        break;
+    case 2:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            rx[lane] &= mask[lane] ? ry[lane] : 0xff;
+        }
+        break;
+    case 3:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            rx[lane] ^= mask[lane] ? ry[lane] : 0;
+        }
+        break;
+    case 4:
+        arithmetic([](uint8_t x, uint8_t y)
+                   { return (uint16_t)((uint16_t)x + y); });
+        break;
+    case 5:
+        arithmetic([](uint8_t x, uint8_t y)
+                   { return (uint16_t)((uint16_t)x - y); });
+        break;
+    case 6:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            rx[lane] = mask[lane] ? rotate(rx[lane], ry[lane], true) : rx[lane];
+        }
+        break;
+    case 7:
+        arithmetic([](uint8_t x, uint8_t y)
+                   { return (uint16_t)((uint16_t)y - x); });
+        break;
+    case 8:
+        for (size_t lane = begin; lane < end; lane++)
+        {
+            rx[lane] = mask[lane] ? rotate(rx[lane], ry[lane], false) : rx[lane];
+        }
+        break;
+    }
+}
+
+void LockstepEngine::opDraw(uint16_t opcode, const uint8_t *mask, size_t begin, size_t end)
+{
+    const uint8_t *rx = getRegisters((opcode & 0x0f00) >> 8);
+    const uint8_t *ry = getRegisters((opcode & 0x00f0) >> 4);
+    const uint8_t height = opcode & 0x000f;
+    for (size_t lane = begin; lane < end; lane++)
+    {
+        if (!mask[lane])
+        {
+            continue;
+        }
+        uint8_t *video = getWorkVideoBuffer(lane);
+        for (int i = 0; i <= height; i++)
+        {
+            const size_t pos = rx[lane] + ((ry[lane] + i) * 64);
+            const uint8_t line = readMemory(lane, m_memoryRegisters[lane] + i);
+            for (int j = 0; j < 8; j++)
+            {
+                video[(pos + (8 - j)) % (TOTAL_VIDEO_MEMORY_SIZE)] ^= (line >> j) & 1;
+            }
+        }
+    }
+}
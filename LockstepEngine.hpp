@@ -0,0 +1,141 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "PagedMemory.hpp"
+
+/**
+ * @brief Runs many machines with the same program side by side, each of them behaves exactly like a Machine of its own.
+ * State is stored as structure of arrays so that an instruction is executed for all machines(lanes) with one loop over the lanes
+ * which the compiler turns into vector instructions. Lanes that reach the same instruction execute it together,
+ * lanes whose program counters diverged are regrouped by their instruction and the groups are executed one after another.
+ *
+ * Memory is interleaved by address, so the same address of every lane is one contiguous row, which is what lanes running the same
+ * code read and write. Video memory of every lane is contiguous so that it can be displayed or copied as is.
+ *
+ * Random numbers are taken from rand() in the order of the lanes, a single lane gets the same numbers as a Machine would
+ */
+class LockstepEngine
+{
+public:
+    /**
+     * @brief Create engine with the program loaded into every lane
+     *
+     * @param image Program to run, created by PagedMemory::createImage
+     * @param laneCount Number of machines to run
+     */
+    explicit LockstepEngine(std::shared_ptr<const PagedMemory::Image> image, size_t laneCount);
+
+    /**
+     * @brief Execute instructions on every lane that is neither halted nor waiting for input
+     *
+     * @param steps Maximum number of instructions to execute per lane
+     * @return size_t Total number of instructions executed by all lanes
+     */
+    size_t run(size_t steps);
+
+    /**
+     * @brief Execute one instruction on every lane that is neither halted nor waiting for input
+     *
+     * @return size_t Number of lanes that executed an instruction
+     */
+    size_t step();
+
+    size_t getLaneCount() const { return m_laneCount; }
+
+    void setKeyState(size_t lane, uint8_t key, bool pressed);
+
+    void receiveInput(size_t lane, uint8_t key);
+
+    /// @brief Advance timers of all lanes
+    void advanceTimers();
+
+    bool isHalted(size_t lane) const { return m_programCounters[lane] >= TOTAL_MEMORY_SIZE; }
+    bool isAwaitingInput(size_t lane) const { return m_inputAwaitDestinationRegisters[lane] != NotAwaitingInput; }
+
+    /// @brief Number of instructions the lane has executed since the engine was created
+    uint64_t getExecutedCount(size_t lane) const { return m_executed[lane]; }
+
+    uint8_t getRegister(size_t lane, size_t reg) const { return m_registers[reg * m_laneCount + lane]; }
+    size_t getProgramCounter(size_t lane) const { return m_programCounters[lane]; }
+    size_t getMemoryRegister(size_t lane) const { return m_memoryRegisters[lane]; }
+    size_t getStackPointer(size_t lane) const { return m_stackPointers[lane]; }
+    uint8_t getTimer(size_t lane) const { return m_timers[lane]; }
+    uint8_t getAudioTimer(size_t lane) const { return m_audioTimers[lane]; }
+    uint8_t readMemory(size_t lane, size_t address) const { return m_memory[(address % TOTAL_MEMORY_SIZE) * m_laneCount + lane]; }
+
+    /// @brief Copy memory of the lane into contiguous array
+    std::array<uint8_t, TOTAL_MEMORY_SIZE> getMemory(size_t lane) const;
+
+    /// @brief Get video memory of the lane currently used for writing data
+    std::span<const uint8_t, TOTAL_VIDEO_MEMORY_SIZE> getWorkVideoMemory(size_t lane) const { return getVideoBuffer(lane, m_usingPrimaryVideoBuffer[lane] ? 0 : 1); }
+
+    /// @brief Get video memory of the lane currently ready to be displayed
+    std::span<const uint8_t, TOTAL_VIDEO_MEMORY_SIZE> getCurrentVideoMemory(size_t lane) const { return getVideoBuffer(lane, m_usingPrimaryVideoBuffer[lane] ? 1 : 0); }
+
+private:
+    static constexpr uint8_t NotAwaitingInput = 0xff;
+    /// @brief Lanes that run more different instructions than this execute them one lane at a time
+    static constexpr size_t MaxGroups = 8;
+
+    std::span<const uint8_t, TOTAL_VIDEO_MEMORY_SIZE> getVideoBuffer(size_t lane, size_t buffer) const
+    {
+        return std::span<const uint8_t, TOTAL_VIDEO_MEMORY_SIZE>(m_video.data() + (lane * 2 + buffer) * TOTAL_VIDEO_MEMORY_SIZE, TOTAL_VIDEO_MEMORY_SIZE);
+    }
+
+    uint8_t *getRegisters(size_t reg) { return m_registers.data() + reg * m_laneCount; }
+
+    uint8_t *getMemoryRow(size_t address) { return m_memory.data() + (address % TOTAL_MEMORY_SIZE) * m_laneCount; }
+
+    uint8_t *getWorkVideoBuffer(size_t lane) { return m_video.data() + (lane * 2 + (m_usingPrimaryVideoBuffer[lane] ? 0 : 1)) * TOTAL_VIDEO_MEMORY_SIZE; }
+
+    /**
+     * @brief Execute the instruction on the lanes in the range that are selected by the mask
+     *
+     * @param opcode Instruction to execute
+     * @param mask 1 for every lane that executes the instruction, 0 for others, indexed by lane
+     * @param begin First lane
+     * @param end Lane after the last one
+     */
+    void execute(uint16_t opcode, const uint8_t *mask, size_t begin, size_t end);
+
+    void opRegisterToRegister(uint16_t opcode, const uint8_t *mask, size_t begin, size_t end);
+
+    void opDraw(uint16_t opcode, const uint8_t *mask, size_t begin, size_t end);
+
+    /// @brief Advance program counter of the selected lanes by 4 where the condition holds and by 2 elsewhere
+    void skipIf(const uint8_t *condition, const uint8_t *mask, size_t begin, size_t end);
+
+    size_t m_laneCount;
+    std::shared_ptr<const PagedMemory::Image> m_image;
+    /// @brief Pages that any lane wrote to, instructions there can no longer be read from the image
+    uint64_t m_writtenPages = 0;
+
+    /// @brief Registers indexed by register then by lane
+    std::vector<uint8_t> m_registers;
+    std::vector<uint32_t> m_programCounters;
+    std::vector<uint32_t> m_memoryRegisters;
+    std::vector<uint32_t> m_stackPointers;
+    std::vector<uint8_t> m_timers;
+    std::vector<uint8_t> m_audioTimers;
+    /// @brief One bit per key
+    std::vector<uint16_t> m_keystates;
+    std::vector<uint8_t> m_inputAwaitDestinationRegisters;
+    std::vector<uint8_t> m_usingPrimaryVideoBuffer;
+    std::vector<uint64_t> m_executed;
+    /// @brief Memory indexed by address then by lane
+    std::vector<uint8_t> m_memory;
+    /// @brief Primary and secondary video buffer of every lane one after another
+    std::vector<uint8_t> m_video;
+
+    // scratch buffers for a single step
+    std::vector<uint8_t> m_active;
+    std::vector<uint8_t> m_mask;
+    std::vector<uint8_t> m_condition;
+    std::vector<uint8_t> m_groupIndices;
+    std::vector<uint16_t> m_opcodes;
+    std::vector<uint8_t> m_random;
+};
@@ -1,37 +1,459 @@
 #include "Machine.hpp"
 #include <iostream>
+#include <bit>
+#include <algorithm>
+#include <utility>
+
+/// @brief Longest loop in instructions that is checked for being idle
+static const size_t MaxIdleLoopLength = 32;
+/// @brief Number of times a loop that was not idle is entered before it is checked again
+static const size_t BusyLoopCheckInterval = 64;
 Machine::Machine()
 {
+    reset();
+}
+Machine::Machine(std::span<const uint8_t> program) : Machine(PagedMemory::createImage(program))
+{
+}
+Machine::Machine(std::shared_ptr<const PagedMemory::Image> image) : m_memory(std::move(image))
+{
+    reset();
+}
+
+void Machine::saveSnapshot()
+{
+    std::shared_ptr<Machine> snapshot = std::make_shared<Machine>(*this);
+    snapshot->m_snapshot = nullptr;
+    m_snapshot = std::move(snapshot);
+    m_memory.markClean();
+    m_videoModified = false;
+}
+
+void Machine::reset()
+{
+    if (m_snapshot != nullptr)
+    {
+        Machine const &snapshot = *m_snapshot;
+        m_memory.restore(snapshot.m_memory);
+        if (m_videoModified)
+        {
+            m_videoPrimaryBuffer = snapshot.m_videoPrimaryBuffer;
+            m_videoSecondaryBuffer = snapshot.m_videoSecondaryBuffer;
+        }
+        m_videoPrimaryHash = snapshot.m_videoPrimaryHash;
+        m_videoSecondaryHash = snapshot.m_videoSecondaryHash;
+        m_usingPrimaryVideoBuffer = snapshot.m_usingPrimaryVideoBuffer;
+        m_programCounter = snapshot.m_programCounter;
+        m_memoryRegister = snapshot.m_memoryRegister;
+        m_registers = snapshot.m_registers;
+        m_stackPointer = snapshot.m_stackPointer;
+        m_inputAwaitDestinationRegister = snapshot.m_inputAwaitDestinationRegister;
+        m_keystates = snapshot.m_keystates;
+        m_audioTimer = snapshot.m_audioTimer;
+        m_timer = snapshot.m_timer;
+        m_busyLoopStart = snapshot.m_busyLoopStart;
+        m_busyLoopSkips = snapshot.m_busyLoopSkips;
+        m_idle = snapshot.m_idle;
+        m_videoModified = false;
+        return;
+    }
+    m_memory.reset();
+    if (m_videoModified)
+    {
+        std::fill(m_videoPrimaryBuffer.begin(), m_videoPrimaryBuffer.end(), 0);
+        std::fill(m_videoSecondaryBuffer.begin(), m_videoSecondaryBuffer.end(), 0);
+    }
+    m_videoPrimaryHash = 0;
+    m_videoSecondaryHash = 0;
     m_stackPointer = m_memory.size() - 1;
-    std::fill(m_memory.begin(), m_memory.end(), 0);
-    std::fill(m_videoPrimaryBuffer.begin(), m_videoPrimaryBuffer.end(), 0);
-    std::fill(m_videoSecondaryBuffer.begin(), m_videoSecondaryBuffer.end(), 0);
     std::fill(m_keystates.begin(), m_keystates.end(), false);
+    // registers start cleared so that runs of the same program are reproducible
+    std::fill(m_registers.begin(), m_registers.end(), 0);
+    m_memoryRegister = 0;
     m_usingPrimaryVideoBuffer = true;
     m_programCounter = 0;
+    m_inputAwaitDestinationRegister.reset();
+    m_audioTimer = 0;
+    m_timer = 0;
+    m_busyLoopStart = SIZE_MAX;
+    m_busyLoopSkips = 0;
+    m_idle = false;
+    m_videoModified = false;
 }
-Machine::Machine(std::vector<uint8_t> const &bytes)
+template <uint8_t Operation>
+void Machine::registerOperation(size_t x, size_t y)
 {
-    std::fill(m_memory.begin(), m_memory.end(), 0);
-    for (size_t i = 0; i < bytes.size() && i < m_memory.size(); i++)
+    if constexpr (Operation == 0)
     {
-        m_memory[i] = bytes[i];
+        m_registers[x] = m_registers[y];
     }
-    m_stackPointer = m_memory.size() - 1;
+    else if constexpr (Operation == 1)
+    {
+        m_registers[x] |= m_registers[y];
+    }
+    else if constexpr (Operation == 2)
+    {
+        m_registers[x] &= m_registers[y];
+    }
+    else if constexpr (Operation == 3)
+    {
+        m_registers[x] ^= m_registers[y];
+    }
+    else if constexpr (Operation == 4)
+    {
+        const uint16_t res = (uint16_t)m_registers[x] + (uint8_t)m_registers[y];
+        updateFlags(res);
+        m_registers[x] = res;
+    }
+    else if constexpr (Operation == 5)
+    {
+        const uint16_t res = (uint16_t)m_registers[x] - (uint8_t)m_registers[y];
+        updateFlags(res);
+        m_registers[x] = res;
+    }
+    else if constexpr (Operation == 6)
+    {
+        m_registers[x] = std::rotr(m_registers[x], m_registers[y]);
+    }
+    else if constexpr (Operation == 7)
+    {
+        const uint16_t res = (uint8_t)m_registers[y] - (uint16_t)m_registers[x];
+        updateFlags(res);
+        m_registers[x] = res;
+    }
+    else if constexpr (Operation == 8)
+    {
+        m_registers[x] = std::rotl(m_registers[x], m_registers[y]);
+    }
+}
 
-    std::fill(m_videoPrimaryBuffer.begin(), m_videoPrimaryBuffer.end(), 0);
-    std::fill(m_videoSecondaryBuffer.begin(), m_videoSecondaryBuffer.end(), 0);
-    std::fill(m_keystates.begin(), m_keystates.end(), false);
-    m_usingPrimaryVideoBuffer = true;
-    m_programCounter = 0;
+/// @brief Kinds of instructions in the opcode table, ordered by the number of register operands their handlers are specialized for
+enum class OpcodeKind : uint8_t
+{
+    Nop,
+    Halt,
+    ClearScreen,
+    SwapBuffers,
+    Return,
+    Jump,
+    Call,
+    SetMemoryRegister,
+    JumpOffset,
+    Draw,
+    // specialized on X
+    SkipEqual,
+    SkipNotEqual,
+    Load,
+    Add,
+    Random,
+    SkipKeyPressed,
+    SkipKeyNotPressed,
+    GetTimer,
+    AwaitKey,
+    SetTimer,
+    SetAudioTimer,
+    AddMemoryRegister,
+    // specialized on X and Y
+    SkipRegistersEqual,
+    /// @brief 8XY0 to 8XY8 follow each other
+    RegisterOperation,
+    Count = RegisterOperation + 9
+};
+
+static constexpr size_t getOperandCount(size_t kind)
+{
+    if (kind >= (size_t)OpcodeKind::SkipRegistersEqual)
+    {
+        return 256;
+    }
+    return kind >= (size_t)OpcodeKind::SkipEqual ? 16 : 1;
 }
+
+/// @brief Index of the first handler of every kind
+static constexpr std::array<size_t, (size_t)OpcodeKind::Count + 1> getHandlerOffsets()
+{
+    std::array<size_t, (size_t)OpcodeKind::Count + 1> offsets = {};
+    for (size_t kind = 0; kind < (size_t)OpcodeKind::Count; kind++)
+    {
+        offsets[kind + 1] = offsets[kind] + getOperandCount(kind);
+    }
+    return offsets;
+}
+
+static constexpr size_t HandlerCount = getHandlerOffsets().back();
+
+/// @brief Decode the opcode the same way stepReference does
+static constexpr size_t decodeOpcodeKind(uint16_t opcode)
+{
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        if (opcode == 0x00e1)
+        {
+            return (size_t)OpcodeKind::Halt;
+        }
+        if ((opcode & 0x0f00) != 0)
+        {
+            return (size_t)OpcodeKind::Nop;
+        }
+        switch (opcode & 0x000f)
+        {
+        case 0x0:
+            return (size_t)OpcodeKind::ClearScreen;
+        case 0x2:
+            return (size_t)OpcodeKind::SwapBuffers;
+        case 0xe:
+            return (size_t)OpcodeKind::Return;
+        }
+        return (size_t)OpcodeKind::Nop;
+    case 0x1:
+        return (size_t)OpcodeKind::Jump;
+    case 0x2:
+        return (size_t)OpcodeKind::Call;
+    case 0x3:
+        return (size_t)OpcodeKind::SkipEqual;
+    case 0x4:
+        return (size_t)OpcodeKind::SkipNotEqual;
+    case 0x5:
+        return (size_t)OpcodeKind::SkipRegistersEqual;
+    case 0x6:
+        return (size_t)OpcodeKind::Load;
+    case 0x7:
+        return (size_t)OpcodeKind::Add;
+    case 0x8:
+        return (opcode & 0x000f) <= 8 ? (size_t)OpcodeKind::RegisterOperation + (opcode & 0x000f) : (size_t)OpcodeKind::Nop;
+    case 0xA:
+        return (size_t)OpcodeKind::SetMemoryRegister;
+    case 0xB:
+        return (size_t)OpcodeKind::JumpOffset;
+    case 0xC:
+        return (size_t)OpcodeKind::Random;
+    case 0xD:
+        return (size_t)OpcodeKind::Draw;
+    case 0xE:
+        switch (opcode & 0x00ff)
+        {
+        case 0x9e:
+            return (size_t)OpcodeKind::SkipKeyPressed;
+        case 0xa1:
+            return (size_t)OpcodeKind::SkipKeyNotPressed;
+        }
+        return (size_t)OpcodeKind::Nop;
+    case 0xF:
+        switch (opcode & 0x00ff)
+        {
+        case 0x07:
+            return (size_t)OpcodeKind::GetTimer;
+        case 0x0a:
+            return (size_t)OpcodeKind::AwaitKey;
+        case 0x15:
+            return (size_t)OpcodeKind::SetTimer;
+        case 0x18:
+            return (size_t)OpcodeKind::SetAudioTimer;
+        case 0x1e:
+            return (size_t)OpcodeKind::AddMemoryRegister;
+        }
+        return (size_t)OpcodeKind::Nop;
+    default:
+        return (size_t)OpcodeKind::Nop;
+    }
+}
+
+static constexpr std::array<uint16_t, 0x10000> makeHandlerIndices()
+{
+    constexpr std::array<size_t, (size_t)OpcodeKind::Count + 1> offsets = getHandlerOffsets();
+    std::array<uint16_t, 0x10000> indices = {};
+    for (size_t opcode = 0; opcode < indices.size(); opcode++)
+    {
+        const size_t kind = decodeOpcodeKind(opcode);
+        const size_t count = getOperandCount(kind);
+        indices[opcode] = offsets[kind];
+        if (count == 256)
+        {
+            indices[opcode] += (opcode >> 4) & 0xff;
+        }
+        else if (count == 16)
+        {
+            indices[opcode] += (opcode >> 8) & 0xf;
+        }
+    }
+    return indices;
+}
+
+/**
+ * @brief Table of handlers indexed by the whole opcode, generated at compile time. Handlers are instantiated for the registers
+ * that the instruction uses so executing an instruction is a single indirect call with no decoding left.
+ * Opcodes map to a compact handler index rather than to the handler itself, which keeps the table at 128KB without relocations
+ *
+ */
+class OpcodeDispatcher
+{
+public:
+    using Handler = void (*)(Machine &machine, uint16_t opcode);
+
+    static constexpr std::array<Handler, HandlerCount> makeHandlers()
+    {
+        std::array<Handler, HandlerCount> handlers = {};
+        append(handlers, std::make_index_sequence<(size_t)OpcodeKind::Count>());
+        return handlers;
+    }
+
+    static void execute(Machine &machine, uint16_t opcode);
+
+private:
+    template <size_t... Kinds>
+    static constexpr void append(std::array<Handler, HandlerCount> &handlers, std::index_sequence<Kinds...>)
+    {
+        size_t index = 0;
+        ((appendKind<Kinds>(handlers, index, std::make_index_sequence<getOperandCount(Kinds)>())), ...);
+    }
+
+    template <size_t KindIndex, size_t... Operands>
+    static constexpr void appendKind(std::array<Handler, HandlerCount> &handlers, size_t &index, std::index_sequence<Operands...>)
+    {
+        // operands are numbered the same way they are laid out in the opcode: X in the high nibble, Y in the low one
+        ((handlers[index++] = &handle<KindIndex, (sizeof...(Operands) == 256 ? Operands >> 4 : Operands), (sizeof...(Operands) == 256 ? Operands & 0xf : 0)>), ...);
+    }
+
+    template <size_t K, size_t X, size_t Y>
+    static void handle(Machine &machine, uint16_t opcode)
+    {
+        constexpr OpcodeKind kind = (OpcodeKind)K;
+        if constexpr (kind == OpcodeKind::Halt)
+        {
+            machine.m_programCounter = machine.m_memory.size();
+            return;
+        }
+        else if constexpr (kind == OpcodeKind::ClearScreen)
+        {
+            machine.clearWorkVideoMemory();
+        }
+        else if constexpr (kind == OpcodeKind::SwapBuffers)
+        {
+            machine.m_usingPrimaryVideoBuffer = !machine.m_usingPrimaryVideoBuffer;
+        }
+        else if constexpr (kind == OpcodeKind::Return)
+        {
+            machine.m_programCounter = machine.popFromStack();
+        }
+        else if constexpr (kind == OpcodeKind::Jump)
+        {
+            machine.m_programCounter = opcode & 0x0fff;
+            return;
+        }
+        else if constexpr (kind == OpcodeKind::Call)
+        {
+            machine.pushToStack(machine.m_programCounter);
+            machine.m_programCounter = opcode & 0x0fff;
+            return;
+        }
+        else if constexpr (kind == OpcodeKind::SetMemoryRegister)
+        {
+            machine.m_memoryRegister = opcode & 0x0fff;
+        }
+        else if constexpr (kind == OpcodeKind::JumpOffset)
+        {
+            machine.m_programCounter = (machine.m_registers[0] + opcode) & 0x0fff;
+        }
+        else if constexpr (kind == OpcodeKind::Draw)
+        {
+            machine.opDraw(opcode);
+        }
+        else if constexpr (kind == OpcodeKind::SkipEqual)
+        {
+            machine.m_programCounter += machine.m_registers[X] == (opcode & 0x00ff) ? 2 : 0;
+        }
+        else if constexpr (kind == OpcodeKind::SkipNotEqual)
+        {
+            machine.m_programCounter += machine.m_registers[X] != (opcode & 0x00ff) ? 2 : 0;
+        }
+        else if constexpr (kind == OpcodeKind::Load)
+        {
+            machine.m_registers[X] = opcode & 0x00ff;
+        }
+        else if constexpr (kind == OpcodeKind::Add)
+        {
+            machine.m_registers[X] += opcode & 0x00ff;
+        }
+        else if constexpr (kind == OpcodeKind::Random)
+        {
+            machine.m_registers[X] = rand() & (opcode & 0x00ff);
+        }
+        else if constexpr (kind == OpcodeKind::SkipKeyPressed)
+        {
+            machine.m_programCounter += machine.isKeyPressed(machine.m_registers[X]) ? 2 : 0;
+        }
+        else if constexpr (kind == OpcodeKind::SkipKeyNotPressed)
+        {
+            machine.m_programCounter += !machine.isKeyPressed(machine.m_registers[X]) ? 2 : 0;
+        }
+        else if constexpr (kind == OpcodeKind::GetTimer)
+        {
+            machine.m_registers[X] = machine.m_timer;
+        }
+        else if constexpr (kind == OpcodeKind::AwaitKey)
+        {
+            machine.m_inputAwaitDestinationRegister = X;
+        }
+        else if constexpr (kind == OpcodeKind::SetTimer)
+        {
+            machine.m_timer = machine.m_registers[X];
+        }
+        else if constexpr (kind == OpcodeKind::SetAudioTimer)
+        {
+            machine.m_audioTimer = machine.m_registers[X];
+        }
+        else if constexpr (kind == OpcodeKind::AddMemoryRegister)
+        {
+            machine.m_memoryRegister += machine.m_registers[X];
+        }
+        else if constexpr (kind == OpcodeKind::SkipRegistersEqual)
+        {
+            machine.m_programCounter += machine.m_registers[X] == machine.m_registers[Y] ? 2 : 0;
+        }
+        else if constexpr (K >= (size_t)OpcodeKind::RegisterOperation)
+        {
+            machine.registerOperation<K - (size_t)OpcodeKind::RegisterOperation>(X, Y);
+        }
+        machine.m_programCounter += 2;
+    }
+};
+
+static constexpr std::array<uint16_t, 0x10000> HandlerIndices = makeHandlerIndices();
+static constexpr auto Handlers = OpcodeDispatcher::makeHandlers();
+
+void OpcodeDispatcher::execute(Machine &machine, uint16_t opcode)
+{
+    Handlers[HandlerIndices[opcode]](machine, opcode);
+}
+
 void Machine::step()
 {
     if (m_programCounter >= m_memory.size())
     {
         return;
     }
-    uint16_t opcode = m_memory[m_programCounter + 1] | (((uint16_t)m_memory[m_programCounter]) << 8);
+    // instructions are almost always fetched from pages that are still shared, which needs no page lookup.
+    // Laying that path out as the fall through matters, anything else costs up to half of the speed of the dispatch
+    uint16_t opcode;
+    if (m_programCounter + 1 < m_memory.getSharedSize()) [[likely]]
+    {
+        opcode = m_memory.readSharedWord(m_programCounter);
+    }
+    else
+    {
+        opcode = m_memory.readWord(m_programCounter);
+    }
+    OpcodeDispatcher::execute(*this, opcode);
+}
+
+void Machine::stepReference()
+{
+    if (m_programCounter >= m_memory.size())
+    {
+        return;
+    }
+    uint16_t opcode = m_memory.readWord(m_programCounter);
     // halt instruction
     if (opcode == 0x00e1)
     {
@@ -106,6 +528,91 @@ void Machine::step()
     m_programCounter += 2;
 }
 
+size_t Machine::run(size_t steps)
+{
+    size_t executed = 0;
+    m_idle = false;
+    while (executed < steps && !isHalted() && !isAwaitingInput())
+    {
+        const size_t programCounter = m_programCounter;
+        step();
+        executed++;
+        // idle loops are short and end with a jump back to their start, the opcode is only read for the rare short backward transfer
+        if (m_programCounter > programCounter || programCounter - m_programCounter >= MaxIdleLoopLength * 2 || (m_memory.read(programCounter) & 0xf0) != 0x10)
+        {
+            continue;
+        }
+        // checking costs about as much as the iteration itself, so busy loops are only checked once in a while
+        if (m_programCounter == m_busyLoopStart && m_busyLoopSkips > 0)
+        {
+            m_busyLoopSkips--;
+            continue;
+        }
+        const size_t loopStart = m_programCounter;
+        size_t length = 0;
+        executed += runLoopIteration(steps - executed, length);
+        if (length > 0)
+        {
+            executed += (steps - executed) / length * length;
+            m_idle = true;
+        }
+        else if (m_programCounter == loopStart)
+        {
+            // loop came back with different registers, first iteration can still be setting up registers for waiting
+            // so the loop is only treated as busy if it happens twice in a row
+            m_busyLoopSkips = m_busyLoopStart == loopStart ? BusyLoopCheckInterval : 0;
+            m_busyLoopStart = loopStart;
+        }
+    }
+    return executed;
+}
+
+size_t Machine::runLoopIteration(size_t maxSteps, size_t &length)
+{
+    const size_t start = m_programCounter;
+    const std::array<uint8_t, 16> registers = m_registers;
+    const size_t memoryRegister = m_memoryRegister;
+    size_t executed = 0;
+    length = 0;
+    while (executed < maxSteps && executed < MaxIdleLoopLength && m_programCounter + 1 < m_memory.size())
+    {
+        if (!isIdleInstruction(m_memory.readWord(m_programCounter)))
+        {
+            break;
+        }
+        step();
+        executed++;
+        if (m_programCounter == start)
+        {
+            // memory, timers and keys were not touched so the same state means that every following iteration is the same
+            if (m_registers == registers && m_memoryRegister == memoryRegister)
+            {
+                length = executed;
+            }
+            break;
+        }
+    }
+    return executed;
+}
+
+bool Machine::isIdleInstruction(uint16_t opcode)
+{
+    switch ((opcode & 0xf000) >> 12)
+    {
+    case 0x0:
+        // anything but clear, swap, return and halt does nothing
+        return opcode != 0x00e1 && ((opcode & 0x0f00) != 0 || ((opcode & 0x000f) != 0x0 && (opcode & 0x000f) != 0x2 && (opcode & 0x000f) != 0xe));
+    case 0x2:
+    case 0xC:
+    case 0xD:
+        return false;
+    case 0xF:
+        return (opcode & 0x00ff) != 0x0a && (opcode & 0x00ff) != 0x15 && (opcode & 0x00ff) != 0x18;
+    default:
+        return true;
+    }
+}
+
 void Machine::render()
 {
 }
@@ -114,14 +621,19 @@ void Machine::writeSpriteToMemory(size_t position, std::vector<uint8_t> sprite)
 {
     for (size_t i = 0; i < sprite.size(); i++)
     {
-        m_memory[position + i] = sprite[i];
+        m_memory.write(position + i, sprite[i]);
     }
 }
 
+void Machine::loadProgram(std::span<const uint8_t> program)
+{
+    m_memory.write(0, program.first(std::min(program.size(), m_memory.size())));
+}
+
 void Machine::pushToStack(uint16_t value)
 {
-    m_memory[m_stackPointer - 1] = (value & 0xff00) >> 8;
-    m_memory[m_stackPointer - 0] = (value & 0x00ff);
+    m_memory.write(m_stackPointer - 1, (value & 0xff00) >> 8);
+    m_memory.write(m_stackPointer - 0, value & 0x00ff);
     m_stackPointer -= 1;
 }
 
@@ -132,8 +644,8 @@ uint16_t Machine::popFromStack()
         return -1;
     }
     uint16_t value = 0;
-    value = m_memory[m_stackPointer + 0] << 8;
-    value |= m_memory[m_stackPointer + 1];
+    value = m_memory.read(m_stackPointer + 0) << 8;
+    value |= m_memory.read(m_stackPointer + 1);
     m_stackPointer += 1;
 
     return value;
@@ -170,23 +682,96 @@ void Machine::advanceTimers()
     }
 }
 
+void Machine::setKeyStates(uint16_t keys)
+{
+    for (uint8_t key = 0; key < 16; key++)
+    {
+        setKeyState(key, (keys >> key) & 1);
+    }
+}
+
+bool Machine::beginFrame(uint16_t keys)
+{
+    advanceTimers();
+    if (isAwaitingInput())
+    {
+        // the key ends the wait but the machine only continues on the next frame
+        if (keys != 0)
+        {
+            receiveInput(std::countr_zero(keys));
+        }
+        return false;
+    }
+    return !isHalted();
+}
+
 void Machine::opDraw(uint16_t opcode)
 {
     const uint8_t x = m_registers[(opcode & 0x0f00) >> 8];
     const uint8_t y = m_registers[(opcode & 0x00f0) >> 4];
 
     const uint8_t height = opcode & 0x000f;
+    VideoMemoryType &video = getWorkVideoMemory();
+    uint64_t hash = getWorkVideoHash();
     for (int i = 0; i <= height; i++)
     {
         const size_t pos = x + ((y + i) * 64);
-        const uint8_t line = m_memory[m_memoryRegister + i];
+        const uint8_t line = m_memory.read(m_memoryRegister + i);
         for (int j = 0; j < 8; j++)
         {
-            auto t1 = line & (1 << j);
-            auto t2 = t1 >> j;
-            getWorkVideoMemory()[pos + (8 - j)] ^= (line & (1 << j)) >> j;
+            const uint8_t bit = (line & (1 << j)) >> j;
+            // sprites past the end wrap around like in the lockstep engine instead of writing into whatever follows the buffer
+            const size_t pixel = (pos + (8 - j)) % (TOTAL_VIDEO_MEMORY_SIZE);
+            video[pixel] ^= bit;
+            // every flipped pixel flips its key without a branch on the bit
+            hash ^= StateHash::PixelKeys[pixel] & (0 - (uint64_t)bit);
         }
     }
+    getWorkVideoHash() = hash;
+}
+
+uint64_t Machine::getStateHash() const
+{
+    return combineStateHash(m_memory.getHash(), getCurrentVideoHash(), m_usingPrimaryVideoBuffer ? m_videoPrimaryHash : m_videoSecondaryHash);
+}
+
+uint64_t Machine::computeStateHash() const
+{
+    auto hashVideo = [](VideoMemoryType const &video)
+    {
+        uint64_t hash = 0;
+        for (size_t i = 0; i < video.size(); i++)
+        {
+            hash ^= video[i] ? StateHash::PixelKeys[i] : 0;
+        }
+        return hash;
+    };
+    VideoMemoryType const &workVideo = m_usingPrimaryVideoBuffer ? m_videoPrimaryBuffer : m_videoSecondaryBuffer;
+    return combineStateHash(m_memory.computeHash(), hashVideo(getCurrentVideoMemory()), hashVideo(workVideo));
+}
+
+uint64_t Machine::combineStateHash(uint64_t memoryHash, uint64_t currentVideoHash, uint64_t workVideoHash) const
+{
+    // values are assembled with shifts instead of copying bytes so that the hash does not depend on the byte order of the host
+    uint64_t registers[2] = {};
+    for (size_t i = 0; i < m_registers.size(); i++)
+    {
+        registers[i / 8] |= (uint64_t)m_registers[i] << (i % 8 * 8);
+    }
+    uint64_t keys = 0;
+    for (size_t i = 0; i < m_keystates.size(); i++)
+    {
+        keys |= (uint64_t)m_keystates[i] << i;
+    }
+    const uint64_t input = m_inputAwaitDestinationRegister.has_value() ? m_inputAwaitDestinationRegister.value() + 1 : 0;
+    uint64_t hash = StateHash::combine(memoryHash, currentVideoHash);
+    hash = StateHash::combine(hash, workVideoHash);
+    hash = StateHash::combine(hash, registers[0]);
+    hash = StateHash::combine(hash, registers[1]);
+    hash = StateHash::combine(hash, m_programCounter);
+    hash = StateHash::combine(hash, m_memoryRegister);
+    hash = StateHash::combine(hash, m_stackPointer);
+    return StateHash::combine(hash, keys | input << 16 | (uint64_t)m_timer << 32 | (uint64_t)m_audioTimer << 40);
 }
 
 void Machine::opControlInstructions(uint16_t opcode)
@@ -200,7 +785,7 @@ void Machine::opControlInstructions(uint16_t opcode)
     {
     // clear screen
     case 0:
-        std::fill(getWorkVideoMemory().begin(), getWorkVideoMemory().end(), 0);
+        clearWorkVideoMemory();
         break;
     // swap buffer
     case 2:
@@ -214,53 +799,38 @@ void Machine::opControlInstructions(uint16_t opcode)
 
 void Machine::opRegisterToRegister(uint16_t opcode)
 {
+    const size_t x = (opcode & 0x0f00) >> 8;
+    const size_t y = (opcode & 0x00f0) >> 4;
     switch (opcode & 0x000f)
     {
     case 0:
-        m_registers[(opcode & 0x0f00) >> 8] = m_registers[(opcode & 0x00f0) >> 4];
+        registerOperation<0>(x, y);
         break;
     case 1:
-        m_registers[(opcode & 0x0f00) >> 8] |= m_registers[(opcode & 0x00f0) >> 4];
+        registerOperation<1>(x, y);
         break;
     case 2:
-        m_registers[(opcode & 0x0f00) >> 8] &= m_registers[(opcode & 0x00f0) >> 4];
+        registerOperation<2>(x, y);
         break;
     case 3:
-        m_registers[(opcode & 0x0f00) >> 8] ^= m_registers[(opcode & 0x00f0) >> 4];
+        registerOperation<3>(x, y);
         break;
     case 4:
-    {
-        const uint16_t res = (uint16_t)m_registers[(opcode & 0x0f00) >> 8] + (uint8_t)m_registers[(opcode & 0x00f0) >> 4];
-        updateFlags(res);
-        m_registers[(opcode & 0x0f00) >> 8] = res;
-    }
-
-    break;
+        registerOperation<4>(x, y);
+        break;
     case 5:
-    {
-        const uint16_t res = (uint16_t)m_registers[(opcode & 0x0f00) >> 8] - (uint8_t)m_registers[(opcode & 0x00f0) >> 4];
-        updateFlags(res);
-        m_registers[(opcode & 0x0f00) >> 8] = res;
-    }
-    break;
+        registerOperation<5>(x, y);
+        break;
     case 6:
-    {
-        m_registers[(opcode & 0x0f00) >> 8] = std::rotr(m_registers[(opcode & 0x0f00) >> 8], m_registers[(opcode & 0x00f0) >> 4]);
+        registerOperation<6>(x, y);
         break;
-    }
     case 7:
-    {
-        const uint16_t res = (uint8_t)m_registers[(opcode & 0x00f0) >> 4] - (uint16_t)m_registers[(opcode & 0x0f00) >> 8];
-        updateFlags(res);
-        m_registers[(opcode & 0x0f00) >> 8] = res;
+        registerOperation<7>(x, y);
         break;
-    }
     case 8:
-    {
-        m_registers[(opcode & 0x0f00) >> 8] = std::rotl(m_registers[(opcode & 0x0f00) >> 8], m_registers[(opcode & 0x00f0) >> 4]);
+        registerOperation<8>(x, y);
         break;
     }
-    }
 }
 
 bool Machine::handleKeyOpcodes(uint16_t opcode)
@@ -268,14 +838,14 @@ bool Machine::handleKeyOpcodes(uint16_t opcode)
     switch (opcode & 0xff)
     {
     case 0x9e: // skip if key is pressed
-        if (m_keystates[m_registers[(opcode & 0x0f00) >> 8]])
+        if (isKeyPressed(m_registers[(opcode & 0x0f00) >> 8]))
         {
             m_programCounter += 4;
             return true;
         }
         break;
     case 0xa1: // skip if key is not pressed
-        if (!m_keystates[m_registers[(opcode & 0x0f00) >> 8]])
+        if (!isKeyPressed(m_registers[(opcode & 0x0f00) >> 8]))
         {
             m_programCounter += 4;
             return true;
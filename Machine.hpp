@@ -1,19 +1,88 @@
 #pragma once
 #include <SDL.h>
+#include <algorithm>
 #include <array>
 #include <vector>
 #include <optional>
+#include <span>
+#include <memory>
+
+#include "PagedMemory.hpp"
 class Machine
 {
+    /// @brief Native code generated by gob8rc works directly on the state of the machine
+    friend class CompiledProgram;
+    /// @brief Microbenchmarks time the private handlers directly
+    friend class HandlerBenchmark;
+    /// @brief Opcode table calls handlers specialized for each instruction
+    friend class OpcodeDispatcher;
 
 public:
     /// @brief Video memory of the pseudo console. Although we can use bytes to compress the data horizontally by packing bits into bytes, we can't do that vertically
     using VideoMemoryType = std::array<uint8_t, TOTAL_VIDEO_MEMORY_SIZE>;
     using VirtualMemoryType = std::array<uint8_t, TOTAL_MEMORY_SIZE>;
     explicit Machine();
-    explicit Machine(std::vector<uint8_t> const &bytes);
+    /**
+     * @brief Create machine with its own image of the program, the bytes are copied once and can be a view into a mapped file
+     *
+     * @param program Bytes of the program, anything past the end of the memory is ignored
+     */
+    explicit Machine(std::span<const uint8_t> program);
+
+    /**
+     * @brief Create machine that runs the program from the shared image. Memory pages are only copied once the machine writes to them,
+     * so any number of machines can run the same image for the cost of their stack pages
+     *
+     * @param image Image created by PagedMemory::createImage
+     */
+    explicit Machine(std::shared_ptr<const PagedMemory::Image> image);
+
+    /**
+     * @brief Remember the current state so that reset can return to it. Machines copied from this one share the snapshot
+     *
+     */
+    void saveSnapshot();
+
+    /**
+     * @brief Return to the last saved snapshot, or to the state the machine was created in if there is none.
+     * Only memory pages and video buffers that were written since then are copied, which makes it much cheaper than creating a new machine
+     *
+     */
+    void reset();
+
+    bool hasSnapshot() const { return m_snapshot != nullptr; }
+
+    /**
+     * @brief Write bytes into memory, for example to patch the program
+     *
+     * @param address Address of the first byte, wraps around the end of the memory
+     * @param bytes Bytes to write
+     */
+    void writeMemory(size_t address, std::span<const uint8_t> bytes) { m_memory.write(address, bytes); }
+
+    /// @brief Execute one instruction using the opcode table generated at compile time
     void step();
 
+    /**
+     * @brief Same as step but decodes the instruction with switches instead of the opcode table.
+     * Kept as the reference that the table and the other execution cores are checked against
+     *
+     */
+    void stepReference();
+
+    /**
+     * @brief Execute up to the given number of instructions. Loops that only read registers, timers and keys are recognized and their
+     * remaining iterations are skipped, since nothing they read can change until the timers advance or input arrives.
+     * Result is the same as calling step the same number of times
+     *
+     * @param steps Number of instructions to execute
+     * @return size_t Number of executed instructions including skipped ones, can be less if the machine halted or is waiting for input
+     */
+    size_t run(size_t steps);
+
+    /// @brief True if the last run ended in a loop that can only be left once the timers advance or the keys change
+    bool isIdle() const { return m_idle; }
+
     void render();
 
     /**
@@ -24,6 +93,14 @@ public:
      */
     void writeSpriteToMemory(size_t position, std::vector<uint8_t> sprite);
 
+    /**
+     * @brief Replace the program in memory while the machine is running. Registers, stack pointer, program counter and video memory are kept,
+     * bytes past the end of the new program are left untouched so that the stack survives
+     *
+     * @param program Bytes of the new program
+     */
+    void loadProgram(std::span<const uint8_t> program);
+
     /**
      * @brief Push the value into the virtual memory stack
      *
@@ -40,22 +117,71 @@ public:
 
     bool hasValueOnStack();
 
-    /// @brief Get video memory currently used for writing data
+    /// @brief Get video memory currently used for writing data, the buffers are copied by the next reset.
+    /// Writes through the reference are not seen by the state hash, only draw instructions and clearWorkVideoMemory update it
     /// @return
-    VideoMemoryType &getWorkVideoMemory() { return m_usingPrimaryVideoBuffer ? m_videoPrimaryBuffer : m_videoSecondaryBuffer; }
+    VideoMemoryType &getWorkVideoMemory()
+    {
+        m_videoModified = true;
+        return m_usingPrimaryVideoBuffer ? m_videoPrimaryBuffer : m_videoSecondaryBuffer;
+    }
+    void clearWorkVideoMemory()
+    {
+        std::fill(getWorkVideoMemory().begin(), getWorkVideoMemory().end(), 0);
+        getWorkVideoHash() = 0;
+    }
     /// @brief Get video memory currently ready to be displayed
     /// @return
     VideoMemoryType &getCurrentVideoMemory() { return !m_usingPrimaryVideoBuffer ? m_videoPrimaryBuffer : m_videoSecondaryBuffer; }
-    VirtualMemoryType &getMemory() { return m_memory; }
+    VideoMemoryType const &getCurrentVideoMemory() const { return !m_usingPrimaryVideoBuffer ? m_videoPrimaryBuffer : m_videoSecondaryBuffer; }
+    PagedMemory const &getMemory() const { return m_memory; }
     void receiveInput(uint8_t key);
-    bool isAwaitingInput() { return m_inputAwaitDestinationRegister.has_value(); }
+    bool isAwaitingInput() const { return m_inputAwaitDestinationRegister.has_value(); }
 
     void setKeyState(uint8_t key, bool pressed);
 
+    /// @brief There are only 16 keys, skip instructions with a larger value in the register see a key that is never pressed
+    bool isKeyPressed(uint8_t key) const { return key < m_keystates.size() && m_keystates[key]; }
+
+    /// @brief Set the state of every key, bit N holds key N down
+    void setKeyStates(uint16_t keys);
+
     void advanceTimers();
 
+    /**
+     * @brief Start a frame the way the emulator does: timers advance, then a machine waiting for input gets the lowest held key.
+     * Instructions of the frame are left to the caller so that it can run them in the interpreter or as native code
+     *
+     * @param keys Keys held down during the frame, bit N is key N
+     * @return true If the machine should execute the instructions of the frame, false if it halted or waited for input this frame
+     */
+    bool beginFrame(uint16_t keys);
+
     bool shouldBeep() const { return m_audioTimer > 0; }
 
+    uint8_t getTimer() const { return m_timer; }
+    uint8_t getAudioTimer() const { return m_audioTimer; }
+
+    /// @brief True once the machine executed halt instruction or program counter left the memory
+    bool isHalted() const { return m_programCounter >= m_memory.size(); }
+
+    size_t getProgramCounter() const { return m_programCounter; }
+    size_t getMemoryRegister() const { return m_memoryRegister; }
+    size_t getStackPointer() const { return m_stackPointer; }
+    std::array<uint8_t, 16> const &getRegisters() const { return m_registers; }
+
+    /**
+     * @brief Get hash of everything that determines how the machine continues: memory, both video buffers, registers, timers, keys and input state.
+     * Memory and video hashes are updated by every write, so this is cheap enough to check after every instruction.
+     * Equal machines have equal hashes on any build and host
+     *
+     * @return uint64_t Hash of the state
+     */
+    uint64_t getStateHash() const;
+
+    /// @brief Same as getStateHash but hashes memory and video from scratch, for checking that the incremental hashes are up to date
+    uint64_t computeStateHash() const;
+
 private:
     void opDraw(uint16_t opcode);
 
@@ -84,6 +210,16 @@ private:
     }
     void opRegisterToRegister(uint16_t opcode);
 
+    /**
+     * @brief Execute 8XY? instruction, shared by both ways of decoding so that the flag quirks are only written once
+     *
+     * @tparam Operation Lowest nibble of the opcode
+     * @param x Destination register
+     * @param y Source register
+     */
+    template <uint8_t Operation>
+    void registerOperation(size_t x, size_t y);
+
     inline void updateFlags(uint16_t res)
     { // set carry flag
         m_registers[15] = (m_registers[15] & 0xFE) | (res & 0xF00 > 0);
@@ -95,10 +231,35 @@ private:
 
     bool handleKeyOpcodes(uint16_t opcode);
 
-    VirtualMemoryType m_memory;
+    uint64_t &getWorkVideoHash() { return m_usingPrimaryVideoBuffer ? m_videoPrimaryHash : m_videoSecondaryHash; }
+    uint64_t getCurrentVideoHash() const { return !m_usingPrimaryVideoBuffer ? m_videoPrimaryHash : m_videoSecondaryHash; }
+
+    /// @brief Combine hashes of memory and video with the rest of the state
+    uint64_t combineStateHash(uint64_t memoryHash, uint64_t currentVideoHash, uint64_t workVideoHash) const;
+
+    /// @brief Check if the instruction changes nothing besides registers and the program counter
+    static bool isIdleInstruction(uint16_t opcode);
+
+    /**
+     * @brief Execute one iteration of the loop that starts at the program counter and check if it returned to the same state
+     *
+     * @param maxSteps Maximum number of instructions to execute
+     * @param length Set to the number of instructions in the iteration if loop is idle, otherwise 0
+     * @return size_t Number of executed instructions
+     */
+    size_t runLoopIteration(size_t maxSteps, size_t &length);
+
+    PagedMemory m_memory;
+    /// @brief State that reset returns to, nullptr to return to the initial state
+    std::shared_ptr<const Machine> m_snapshot;
+    /// @brief Video buffers could have been written since the last snapshot or reset
+    bool m_videoModified = true;
     VideoMemoryType m_videoPrimaryBuffer;
     VideoMemoryType m_videoSecondaryBuffer;
     bool m_usingPrimaryVideoBuffer;
+    /// @brief XOR of StateHash::PixelKeys of the lit pixels of each buffer
+    uint64_t m_videoPrimaryHash = 0;
+    uint64_t m_videoSecondaryHash = 0;
     size_t m_programCounter;
     size_t m_memoryRegister;
     std::array<uint8_t, 16> m_registers;
@@ -109,4 +270,10 @@ private:
     std::array<bool, 16> m_keystates;
     uint8_t m_audioTimer = 0;
     uint8_t m_timer = 0;
+
+    /// @brief Start of the last loop that turned out not to be idle
+    size_t m_busyLoopStart = SIZE_MAX;
+    /// @brief How many more times the busy loop is entered before it is checked again
+    size_t m_busyLoopSkips = 0;
+    bool m_idle = false;
 };
\ No newline at end of file
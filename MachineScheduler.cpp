@@ -0,0 +1,187 @@
+#include "MachineScheduler.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+/// @brief Timers stop at zero, so no machine needs more advances than this to catch up
+static const uint64_t MaxTimerCatchUp = 0xff;
+
+SessionTask &SessionTask::operator=(SessionTask &&other) noexcept
+{
+    if (this != &other)
+    {
+        if (m_handle)
+        {
+            m_handle.destroy();
+        }
+        m_handle = std::exchange(other.m_handle, nullptr);
+    }
+    return *this;
+}
+
+SessionTask::~SessionTask()
+{
+    if (m_handle)
+    {
+        m_handle.destroy();
+    }
+}
+
+MachineScheduler::MachineScheduler(size_t instructionsPerFrame) : m_instructionsPerFrame(instructionsPerFrame)
+{
+}
+
+MachineScheduler::~MachineScheduler()
+{
+    // coroutines refer to their sessions, so they go first
+    for (auto &[id, session] : m_sessions)
+    {
+        session->task.reset();
+    }
+}
+
+MachineScheduler::SessionId MachineScheduler::addSession(std::shared_ptr<const PagedMemory::Image> image)
+{
+    const SessionId id = m_nextId++;
+    std::unique_ptr<Session> session = std::make_unique<Session>(id, std::move(image), m_frame);
+    session->task.emplace(runSession(*session));
+    m_ready.push_back(id);
+    m_sessions.emplace(id, std::move(session));
+    return id;
+}
+
+void MachineScheduler::removeSession(SessionId id)
+{
+    m_sessions.erase(id);
+}
+
+void MachineScheduler::setKeyState(SessionId id, uint8_t key, bool pressed)
+{
+    auto it = m_sessions.find(id);
+    if (it == m_sessions.end())
+    {
+        return;
+    }
+    Session &session = *it->second;
+    if (session.state == SessionState::Halted)
+    {
+        return;
+    }
+    if (session.state == SessionState::AwaitingKeys)
+    {
+        // frames it slept through ran with the old keys
+        catchUp(session);
+    }
+    session.machine.setKeyState(key, pressed);
+    // the emulator only remembers a press that arrives while the machine waits, earlier presses are lost.
+    // The machine can start waiting during a slice, so its own state is checked rather than the one of the session
+    if (pressed && session.machine.isAwaitingInput())
+    {
+        session.pendingInput = key;
+    }
+    if ((session.state == SessionState::AwaitingInput && pressed) || session.state == SessionState::AwaitingKeys)
+    {
+        wake(session);
+    }
+}
+
+size_t MachineScheduler::runFrame()
+{
+    m_frame++;
+    m_running.clear();
+    std::swap(m_running, m_ready);
+    size_t resumed = 0;
+    for (SessionId id : m_running)
+    {
+        auto it = m_sessions.find(id);
+        if (it == m_sessions.end())
+        {
+            continue;
+        }
+        it->second->task->resume();
+        resumed++;
+    }
+    return resumed;
+}
+
+Machine const &MachineScheduler::getMachine(SessionId id) const
+{
+    auto it = m_sessions.find(id);
+    if (it == m_sessions.end())
+    {
+        throw std::out_of_range("Session " + std::to_string(id) + " does not exist");
+    }
+    return it->second->machine;
+}
+
+MachineScheduler::SessionState MachineScheduler::getState(SessionId id) const
+{
+    auto it = m_sessions.find(id);
+    if (it == m_sessions.end())
+    {
+        throw std::out_of_range("Session " + std::to_string(id) + " does not exist");
+    }
+    return it->second->state;
+}
+
+SessionTask MachineScheduler::runSession(Session &session)
+{
+    Machine &machine = session.machine;
+    // every resume happens at the start of a frame: timers advance first, then the machine gets its input or executes, same as in the emulator
+    while (true)
+    {
+        catchUp(session);
+        if (machine.isHalted())
+        {
+            session.state = SessionState::Halted;
+            co_return;
+        }
+        if (machine.isAwaitingInput())
+        {
+            if (!session.pendingInput.has_value())
+            {
+                co_await KeyEvent{session, SessionState::AwaitingInput};
+                continue;
+            }
+            machine.receiveInput(session.pendingInput.value());
+            session.pendingInput.reset();
+        }
+        else
+        {
+            machine.run(m_instructionsPerFrame);
+            if (machine.isHalted())
+            {
+                session.state = SessionState::Halted;
+                co_return;
+            }
+            // with the timer at zero nothing the idle loop reads changes until a key does
+            if (machine.isIdle() && machine.getTimer() == 0 && !machine.isAwaitingInput())
+            {
+                co_await KeyEvent{session, SessionState::AwaitingKeys};
+                continue;
+            }
+        }
+        co_await NextFrame{*this, session};
+    }
+}
+
+void MachineScheduler::catchUp(Session &session)
+{
+    const uint64_t skipped = m_frame - session.frame;
+    if (session.state == SessionState::AwaitingKeys)
+    {
+        // the loop is still the same with the timer at zero, run skips its iterations instead of executing them
+        session.machine.run(skipped * m_instructionsPerFrame);
+    }
+    for (uint64_t i = 0; i < std::min(skipped, MaxTimerCatchUp); i++)
+    {
+        session.machine.advanceTimers();
+    }
+    session.frame = m_frame;
+}
+
+void MachineScheduler::wake(Session &session)
+{
+    session.state = SessionState::Runnable;
+    m_ready.push_back(session.id);
+}
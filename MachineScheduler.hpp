@@ -0,0 +1,161 @@
+#pragma once
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+
+#include "Machine.hpp"
+
+/**
+ * @brief Coroutine running a single machine, owned by the scheduler. Starts suspended
+ *
+ */
+class SessionTask
+{
+public:
+    struct promise_type
+    {
+        SessionTask get_return_object() { return SessionTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { throw; }
+    };
+
+    explicit SessionTask(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+    SessionTask(SessionTask &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    SessionTask &operator=(SessionTask &&other) noexcept;
+    SessionTask(SessionTask const &) = delete;
+    SessionTask &operator=(SessionTask const &) = delete;
+    ~SessionTask();
+
+    void resume() { m_handle.resume(); }
+    bool isDone() const { return m_handle.done(); }
+
+private:
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+/**
+ * @brief Runs many machines on one thread, every machine is a coroutine that executes one slice per frame and then waits for the next frame.
+ * Machines that wait for input, halted or spin in a loop that nothing but a key can end are not resumed at all until a key event arrives,
+ * so the cost of a frame only depends on the number of machines that actually run. Sleeping machines are caught up when they wake up,
+ * which gives the same result as running them on every frame.
+ *
+ * The scheduler is not thread safe, hosts with many cores run one scheduler per thread
+ */
+class MachineScheduler
+{
+public:
+    using SessionId = uint64_t;
+
+    enum class SessionState
+    {
+        /// @brief Runs on the next frame
+        Runnable,
+        /// @brief Waiting for a key press to deliver to Fx0A
+        AwaitingInput,
+        /// @brief Spinning in an idle loop with the timer at zero, only a key change can end it
+        AwaitingKeys,
+        Halted,
+    };
+
+    /**
+     * @param instructionsPerFrame Instructions every runnable machine executes per frame. Idle loops are only recognized
+     * when a slice is longer than one iteration of the loop
+     */
+    explicit MachineScheduler(size_t instructionsPerFrame = 1);
+
+    ~MachineScheduler();
+
+    MachineScheduler(MachineScheduler const &) = delete;
+    MachineScheduler &operator=(MachineScheduler const &) = delete;
+
+    /**
+     * @brief Add a machine, it starts running on the next frame
+     *
+     * @param image Program to run, created by PagedMemory::createImage
+     * @return SessionId Identifier used for input and for removing the session
+     */
+    SessionId addSession(std::shared_ptr<const PagedMemory::Image> image);
+
+    void removeSession(SessionId id);
+
+    /**
+     * @brief Change the state of a key. A press that arrives while the machine waits for input is delivered on the next frame,
+     * the same way the emulator handles the last pressed key, presses before the wait are not remembered. Any key event wakes a machine that waits for keys
+     *
+     */
+    void setKeyState(SessionId id, uint8_t key, bool pressed);
+
+    /**
+     * @brief Advance all timers by one frame and run one slice of every runnable machine
+     *
+     * @return size_t Number of machines that were resumed
+     */
+    size_t runFrame();
+
+    /// @brief Get the machine of the session, its timers are only current for machines that ran this frame
+    Machine const &getMachine(SessionId id) const;
+
+    SessionState getState(SessionId id) const;
+
+    size_t getSessionCount() const { return m_sessions.size(); }
+    size_t getRunnableCount() const { return m_ready.size(); }
+    uint64_t getFrame() const { return m_frame; }
+
+private:
+    struct Session
+    {
+        Session(SessionId id, std::shared_ptr<const PagedMemory::Image> image, uint64_t frame) : id(id), machine(std::move(image)), frame(frame) {}
+
+        SessionId id;
+        Machine machine;
+        /// @brief Last frame whose timer advance was applied to the machine
+        uint64_t frame;
+        SessionState state = SessionState::Runnable;
+        /// @brief Key pressed while the machine waits for input, delivered on the next frame
+        std::optional<uint8_t> pendingInput;
+        std::optional<SessionTask> task;
+    };
+
+    /// @brief Suspends the session until the next frame
+    struct NextFrame
+    {
+        MachineScheduler &scheduler;
+        Session &session;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<>) { scheduler.m_ready.push_back(session.id); }
+        void await_resume() const noexcept {}
+    };
+
+    /// @brief Suspends the session until a key event arrives, without taking part in frames
+    struct KeyEvent
+    {
+        Session &session;
+        SessionState reason;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<>) { session.state = reason; }
+        void await_resume() const noexcept {}
+    };
+
+    SessionTask runSession(Session &session);
+
+    /// @brief Bring the machine to the state it would have if it ran every frame it was not resumed in
+    void catchUp(Session &session);
+
+    /// @brief Make a sleeping session run again on the next frame
+    void wake(Session &session);
+
+    std::unordered_map<SessionId, std::unique_ptr<Session>> m_sessions;
+    /// @brief Sessions resumed on the next frame, removed sessions are skipped
+    std::vector<SessionId> m_ready;
+    /// @brief Sessions resumed by the current frame, kept to reuse the allocation
+    std::vector<SessionId> m_running;
+    size_t m_instructionsPerFrame;
+    uint64_t m_frame = 0;
+    SessionId m_nextId = 1;
+};
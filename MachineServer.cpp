@@ -0,0 +1,476 @@
+#include "MachineServer.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "StateHash.hpp"
+#include "VideoCapture.hpp"
+
+using ServerProtocol::Command;
+using ServerProtocol::Status;
+
+/// @brief Connections with this many bytes of unsent responses are not read from until the client catches up
+static const size_t MaxPendingOutput = 1 << 20;
+
+/// @brief Bytes read from a socket at once
+static const size_t ReadChunkSize = 1 << 16;
+
+/**
+ * @brief Reads little endian numbers from the payload of a request
+ *
+ */
+class PayloadReader
+{
+public:
+    explicit PayloadReader(std::span<const uint8_t> payload) : m_payload(payload) {}
+
+    uint16_t readU16()
+    {
+        require(2);
+        const uint16_t value = m_payload[m_offset] | (m_payload[m_offset + 1] << 8);
+        m_offset += 2;
+        return value;
+    }
+
+    uint32_t readU32()
+    {
+        require(4);
+        uint32_t value = 0;
+        for (size_t i = 0; i < 4; i++)
+        {
+            value |= (uint32_t)m_payload[m_offset + i] << (i * 8);
+        }
+        m_offset += 4;
+        return value;
+    }
+
+    /// @brief Make sure the whole payload was read, extra bytes mean the client and server disagree on the command
+    void finish() const
+    {
+        if (m_offset != m_payload.size())
+        {
+            throw ServerError("Payload is " + std::to_string(m_payload.size() - m_offset) + " bytes longer than expected");
+        }
+    }
+
+private:
+    void require(size_t bytes) const
+    {
+        if (m_offset + bytes > m_payload.size())
+        {
+            throw ServerError("Payload is too short");
+        }
+    }
+
+    std::span<const uint8_t> m_payload;
+    size_t m_offset = 0;
+};
+
+static void writeU16(std::vector<uint8_t> &output, uint16_t value)
+{
+    output.push_back(value & 0xff);
+    output.push_back(value >> 8);
+}
+
+static void writeU32(std::vector<uint8_t> &output, uint32_t value)
+{
+    for (size_t i = 0; i < 4; i++)
+    {
+        output.push_back((value >> (i * 8)) & 0xff);
+    }
+}
+
+static void writeU64(std::vector<uint8_t> &output, uint64_t value)
+{
+    for (size_t i = 0; i < 8; i++)
+    {
+        output.push_back((value >> (i * 8)) & 0xff);
+    }
+}
+
+MachineServer::~MachineServer()
+{
+    for (std::unique_ptr<Connection> const &connection : m_connections)
+    {
+        close(connection->socket);
+    }
+    if (m_listenSocket >= 0)
+    {
+        close(m_listenSocket);
+        unlink(m_socketPath.c_str());
+    }
+}
+
+void MachineServer::useTranslationCache(std::string const &directory)
+{
+    try
+    {
+        m_cache.emplace(directory);
+    }
+    catch (TranslationCacheError const &e)
+    {
+        throw ServerError(e.what());
+    }
+}
+
+void MachineServer::listen(std::string const &path)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        throw ServerError("Socket path " + path + " is too long");
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    m_listenSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listenSocket < 0)
+    {
+        throw ServerError(std::string("Unable to create socket: ") + std::strerror(errno));
+    }
+    // socket of a server that did not shut down cleanly would make bind fail
+    unlink(path.c_str());
+    if (bind(m_listenSocket, (sockaddr *)&address, sizeof(address)) != 0 || ::listen(m_listenSocket, SOMAXCONN) != 0)
+    {
+        const int error = errno;
+        close(m_listenSocket);
+        m_listenSocket = -1;
+        throw ServerError("Unable to listen on " + path + ": " + std::strerror(error));
+    }
+    m_socketPath = path;
+}
+
+void MachineServer::run()
+{
+    std::vector<pollfd> descriptors;
+    while (!m_stopRequested)
+    {
+        descriptors.clear();
+        descriptors.push_back({m_listenSocket, POLLIN, 0});
+        for (std::unique_ptr<Connection> const &connection : m_connections)
+        {
+            const size_t pending = connection->output.size() - connection->sent;
+            const bool readable = pending < MaxPendingOutput && !connection->finished;
+            descriptors.push_back({connection->socket, (short)((readable ? POLLIN : 0) | (pending > 0 ? POLLOUT : 0)), 0});
+        }
+        if (poll(descriptors.data(), descriptors.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw ServerError(std::string("Polling sockets failed: ") + std::strerror(errno));
+        }
+        // connections accepted now are not in the descriptors yet, so they are only served on the next iteration
+        const size_t connectionCount = m_connections.size();
+        for (size_t i = 0; i < connectionCount; i++)
+        {
+            Connection &connection = *m_connections[i];
+            const short events = descriptors[i + 1].revents;
+            if ((events & (POLLIN | POLLHUP | POLLERR)) && !connection.finished)
+            {
+                receive(connection);
+            }
+            if (connection.output.size() > connection.sent)
+            {
+                send(connection);
+            }
+            if (connection.finished && connection.output.empty())
+            {
+                connection.closed = true;
+            }
+        }
+        if (descriptors[0].revents & POLLIN)
+        {
+            acceptConnections();
+        }
+        std::erase_if(m_connections, [](std::unique_ptr<Connection> const &connection)
+                      {
+                          if (connection->closed)
+                          {
+                              close(connection->socket);
+                          }
+                          return connection->closed; });
+    }
+}
+
+void MachineServer::acceptConnections()
+{
+    while (true)
+    {
+        const int socket = accept4(m_listenSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0)
+        {
+            return;
+        }
+        std::unique_ptr<Connection> connection = std::make_unique<Connection>();
+        connection->socket = socket;
+        m_connections.push_back(std::move(connection));
+    }
+}
+
+void MachineServer::receive(Connection &connection)
+{
+    bool peerClosed = false;
+    while (connection.output.size() - connection.sent < MaxPendingOutput)
+    {
+        const size_t start = connection.input.size();
+        connection.input.resize(start + ReadChunkSize);
+        const ssize_t received = read(connection.socket, connection.input.data() + start, ReadChunkSize);
+        connection.input.resize(start + std::max<ssize_t>(received, 0));
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            peerClosed = true;
+        }
+        if (received <= 0)
+        {
+            break;
+        }
+
+        // every request that arrived whole is executed before anything is sent back
+        size_t offset = 0;
+        while (connection.input.size() - offset >= 4)
+        {
+            const uint8_t *header = connection.input.data() + offset;
+            const uint32_t size = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24);
+            if (size == 0 || size > ServerProtocol::MaxMessageSize)
+            {
+                // the stream can not be trusted to be in sync anymore
+                connection.closed = true;
+                return;
+            }
+            if (connection.input.size() - offset - 4 < size)
+            {
+                break;
+            }
+            handleRequest(std::span<const uint8_t>(header + 4, size), connection.output);
+            offset += 4 + size;
+        }
+        connection.input.erase(connection.input.begin(), connection.input.begin() + offset);
+    }
+    // responses to what the client sent before shutting down are still delivered
+    connection.finished = peerClosed;
+}
+
+void MachineServer::send(Connection &connection)
+{
+    while (connection.sent < connection.output.size())
+    {
+        const ssize_t sent = ::send(connection.socket, connection.output.data() + connection.sent, connection.output.size() - connection.sent, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                connection.closed = true;
+            }
+            return;
+        }
+        connection.sent += sent;
+    }
+    connection.output.clear();
+    connection.sent = 0;
+}
+
+void MachineServer::handleRequest(std::span<const uint8_t> request, std::vector<uint8_t> &response)
+{
+    const size_t start = response.size();
+    writeU32(response, 0);
+    response.push_back((uint8_t)Status::Ok);
+    try
+    {
+        execute((Command)request[0], request.subspan(1), response);
+    }
+    catch (std::exception const &e)
+    {
+        response.resize(start);
+        writeU32(response, 0);
+        response.push_back((uint8_t)Status::Error);
+        const std::string message = e.what();
+        response.insert(response.end(), message.begin(), message.end());
+    }
+    const uint32_t size = response.size() - start - 4;
+    for (size_t i = 0; i < 4; i++)
+    {
+        response[start + i] = (size >> (i * 8)) & 0xff;
+    }
+}
+
+MachineServer::ServedMachine &MachineServer::getMachine(uint32_t id)
+{
+    auto it = m_machines.find(id);
+    if (it == m_machines.end())
+    {
+        throw ServerError("Machine " + std::to_string(id) + " does not exist");
+    }
+    return *it->second;
+}
+
+void MachineServer::execute(Command command, std::span<const uint8_t> payload, std::vector<uint8_t> &response)
+{
+    PayloadReader reader(payload);
+    switch (command)
+    {
+    case Command::Ping:
+        reader.finish();
+        break;
+    case Command::LoadRom:
+    {
+        if (payload.empty() || payload.size() > TOTAL_MEMORY_SIZE)
+        {
+            throw ServerError("Rom has to be between 1 and " + std::to_string(TOTAL_MEMORY_SIZE) + " bytes");
+        }
+        const uint32_t id = m_nextRomId++;
+        LoadedRom rom = {PagedMemory::createImage(payload)};
+        if (m_cache.has_value())
+        {
+            // a rom that can't be translated still runs, just in the interpreter
+            try
+            {
+                rom.native = m_cache->translate(payload, "rom " + std::to_string(id));
+            }
+            catch (TranslationCacheError const &e)
+            {
+                std::cerr << e.what() << std::endl;
+            }
+        }
+        m_roms.emplace(id, rom);
+        writeU32(response, id);
+    }
+    break;
+    case Command::UnloadRom:
+    {
+        const uint32_t id = reader.readU32();
+        reader.finish();
+        // machines keep their own reference to the image
+        if (m_roms.erase(id) == 0)
+        {
+            throw ServerError("Rom " + std::to_string(id) + " does not exist");
+        }
+    }
+    break;
+    case Command::CreateMachine:
+    {
+        const uint32_t romId = reader.readU32();
+        reader.finish();
+        auto it = m_roms.find(romId);
+        if (it == m_roms.end())
+        {
+            throw ServerError("Rom " + std::to_string(romId) + " does not exist");
+        }
+        const uint32_t id = m_nextMachineId++;
+        m_machines.emplace(id, std::make_unique<ServedMachine>(ServedMachine{Machine(it->second.image), it->second.native}));
+        writeU32(response, id);
+    }
+    break;
+    case Command::DestroyMachine:
+    {
+        const uint32_t id = reader.readU32();
+        reader.finish();
+        if (m_machines.erase(id) == 0)
+        {
+            throw ServerError("Machine " + std::to_string(id) + " does not exist");
+        }
+    }
+    break;
+    case Command::ResetMachine:
+    {
+        ServedMachine &served = getMachine(reader.readU32());
+        reader.finish();
+        served.machine.reset();
+        served.keys = 0;
+    }
+    break;
+    case Command::SetKeys:
+    {
+        ServedMachine &served = getMachine(reader.readU32());
+        served.keys = reader.readU16();
+        reader.finish();
+        served.machine.setKeyStates(served.keys);
+    }
+    break;
+    case Command::StepInstructions:
+    {
+        ServedMachine &served = getMachine(reader.readU32());
+        const uint32_t count = reader.readU32();
+        reader.finish();
+        if (count > ServerProtocol::MaxInstructionsPerRequest)
+        {
+            throw ServerError("Step of " + std::to_string(count) + " instructions is above the limit of " + std::to_string(ServerProtocol::MaxInstructionsPerRequest));
+        }
+        writeU32(response, served.native != nullptr ? served.native->run(served.machine, count) : served.machine.run(count));
+    }
+    break;
+    case Command::StepFrames:
+    {
+        ServedMachine &served = getMachine(reader.readU32());
+        const uint32_t frames = reader.readU32();
+        const uint32_t instructionsPerFrame = reader.readU32();
+        reader.finish();
+        // frames cost something even without instructions
+        if ((uint64_t)frames * std::max(instructionsPerFrame, 1u) > ServerProtocol::MaxInstructionsPerRequest)
+        {
+            throw ServerError("Step of " + std::to_string(frames) + " frames of " + std::to_string(instructionsPerFrame) +
+                              " instructions is above the limit of " + std::to_string(ServerProtocol::MaxInstructionsPerRequest) + " instructions");
+        }
+        Machine &machine = served.machine;
+        uint32_t frame = 0;
+        for (; frame < frames && !machine.isHalted(); frame++)
+        {
+            if (!machine.beginFrame(served.keys))
+            {
+                continue;
+            }
+            if (served.native != nullptr)
+            {
+                served.native->run(machine, instructionsPerFrame);
+            }
+            else
+            {
+                machine.run(instructionsPerFrame);
+            }
+        }
+        writeU32(response, frame);
+    }
+    break;
+    case Command::GetState:
+    {
+        Machine const &machine = getMachine(reader.readU32()).machine;
+        reader.finish();
+        writeU16(response, machine.getProgramCounter());
+        writeU16(response, machine.getMemoryRegister());
+        writeU16(response, machine.getStackPointer());
+        response.push_back(machine.getTimer());
+        response.push_back(machine.getAudioTimer());
+        response.push_back(machine.isHalted());
+        response.push_back(machine.isAwaitingInput());
+        response.insert(response.end(), machine.getRegisters().begin(), machine.getRegisters().end());
+    }
+    break;
+    case Command::GetFrameHash:
+    {
+        Machine const &machine = getMachine(reader.readU32()).machine;
+        reader.finish();
+        std::array<uint8_t, TOTAL_VIDEO_MEMORY_SIZE / 8> packed;
+        VideoCapture::packFrame(machine.getCurrentVideoMemory(), packed);
+        writeU64(response, StateHash::hashBytes(packed));
+    }
+    break;
+    case Command::GetFrame:
+    {
+        Machine const &machine = getMachine(reader.readU32()).machine;
+        reader.finish();
+        const size_t offset = response.size();
+        response.resize(offset + TOTAL_VIDEO_MEMORY_SIZE / 8);
+        VideoCapture::packFrame(machine.getCurrentVideoMemory(), std::span<uint8_t, TOTAL_VIDEO_MEMORY_SIZE / 8>(response.data() + offset, TOTAL_VIDEO_MEMORY_SIZE / 8));
+    }
+    break;
+    default:
+        throw ServerError("Unknown command " + std::to_string((int)command));
+    }
+}
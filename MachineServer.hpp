@@ -0,0 +1,175 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Machine.hpp"
+#include "TranslationCache.hpp"
+
+/**
+ * @brief Exception class for errors in setting up the server or in requests of clients
+ *
+ */
+class ServerError : public std::runtime_error
+{
+public:
+    explicit ServerError(std::string const &msg) : std::runtime_error(msg) {}
+};
+
+/**
+ * @brief Binary protocol spoken over the socket, all numbers are little endian.
+ * Clients can send any number of requests without waiting, responses come back in the same order
+ * @code
+ * request:  u32 size of the rest, u8 command, payload
+ * response: u32 size of the rest, u8 status, payload (error message if status is Error)
+ * @endcode
+ * Payloads of the requests and their responses:
+ * @code
+ * Ping                                                        ->
+ * LoadRom          program bytes                              -> u32 rom
+ * UnloadRom        u32 rom                                    ->
+ * CreateMachine    u32 rom                                    -> u32 machine
+ * DestroyMachine   u32 machine                                ->
+ * ResetMachine     u32 machine                                ->
+ * SetKeys          u32 machine, u16 key mask                  ->
+ * StepInstructions u32 machine, u32 count                     -> u32 executed instructions
+ * StepFrames       u32 machine, u32 frames, u32 instructions  -> u32 executed frames
+ * GetState         u32 machine                                -> u16 pc, u16 i, u16 sp, u8 timer, u8 audio timer, u8 halted, u8 awaiting input, u8[16] registers
+ * GetFrameHash     u32 machine                                -> u64 FNV-1a hash of the bytes GetFrame returns, see StateHash::hashBytes
+ * GetFrame         u32 machine                                -> video memory packed into bits, lowest bit is the leftmost pixel
+ * @endcode
+ * All machines share one thread, so a step may execute at most MaxInstructionsPerRequest instructions, counting a frame as at least one.
+ * Larger steps are rejected with an error, clients split them into several requests
+ */
+namespace ServerProtocol
+{
+    enum class Command : uint8_t
+    {
+        Ping,
+        LoadRom,
+        UnloadRom,
+        CreateMachine,
+        DestroyMachine,
+        ResetMachine,
+        SetKeys,
+        StepInstructions,
+        StepFrames,
+        GetState,
+        GetFrameHash,
+        GetFrame,
+    };
+
+    enum class Status : uint8_t
+    {
+        Ok,
+        Error,
+    };
+
+    /// @brief Requests above this size close the connection, a program is the largest thing a client sends
+    static const uint32_t MaxMessageSize = TOTAL_MEMORY_SIZE + 64;
+
+    /// @brief Largest step a request can ask for, a few milliseconds in the interpreter so that other clients are not starved
+    static const uint32_t MaxInstructionsPerRequest = 1 << 20;
+}
+
+/**
+ * @brief Daemon that runs machines for clients connected to a Unix domain socket. Everything runs on one thread:
+ * every request that has fully arrived is executed and its response queued, then all queued responses are sent with as few writes as possible,
+ * so a client that pipelines thousands of requests pays for a single round trip. Roms and machines are shared by all connections
+ */
+class MachineServer
+{
+public:
+    MachineServer() = default;
+    MachineServer(MachineServer const &) = delete;
+    MachineServer &operator=(MachineServer const &) = delete;
+    ~MachineServer();
+
+    /**
+     * @brief Create the socket, replacing a file left behind at the path
+     *
+     * @param path Path of the socket
+     */
+    void listen(std::string const &path);
+
+    /// @brief Serve clients until stop is called
+    void run();
+
+    /**
+     * @brief Run loaded roms as native code from the translation cache, roms that are not in the cache yet are translated when they are loaded,
+     * which stalls every client for the few seconds it takes to compile
+     *
+     * @param directory Directory of the cache
+     */
+    void useTranslationCache(std::string const &directory);
+
+    /// @brief Make run return, safe to call from a signal handler
+    void stop() { m_stopRequested = true; }
+
+    /**
+     * @brief Execute a single request and append its response, independent of any connection
+     *
+     * @param request Command byte and payload, without the size
+     * @param response Buffer to append the whole response to, including its size
+     */
+    void handleRequest(std::span<const uint8_t> request, std::vector<uint8_t> &response);
+
+    size_t getMachineCount() const { return m_machines.size(); }
+
+private:
+    struct LoadedRom
+    {
+        std::shared_ptr<const PagedMemory::Image> image;
+        /// @brief Native code of the rom or nullptr if it runs in the interpreter
+        CompiledProgram const *native = nullptr;
+    };
+
+    struct ServedMachine
+    {
+        Machine machine;
+        CompiledProgram const *native = nullptr;
+        /// @brief Keys held down, the lowest one is delivered to a machine waiting for input
+        uint16_t keys = 0;
+    };
+
+    struct Connection
+    {
+        int socket = -1;
+        std::vector<uint8_t> input;
+        std::vector<uint8_t> output;
+        /// @brief Bytes of the output that were already sent
+        size_t sent = 0;
+        /// @brief Client shut down its side, the connection is closed once the responses are sent
+        bool finished = false;
+        bool closed = false;
+    };
+
+    /// @brief Execute the command, the payload of the response is appended after the status byte
+    void execute(ServerProtocol::Command command, std::span<const uint8_t> payload, std::vector<uint8_t> &response);
+
+    ServedMachine &getMachine(uint32_t id);
+
+    void acceptConnections();
+
+    /// @brief Read everything that arrived and execute all complete requests
+    void receive(Connection &connection);
+
+    /// @brief Write as much of the queued responses as the socket takes
+    void send(Connection &connection);
+
+    int m_listenSocket = -1;
+    std::string m_socketPath;
+    std::atomic<bool> m_stopRequested = false;
+    std::vector<std::unique_ptr<Connection>> m_connections;
+    std::optional<TranslationCache> m_cache;
+    std::unordered_map<uint32_t, LoadedRom> m_roms;
+    std::unordered_map<uint32_t, std::unique_ptr<ServedMachine>> m_machines;
+    uint32_t m_nextRomId = 1;
+    uint32_t m_nextMachineId = 1;
+};
@@ -0,0 +1,137 @@
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+static const char *StageNames[] = {"emulation", "update", "render"};
+
+Metrics::Metrics(Clock::duration interval) : m_interval(interval), m_intervalStart(Clock::now())
+{
+}
+
+size_t Metrics::getBucket(double microseconds)
+{
+    if (microseconds < 1.0)
+    {
+        return 0;
+    }
+    return std::min((size_t)(std::log2(microseconds) * BucketsPerOctave) + 1, BucketCount - 1);
+}
+
+double Metrics::getBucketLimit(size_t bucket)
+{
+    return std::exp2((double)bucket / BucketsPerOctave);
+}
+
+void Metrics::framePresented(Clock::time_point now)
+{
+    if (m_presentedBefore)
+    {
+        const double microseconds = std::chrono::duration<double, std::micro>(now - m_lastPresent).count();
+        m_frameTimes[getBucket(microseconds)]++;
+        m_maxFrameTime = std::max(m_maxFrameTime, microseconds);
+    }
+    m_presentedBefore = true;
+    m_lastPresent = now;
+    m_presentedFrames++;
+}
+
+void Metrics::sampleAudioQueue(uint32_t bytes)
+{
+    m_audioQueueBytes = bytes;
+    m_maxAudioQueueBytes = std::max(m_maxAudioQueueBytes, bytes);
+}
+
+double Metrics::getPercentile(double fraction) const
+{
+    uint64_t total = 0;
+    for (uint64_t count : m_frameTimes)
+    {
+        total += count;
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < m_frameTimes.size(); i++)
+    {
+        seen += m_frameTimes[i];
+        if (seen >= fraction * total)
+        {
+            // every value in the bucket is below its limit, but the maximum is a better estimate for the last bucket
+            return std::min(getBucketLimit(i), m_maxFrameTime);
+        }
+    }
+    return m_maxFrameTime;
+}
+
+bool Metrics::update(Clock::time_point now)
+{
+    if (now - m_intervalStart < m_interval)
+    {
+        return false;
+    }
+    const double seconds = std::chrono::duration<double>(now - m_intervalStart).count();
+    m_report.seconds = seconds;
+    m_report.instructionsPerSecond = m_instructions / seconds;
+    m_report.emulatedFrames = m_emulatedFrames;
+    m_report.presentedFrames = m_presentedFrames;
+    m_report.frameTimeP50 = getPercentile(0.5);
+    m_report.frameTimeP90 = getPercentile(0.9);
+    m_report.frameTimeP99 = getPercentile(0.99);
+    m_report.frameTimeMax = m_maxFrameTime;
+    double busy = 0;
+    for (size_t i = 0; i < m_stageTimes.size(); i++)
+    {
+        m_report.stageFractions[i] = std::chrono::duration<double>(m_stageTimes[i]).count() / seconds;
+        busy += m_report.stageFractions[i];
+    }
+    m_report.idleFraction = std::max(0.0, 1.0 - busy);
+    m_report.audioQueueBytes = m_audioQueueBytes;
+    m_report.maxAudioQueueBytes = m_maxAudioQueueBytes;
+
+    m_intervalStart = now;
+    m_stageTimes = {};
+    m_frameTimes = {};
+    m_instructions = 0;
+    m_emulatedFrames = 0;
+    m_presentedFrames = 0;
+    m_maxFrameTime = 0;
+    m_maxAudioQueueBytes = 0;
+    return true;
+}
+
+void Metrics::writeReport(std::ostream &stream) const
+{
+    char buffer[128];
+    std::snprintf(buffer, sizeof(buffer), "metrics seconds=%.3f ips=%.0f emulated_frames=%llu presented_frames=%llu",
+                  m_report.seconds, m_report.instructionsPerSecond, (unsigned long long)m_report.emulatedFrames, (unsigned long long)m_report.presentedFrames);
+    stream << buffer;
+    std::snprintf(buffer, sizeof(buffer), " frame_us_p50=%.0f frame_us_p90=%.0f frame_us_p99=%.0f frame_us_max=%.0f",
+                  m_report.frameTimeP50, m_report.frameTimeP90, m_report.frameTimeP99, m_report.frameTimeMax);
+    stream << buffer;
+    for (size_t i = 0; i < m_report.stageFractions.size(); i++)
+    {
+        std::snprintf(buffer, sizeof(buffer), " %s=%.4f", StageNames[i], m_report.stageFractions[i]);
+        stream << buffer;
+    }
+    std::snprintf(buffer, sizeof(buffer), " idle=%.4f audio_queue=%u audio_queue_max=%u",
+                  m_report.idleFraction, m_report.audioQueueBytes, m_report.maxAudioQueueBytes);
+    stream << buffer << std::endl;
+}
+
+std::string Metrics::getSummary() const
+{
+    char buffer[160];
+    std::snprintf(buffer, sizeof(buffer), "%.2f MIPS | %llu/%llu frames | p99 %.1f ms | emu %.0f%% upd %.0f%% rnd %.0f%% idle %.0f%% | audio %u B",
+                  m_report.instructionsPerSecond / 1e6,
+                  (unsigned long long)m_report.presentedFrames, (unsigned long long)m_report.emulatedFrames,
+                  m_report.frameTimeP99 / 1000.0,
+                  m_report.stageFractions[(size_t)Stage::Emulation] * 100.0,
+                  m_report.stageFractions[(size_t)Stage::Update] * 100.0,
+                  m_report.stageFractions[(size_t)Stage::Render] * 100.0,
+                  m_report.idleFraction * 100.0,
+                  m_report.audioQueueBytes);
+    return buffer;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * @brief Counters of the main loop: executed instructions, emulated and presented frames, time spent in each stage and
+ * frame time distribution. Values are collected over an interval and turned into a report once it ends
+ */
+class Metrics
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Parts of the main loop that are timed separately
+    enum class Stage
+    {
+        Emulation,
+        Update,
+        Render,
+        Count
+    };
+
+    /**
+     * @brief Values of a finished interval
+     *
+     */
+    struct Report
+    {
+        double seconds = 0;
+        double instructionsPerSecond = 0;
+        uint64_t emulatedFrames = 0;
+        uint64_t presentedFrames = 0;
+        /// @brief Time between presented frames in microseconds, approximated by the histogram buckets
+        double frameTimeP50 = 0;
+        double frameTimeP90 = 0;
+        double frameTimeP99 = 0;
+        double frameTimeMax = 0;
+        /// @brief Fraction of the interval spent in each stage
+        std::array<double, (size_t)Stage::Count> stageFractions = {};
+        /// @brief Fraction of the interval spent outside of any stage, mostly waiting for the next frame
+        double idleFraction = 0;
+        uint32_t audioQueueBytes = 0;
+        uint32_t maxAudioQueueBytes = 0;
+    };
+
+    explicit Metrics(Clock::duration interval = std::chrono::seconds(1));
+
+    void addStageTime(Stage stage, Clock::duration time) { m_stageTimes[(size_t)stage] += time; }
+
+    void addInstructions(uint64_t count) { m_instructions += count; }
+
+    void addEmulatedFrames(uint64_t count) { m_emulatedFrames += count; }
+
+    /// @brief Mark that a frame was shown, time since the previous one goes into the frame time histogram
+    void framePresented(Clock::time_point now);
+
+    /// @brief Record the number of bytes waiting in the audio queue
+    void sampleAudioQueue(uint32_t bytes);
+
+    /**
+     * @brief Finish the interval if it is over
+     *
+     * @param now Current time
+     * @return true If the interval ended and a new report is available
+     */
+    bool update(Clock::time_point now);
+
+    Report const &getReport() const { return m_report; }
+
+    /**
+     * @brief Write the last report as a single line of `key=value` pairs
+     *
+     * @param stream Stream to write to
+     */
+    void writeReport(std::ostream &stream) const;
+
+    /// @brief Get short human readable version of the last report
+    std::string getSummary() const;
+
+private:
+    /// @brief Number of histogram buckets per power of two of microseconds
+    static const size_t BucketsPerOctave = 4;
+    /// @brief Histogram covers frame times up to about 17 seconds
+    static const size_t BucketCount = 24 * BucketsPerOctave;
+
+    static size_t getBucket(double microseconds);
+
+    static double getBucketLimit(size_t bucket);
+
+    double getPercentile(double fraction) const;
+
+    Clock::duration m_interval;
+    Clock::time_point m_intervalStart;
+    Clock::time_point m_lastPresent;
+    bool m_presentedBefore = false;
+    std::array<Clock::duration, (size_t)Stage::Count> m_stageTimes = {};
+    std::array<uint64_t, BucketCount> m_frameTimes = {};
+    uint64_t m_instructions = 0;
+    uint64_t m_emulatedFrames = 0;
+    uint64_t m_presentedFrames = 0;
+    double m_maxFrameTime = 0;
+    uint32_t m_audioQueueBytes = 0;
+    uint32_t m_maxAudioQueueBytes = 0;
+    Report m_report;
+};
@@ -0,0 +1,169 @@
+#include "PagedMemory.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+/// @brief Image shared by every memory that was created without a program
+static std::shared_ptr<const PagedMemory::Image> const &getEmptyImage()
+{
+    static const std::shared_ptr<const PagedMemory::Image> image = PagedMemory::createImage({});
+    return image;
+}
+
+std::shared_ptr<const PagedMemory::Image> PagedMemory::createImage(std::span<const uint8_t> bytes)
+{
+    std::shared_ptr<Image> image = std::make_shared<Image>();
+    const size_t length = std::min(bytes.size(), size());
+    uint8_t *contents = image->bytes.data();
+    std::memcpy(contents, bytes.data(), length);
+    std::memset(contents + length, 0, size() - length);
+    // zeros past the program are already part of the empty hash
+    image->hash = StateHash::EmptyMemoryHash;
+    for (size_t address = 0; address < length; address++)
+    {
+        image->hash ^= StateHash::getByteKey(address, 0) ^ StateHash::getByteKey(address, contents[address]);
+    }
+    return image;
+}
+
+PagedMemory::PagedMemory() : PagedMemory(getEmptyImage())
+{
+}
+
+PagedMemory::PagedMemory(std::shared_ptr<const Image> image) : m_image(std::move(image)), m_hash(m_image->hash)
+{
+    m_imageBytes = m_image->bytes.data();
+}
+
+PagedMemory::PagedMemory(PagedMemory const &other) : PagedMemory(other.m_image)
+{
+    *this = other;
+}
+
+PagedMemory &PagedMemory::operator=(PagedMemory const &other)
+{
+    if (this != &other)
+    {
+        m_image = other.m_image;
+        m_imageBytes = other.m_imageBytes;
+        m_privateMask = other.m_privateMask;
+        m_dirtyMask = other.m_dirtyMask;
+        m_sharedSize = other.m_sharedSize;
+        m_hash = other.m_hash;
+        for (size_t i = 0; i < PageCount; i++)
+        {
+            if (other.isPagePrivate(i))
+            {
+                getAllocatedPage(i) = *other.m_privatePages[i];
+            }
+        }
+    }
+    return *this;
+}
+
+void PagedMemory::restore(PagedMemory const &snapshot)
+{
+    if (m_image != snapshot.m_image)
+    {
+        *this = snapshot;
+        m_dirtyMask = 0;
+        return;
+    }
+    for (uint64_t dirty = m_dirtyMask; dirty != 0; dirty &= dirty - 1)
+    {
+        const size_t page = std::countr_zero(dirty);
+        if (snapshot.isPagePrivate(page))
+        {
+            // page is already private since it was written
+            *m_privatePages[page] = *snapshot.m_privatePages[page];
+        }
+        else
+        {
+            makePageShared(page);
+        }
+    }
+    m_dirtyMask = 0;
+    m_hash = snapshot.m_hash;
+    updateSharedSize();
+}
+
+void PagedMemory::reset()
+{
+    m_privateMask = 0;
+    m_dirtyMask = 0;
+    m_sharedSize = TOTAL_MEMORY_SIZE;
+    m_hash = m_image->hash;
+}
+
+void PagedMemory::write(size_t address, std::span<const uint8_t> bytes)
+{
+    while (!bytes.empty())
+    {
+        address %= size();
+        const size_t page = address / PageSize;
+        const size_t offset = address % PageSize;
+        const size_t count = std::min(bytes.size(), PageSize - offset);
+        if (std::memcmp(getPage(page).data() + offset, bytes.data(), count) != 0)
+        {
+            uint8_t *target = getWritablePage(page) + offset;
+            for (size_t i = 0; i < count; i++)
+            {
+                m_hash ^= StateHash::getByteKey(address + i, target[i]) ^ StateHash::getByteKey(address + i, bytes[i]);
+                target[i] = bytes[i];
+            }
+        }
+        bytes = bytes.subspan(count);
+        address += count;
+    }
+}
+
+std::array<uint8_t, TOTAL_MEMORY_SIZE> PagedMemory::toArray() const
+{
+    std::array<uint8_t, TOTAL_MEMORY_SIZE> result;
+    for (size_t i = 0; i < PageCount; i++)
+    {
+        std::memcpy(result.data() + i * PageSize, getPage(i).data(), PageSize);
+    }
+    return result;
+}
+
+uint64_t PagedMemory::computeHash() const
+{
+    uint64_t hash = 0;
+    for (size_t page = 0; page < PageCount; page++)
+    {
+        std::span<const uint8_t, PageSize> contents = getPage(page);
+        for (size_t i = 0; i < PageSize; i++)
+        {
+            hash ^= StateHash::getByteKey(page * PageSize + i, contents[i]);
+        }
+    }
+    return hash;
+}
+
+void PagedMemory::makePagePrivate(size_t page)
+{
+    std::span<const uint8_t, PageSize> contents = m_image->getPage(page);
+    std::copy(contents.begin(), contents.end(), getAllocatedPage(page).begin());
+    m_privateMask |= 1ull << page;
+    m_sharedSize = std::min(m_sharedSize, page * PageSize);
+}
+
+PagedMemory::Page &PagedMemory::getAllocatedPage(size_t page)
+{
+    if (m_privatePages[page] == nullptr)
+    {
+        m_privatePages[page] = std::make_unique<Page>();
+    }
+    return *m_privatePages[page];
+}
+
+void PagedMemory::makePageShared(size_t page)
+{
+    m_privateMask &= ~(1ull << page);
+}
+
+void PagedMemory::updateSharedSize()
+{
+    m_sharedSize = m_privateMask == 0 ? TOTAL_MEMORY_SIZE : std::countr_zero(m_privateMask) * PageSize;
+}
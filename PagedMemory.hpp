@@ -0,0 +1,170 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include "StateHash.hpp"
+
+/**
+ * @brief Memory of the machine split into pages that are shared between instances until they are written to.
+ * All machines running the same program can use one immutable image of it and only get private copies of the pages
+ * they write, which for most programs is just the page that holds the stack.
+ *
+ * Addresses wrap around the end of the memory
+ */
+class PagedMemory
+{
+public:
+    static constexpr size_t PageSize = 256;
+    static constexpr size_t PageCount = TOTAL_MEMORY_SIZE / PageSize;
+    using Page = std::array<uint8_t, PageSize>;
+    /// @brief Contents of the whole memory that is never changed once created
+    struct Image
+    {
+        /// @brief Bytes of every page one after another, so reads of shared memory need no page lookup
+        std::array<uint8_t, TOTAL_MEMORY_SIZE> bytes;
+        /// @brief Hash of the contents, memories start from it and update it on every write
+        uint64_t hash = 0;
+
+        uint8_t read(size_t address) const { return bytes[address]; }
+
+        std::span<const uint8_t, PageSize> getPage(size_t page) const { return std::span<const uint8_t, PageSize>(bytes.data() + page * PageSize, PageSize); }
+    };
+
+    /**
+     * @brief Create an image with the program at the start and the rest of the memory cleared.
+     * Images should be created once per program and passed to every machine running it
+     *
+     * @param bytes Bytes of the program, anything past the memory size is ignored
+     */
+    static std::shared_ptr<const Image> createImage(std::span<const uint8_t> bytes);
+
+    /// @brief Create memory filled with zeroes
+    explicit PagedMemory();
+
+    explicit PagedMemory(std::shared_ptr<const Image> image);
+
+    /// @brief Copy shares the image and copies private pages
+    PagedMemory(PagedMemory const &other);
+
+    /// @brief Copy shares the image and copies private pages into the pages this memory already allocated, so it only allocates the first time
+    PagedMemory &operator=(PagedMemory const &other);
+
+    /**
+     * @brief Restore the contents of the snapshot, copying only the pages written since this memory was copied from,
+     * restored to or marked clean together with the snapshot
+     *
+     * @param snapshot Copy of this memory taken when it was last marked clean
+     */
+    void restore(PagedMemory const &snapshot);
+
+    /// @brief Go back to the contents of the image, pages keep their allocations for later writes
+    void reset();
+
+    /// @brief Forget which pages were written, called once the memory matches its snapshot
+    void markClean() { m_dirtyMask = 0; }
+
+    /// @brief Pages written since the memory was last marked clean, one bit per page
+    uint64_t getDirtyMask() const { return m_dirtyMask; }
+
+    uint8_t read(size_t address) const
+    {
+        address %= TOTAL_MEMORY_SIZE;
+        if (isPagePrivate(address / PageSize))
+        {
+            return (*m_privatePages[address / PageSize])[address % PageSize];
+        }
+        return m_imageBytes[address];
+    }
+
+    /// @brief Read two bytes as a big endian value, the way instructions are stored
+    uint16_t readWord(size_t address) const
+    {
+        if (address + 1 < m_sharedSize)
+        {
+            return readSharedWord(address);
+        }
+        return (read(address) << 8) | read(address + 1);
+    }
+
+    /**
+     * @brief Read two bytes that are known to lie below getSharedSize, without looking up the pages
+     *
+     */
+    uint16_t readSharedWord(size_t address) const { return (m_imageBytes[address] << 8) | m_imageBytes[address + 1]; }
+
+    /// @brief Hash of the whole contents, kept up to date by every write. See StateHash
+    uint64_t getHash() const { return m_hash; }
+
+    /// @brief Hash the whole contents from scratch, for checking the one kept by writes
+    uint64_t computeHash() const;
+
+    /// @brief Number of bytes from the start of the memory that are still read from the image, everything up to the first private page
+    size_t getSharedSize() const { return m_sharedSize; }
+
+    void write(size_t address, uint8_t value)
+    {
+        address %= TOTAL_MEMORY_SIZE;
+        uint8_t &byte = getWritablePage(address / PageSize)[address % PageSize];
+        m_hash ^= StateHash::getByteKey(address, byte) ^ StateHash::getByteKey(address, value);
+        byte = value;
+    }
+
+    /**
+     * @brief Write bytes starting at the address. Pages whose contents would not change stay shared
+     *
+     * @param address Address of the first byte
+     * @param bytes Bytes to write
+     */
+    void write(size_t address, std::span<const uint8_t> bytes);
+
+    /// @brief Get contents of the page without copying it
+    std::span<const uint8_t, PageSize> getPage(size_t page) const
+    {
+        return isPagePrivate(page) ? std::span<const uint8_t, PageSize>(*m_privatePages[page]) : m_image->getPage(page);
+    }
+
+    /// @brief Check if the instance has its own copy of the page
+    bool isPagePrivate(size_t page) const { return (m_privateMask >> page) & 1; }
+
+    std::shared_ptr<const Image> const &getImage() const { return m_image; }
+
+    /// @brief Copy the whole memory into contiguous array
+    std::array<uint8_t, TOTAL_MEMORY_SIZE> toArray() const;
+
+    static constexpr size_t size() { return TOTAL_MEMORY_SIZE; }
+
+private:
+    uint8_t *getWritablePage(size_t page)
+    {
+        if (!isPagePrivate(page))
+        {
+            makePagePrivate(page);
+        }
+        m_dirtyMask |= 1ull << page;
+        return m_privatePages[page]->data();
+    }
+
+    void makePagePrivate(size_t page);
+
+    /// @brief Get page to copy private contents into, allocated if the memory never had it
+    Page &getAllocatedPage(size_t page);
+
+    /// @brief Drop the private copy of the page and read it from the image again, the allocation is kept
+    void makePageShared(size_t page);
+
+    void updateSharedSize();
+
+    static_assert(PageCount <= 64, "Private pages are tracked in a 64 bit mask");
+
+    std::shared_ptr<const Image> m_image;
+    /// @brief Contents of the image as one block, valid for every page that is not private
+    const uint8_t *m_imageBytes;
+    uint64_t m_privateMask = 0;
+    uint64_t m_dirtyMask = 0;
+    size_t m_sharedSize = TOTAL_MEMORY_SIZE;
+    uint64_t m_hash;
+    /// @brief Private copies of the pages, pages that became shared again keep their allocation until they are written to
+    std::array<std::unique_ptr<Page>, PageCount> m_privatePages;
+};
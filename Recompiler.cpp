@@ -0,0 +1,293 @@
+#include "Recompiler.hpp"
+#include <cstdarg>
+#include <cstdio>
+
+/**
+ * @brief printf style formatting into a string, generated lines are always short
+ *
+ */
+static std::string format(const char *fmt, ...)
+{
+    char buffer[128];
+    va_list args;
+    va_start(args, fmt);
+    std::vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+    return buffer;
+}
+
+void Recompiler::generate(std::span<const uint8_t> rom, std::string const &name, std::ostream &stream)
+{
+    m_disassembler.analyze(rom);
+    m_blockStarts.assign(m_disassembler.getRomSize(), false);
+    for (BasicBlock const &block : m_disassembler.getBlocks())
+    {
+        m_blockStarts[block.start] = true;
+    }
+
+    stream << "// Generated by gob8rc from " << name << ", do not edit\n";
+    stream << "#include <algorithm>\n#include <bit>\n#include <cstdlib>\n\n#include \"CompiledProgram.hpp\"\n\n";
+    stream << "namespace\n{\n";
+    stream << "const uint8_t Rom[] = {";
+    for (size_t i = 0; i < rom.size(); i++)
+    {
+        stream << (i % 16 == 0 ? "\n    " : " ") << format("0x%02x,", rom[i]);
+    }
+    stream << "};\n\n";
+
+    stream << "size_t run(Machine &machine, size_t maxSteps)\n{\n";
+    stream << "    std::array<uint8_t, 16> &registers = CompiledProgram::getRegisters(machine);\n";
+    for (size_t reg = 0; reg < 16; reg++)
+    {
+        stream << format("    uint8_t v%x = registers[%zu];\n", (unsigned)reg, reg);
+    }
+    stream << "    size_t i = CompiledProgram::getMemoryRegister(machine);\n";
+    stream << "    size_t pc = CompiledProgram::getProgramCounter(machine);\n";
+    stream << "    size_t steps = 0;\n";
+    stream << "dispatch:\n    switch (pc)\n    {\n";
+    for (BasicBlock const &block : m_disassembler.getBlocks())
+    {
+        stream << format("    case 0x%03x:\n        goto L_%03x;\n", block.start, block.start);
+    }
+    stream << "    }\n    goto leave;\n";
+    for (BasicBlock const &block : m_disassembler.getBlocks())
+    {
+        writeBlock(block, stream);
+    }
+    stream << "leave:\n";
+    for (size_t reg = 0; reg < 16; reg++)
+    {
+        stream << format("    registers[%zu] = v%x;\n", reg, (unsigned)reg);
+    }
+    stream << "    CompiledProgram::getMemoryRegister(machine) = i;\n";
+    stream << "    CompiledProgram::getProgramCounter(machine) = pc;\n";
+    stream << "    return steps;\n}\n\n";
+
+    std::string escaped;
+    for (char c : name)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped.push_back('\\');
+        }
+        escaped.push_back(c);
+    }
+    stream << "const CompiledProgram Program(\"" << escaped << "\", Rom, run);\n";
+    stream << "}\n";
+}
+
+void Recompiler::writeBlock(BasicBlock const &block, std::ostream &stream) const
+{
+    const size_t length = (block.end - block.start) / 2;
+    stream << format("L_%03x:\n", block.start);
+    // leave the rest of the budget to the interpreter instead of stopping in the middle of the block
+    stream << format("    if (maxSteps - steps < %zu)\n    {\n        pc = 0x%03x;\n        goto leave;\n    }\n", length, block.start);
+    stream << format("    steps += %zu;\n", length);
+    for (uint16_t address = block.start; address < block.end; address += 2)
+    {
+        const size_t remaining = (block.end - address) / 2 - 1;
+        stream << format("    // %03x  %04x  ", address, m_disassembler.getOpcode(address)) << m_disassembler.formatInstruction(address) << "\n";
+        if (writeInstruction(address, remaining, stream))
+        {
+            return;
+        }
+    }
+    stream << transfer(block.end, 0, "    ");
+}
+
+std::string Recompiler::transfer(uint16_t address, size_t remaining, std::string const &indent) const
+{
+    std::string code;
+    if (remaining > 0)
+    {
+        code += indent + format("steps -= %zu;\n", remaining);
+    }
+    if (isBlockStart(address))
+    {
+        return code + indent + format("goto L_%03x;\n", address);
+    }
+    return code + indent + format("pc = 0x%03x;\n", address) + indent + "goto leave;\n";
+}
+
+bool Recompiler::writeInstruction(uint16_t address, size_t remaining, std::ostream &stream) const
+{
+    // semantics follow Machine::step exactly, including its quirks
+    const uint16_t opcode = m_disassembler.getOpcode(address);
+    const unsigned x = (opcode & 0x0f00) >> 8;
+    const unsigned y = (opcode & 0x00f0) >> 4;
+    const unsigned value = opcode & 0x00ff;
+    const uint16_t next = address + 2;
+    const char *indent = "    ";
+    const std::string skipped = "        ";
+    std::string condition;
+    switch ((opcode & 0xf000) >> 12)
+    {
+    case 0x0:
+        if (opcode == 0x00e1)
+        {
+            if (remaining > 0)
+            {
+                stream << indent << format("steps -= %zu;\n", remaining);
+            }
+            stream << indent << "pc = machine.getMemory().size();\n" << indent << "goto leave;\n";
+            return true;
+        }
+        if ((opcode & 0x0f00) != 0)
+        {
+            return false;
+        }
+        switch (opcode & 0x000f)
+        {
+        case 0x0:
+            stream << indent << "machine.clearWorkVideoMemory();\n";
+            break;
+        case 0x2:
+            stream << indent << "CompiledProgram::swapBuffers(machine);\n";
+            break;
+        case 0xe:
+            if (remaining > 0)
+            {
+                stream << indent << format("steps -= %zu;\n", remaining);
+            }
+            stream << indent << "pc = machine.popFromStack();\n" << indent << "pc += 2;\n" << indent << "goto dispatch;\n";
+            return true;
+        }
+        return false;
+    case 0x1:
+        stream << transfer(opcode & 0x0fff, remaining, indent);
+        return true;
+    case 0x2:
+        stream << indent << format("machine.pushToStack(0x%03x);\n", address);
+        // stack reached the program, let the interpreter continue in case it was overwritten
+        stream << indent << format("if (machine.getStackPointer() < sizeof(Rom))\n") << indent << "{\n";
+        if (remaining > 0)
+        {
+            stream << skipped << format("steps -= %zu;\n", remaining);
+        }
+        stream << skipped << format("pc = 0x%03x;\n", opcode & 0x0fff) << skipped << "goto leave;\n" << indent << "}\n";
+        stream << transfer(opcode & 0x0fff, remaining, indent);
+        return true;
+    case 0x3:
+        condition = format("v%x == 0x%02x", x, value);
+        break;
+    case 0x4:
+        condition = format("v%x != 0x%02x", x, value);
+        break;
+    case 0x5:
+        condition = format("v%x == v%x", x, y);
+        break;
+    case 0x6:
+        stream << indent << format("v%x = 0x%02x;\n", x, value);
+        return false;
+    case 0x7:
+        stream << indent << format("v%x += 0x%02x;\n", x, value);
+        return false;
+    case 0x8:
+        switch (opcode & 0x000f)
+        {
+        case 0x0:
+            stream << indent << format("v%x = v%x;\n", x, y);
+            break;
+        case 0x1:
+            stream << indent << format("v%x |= v%x;\n", x, y);
+            break;
+        case 0x2:
+            stream << indent << format("v%x &= v%x;\n", x, y);
+            break;
+        case 0x3:
+            stream << indent << format("v%x ^= v%x;\n", x, y);
+            break;
+        case 0x4:
+        case 0x5:
+        case 0x7:
+            stream << indent << "{\n";
+            if ((opcode & 0x000f) == 0x4)
+            {
+                stream << skipped << format("const uint16_t res = (uint16_t)v%x + (uint8_t)v%x;\n", x, y);
+            }
+            else if ((opcode & 0x000f) == 0x5)
+            {
+                stream << skipped << format("const uint16_t res = (uint16_t)v%x - (uint8_t)v%x;\n", x, y);
+            }
+            else
+            {
+                stream << skipped << format("const uint16_t res = (uint8_t)v%x - (uint16_t)v%x;\n", y, x);
+            }
+            // Machine::updateFlags only keeps the lowest bit of the result in the carry flag
+            stream << skipped << "vf = (vf & 0xFE) | (res & 1);\n";
+            stream << skipped << format("v%x = res;\n", x) << indent << "}\n";
+            break;
+        case 0x6:
+            stream << indent << format("v%x = std::rotr(v%x, v%x);\n", x, x, y);
+            break;
+        case 0x8:
+            stream << indent << format("v%x = std::rotl(v%x, v%x);\n", x, x, y);
+            break;
+        }
+        return false;
+    case 0xA:
+        stream << indent << format("i = 0x%03x;\n", opcode & 0x0fff);
+        return false;
+    case 0xB:
+        if (remaining > 0)
+        {
+            stream << indent << format("steps -= %zu;\n", remaining);
+        }
+        stream << indent << format("pc = (v0 + 0x%04x) & 0x0fff;\n", opcode) << indent << "pc += 2;\n" << indent << "goto dispatch;\n";
+        return true;
+    case 0xC:
+        stream << indent << format("v%x = rand() & 0x%02x;\n", x, value);
+        return false;
+    case 0xD:
+        stream << indent << format("registers[%u] = v%x;\n", x, x) << indent << format("registers[%u] = v%x;\n", y, y);
+        stream << indent << "CompiledProgram::getMemoryRegister(machine) = i;\n";
+        stream << indent << format("CompiledProgram::draw(machine, 0x%04x);\n", opcode);
+        return false;
+    case 0xE:
+        if (value == 0x9e)
+        {
+            condition = format("CompiledProgram::isKeyPressed(machine, v%x)", x);
+        }
+        else if (value == 0xa1)
+        {
+            condition = format("!CompiledProgram::isKeyPressed(machine, v%x)", x);
+        }
+        else
+        {
+            return false;
+        }
+        break;
+    case 0xF:
+        switch (value)
+        {
+        case 0x07:
+            stream << indent << format("v%x = CompiledProgram::getTimer(machine);\n", x);
+            break;
+        case 0x0a:
+            stream << indent << format("CompiledProgram::awaitInput(machine, %u);\n", x);
+            if (remaining > 0)
+            {
+                stream << indent << format("steps -= %zu;\n", remaining);
+            }
+            stream << indent << format("pc = 0x%03x;\n", next) << indent << "goto leave;\n";
+            return true;
+        case 0x15:
+            stream << indent << format("CompiledProgram::getTimer(machine) = v%x;\n", x);
+            break;
+        case 0x18:
+            stream << indent << format("CompiledProgram::getAudioTimer(machine) = v%x;\n", x);
+            break;
+        case 0x1e:
+            stream << indent << format("i += v%x;\n", x);
+            break;
+        }
+        return false;
+    default:
+        // 9XY0 is not implemented by the machine
+        return false;
+    }
+    stream << indent << "if (" << condition << ")\n" << indent << "{\n";
+    stream << transfer(next + 2, remaining, skipped) << indent << "}\n";
+    stream << transfer(next, remaining, indent);
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Disassembler.hpp"
+
+/**
+ * @brief Translates the program into a C++ source file that runs it as native code.
+ * Every basic block found by the disassembler becomes a labeled region of a single function which keeps registers in local variables,
+ * jumps between blocks become gotos and returns and jumps by register go through a switch over all known blocks.
+ * Anything that can't be reached statically is left to the interpreter, see CompiledProgram
+ */
+class Recompiler
+{
+public:
+    /**
+     * @brief Write C++ source for the program
+     *
+     * @param rom Bytes of the program
+     * @param name Name the program is registered with
+     * @param stream Stream to write the source to
+     */
+    void generate(std::span<const uint8_t> rom, std::string const &name, std::ostream &stream);
+
+    /// @brief Number of blocks translated by the last call to generate
+    size_t getBlockCount() const { return m_disassembler.getBlocks().size(); }
+
+    /// @brief Number of bytes translated by the last call to generate
+    size_t getCodeSize() const { return m_disassembler.getCodeSize(); }
+
+    bool hasIndirectJumps() const { return m_disassembler.hasIndirectJumps(); }
+
+private:
+    void writeBlock(BasicBlock const &block, std::ostream &stream) const;
+
+    /**
+     * @brief Write code for a single instruction
+     *
+     * @param address Address of the instruction
+     * @param remaining Number of instructions left in the block after this one, they are not executed if the instruction leaves the block
+     * @param stream Stream to write to
+     * @return true If the instruction always transfers control somewhere else
+     */
+    bool writeInstruction(uint16_t address, size_t remaining, std::ostream &stream) const;
+
+    /**
+     * @brief Get code that continues execution at the address
+     *
+     * @param address Address to continue from
+     * @param remaining Number of instructions of the current block that will not be executed
+     * @param indent Indentation of the code
+     */
+    std::string transfer(uint16_t address, size_t remaining, std::string const &indent) const;
+
+    bool isBlockStart(uint16_t address) const { return address < m_blockStarts.size() && m_blockStarts[address]; }
+
+    Disassembler m_disassembler;
+    std::vector<bool> m_blockStarts;
+};
@@ -0,0 +1,161 @@
+#include "RomPack.hpp"
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "StateHash.hpp"
+
+// the mapped file is read in place, so its layout has to be the layout of the structures
+static_assert(std::endian::native == std::endian::little, "Rom packs are little endian");
+static_assert(sizeof(RomPackFormat::Header) == 32 && sizeof(RomPackFormat::Entry) == 32, "Rom pack structures must not be padded");
+
+void RomPackWriter::add(std::string const &name, std::span<const uint8_t> rom)
+{
+    if (rom.empty() || rom.size() > TOTAL_MEMORY_SIZE)
+    {
+        throw RomPackError("Rom " + name + " has to be between 1 and " + std::to_string(TOTAL_MEMORY_SIZE) + " bytes");
+    }
+    if (!m_roms.emplace(name, std::vector<uint8_t>(rom.begin(), rom.end())).second)
+    {
+        throw RomPackError("Pack already contains a rom named " + name);
+    }
+}
+
+void RomPackWriter::write(std::string const &path) const
+{
+    using namespace RomPackFormat;
+    std::vector<Entry> entries;
+    std::string names;
+    // map keeps the roms sorted by name which is the order of the index
+    for (auto const &[name, rom] : m_roms)
+    {
+        entries.push_back(Entry{StateHash::hashBytes(rom), 0, (uint32_t)rom.size(), (uint32_t)names.size(), (uint32_t)name.size(), 0});
+        names += name;
+    }
+    Header header = {};
+    std::memcpy(header.magic, Magic, sizeof(header.magic));
+    header.version = Version;
+    header.romCount = entries.size();
+    header.namesOffset = sizeof(Header) + entries.size() * sizeof(Entry);
+    header.namesSize = names.size();
+    uint64_t offset = header.namesOffset + header.namesSize;
+    for (Entry &entry : entries)
+    {
+        offset = (offset + Alignment - 1) / Alignment * Alignment;
+        entry.offset = offset;
+        offset += entry.size;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        throw RomPackError("Unable to create " + path);
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(Entry));
+    file.write(names.data(), names.size());
+    static const char Padding[Alignment] = {};
+    uint64_t written = header.namesOffset + header.namesSize;
+    size_t index = 0;
+    for (auto const &[name, rom] : m_roms)
+    {
+        file.write(Padding, entries[index].offset - written);
+        file.write(reinterpret_cast<const char *>(rom.data()), rom.size());
+        written = entries[index].offset + rom.size();
+        index++;
+    }
+    if (!file)
+    {
+        throw RomPackError("Unable to write " + path);
+    }
+}
+
+RomPack::RomPack(std::string const &path)
+{
+    using namespace RomPackFormat;
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw RomPackError("Unable to open " + path + ": " + std::strerror(errno));
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Header))
+    {
+        close(fd);
+        throw RomPackError(path + " is not a rom pack");
+    }
+    m_size = info.st_size;
+    void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive on its own
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        throw RomPackError("Unable to map " + path + ": " + std::strerror(errno));
+    }
+    m_data = static_cast<const uint8_t *>(data);
+
+    // every offset is checked once here so that the getters can trust the index
+    Header const &header = *reinterpret_cast<const Header *>(m_data);
+    const uint64_t indexEnd = sizeof(Header) + (uint64_t)header.romCount * sizeof(Entry);
+    std::string problem;
+    if (std::memcmp(header.magic, Magic, sizeof(header.magic)) != 0)
+    {
+        problem = "is not a rom pack";
+    }
+    else if (header.version != Version)
+    {
+        problem = "has version " + std::to_string(header.version) + ", expected " + std::to_string(Version);
+    }
+    else if (indexEnd > m_size || header.namesOffset < indexEnd || header.namesOffset > m_size || header.namesSize > m_size - header.namesOffset)
+    {
+        problem = "is truncated";
+    }
+    m_entries = reinterpret_cast<const Entry *>(m_data + sizeof(Header));
+    m_romCount = header.romCount;
+    m_names = reinterpret_cast<const char *>(m_data + header.namesOffset);
+    for (size_t i = 0; i < m_romCount && problem.empty(); i++)
+    {
+        Entry const &entry = m_entries[i];
+        if (entry.offset > m_size || entry.size > m_size - entry.offset || entry.nameOffset > header.namesSize || entry.nameSize > header.namesSize - entry.nameOffset)
+        {
+            problem = "has rom " + std::to_string(i) + " outside of the file";
+        }
+        else if (i > 0 && getName(i - 1) >= getName(i))
+        {
+            problem = "has an index that is not sorted by name";
+        }
+    }
+    if (!problem.empty())
+    {
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+        throw RomPackError(path + " " + problem);
+    }
+}
+
+RomPack::~RomPack()
+{
+    munmap(const_cast<uint8_t *>(m_data), m_size);
+}
+
+std::string_view RomPack::getName(size_t index) const
+{
+    return std::string_view(m_names + m_entries[index].nameOffset, m_entries[index].nameSize);
+}
+
+std::optional<size_t> RomPack::find(std::string_view name) const
+{
+    const RomPackFormat::Entry *end = m_entries + m_romCount;
+    const RomPackFormat::Entry *entry = std::lower_bound(m_entries, end, name, [this](RomPackFormat::Entry const &entry, std::string_view name)
+                                                         { return std::string_view(m_names + entry.nameOffset, entry.nameSize) < name; });
+    if (entry == end || getName(entry - m_entries) != name)
+    {
+        return {};
+    }
+    return entry - m_entries;
+}
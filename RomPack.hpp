@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Exception class for errors in writing or opening rom packs
+ *
+ */
+class RomPackError : public std::runtime_error
+{
+public:
+    explicit RomPackError(std::string const &msg) : std::runtime_error(msg) {}
+};
+
+/**
+ * @brief Layout of a rom pack: many programs in one file that is mapped into memory, so loading a corpus costs one open
+ * instead of one per program. Numbers are little endian, the index is sorted by name
+ * @code
+ * header: "G8PACK01", u32 version, u32 rom count, u64 offset of the names, u64 size of the names
+ * index:  u64 hash, u64 offset, u32 size, u32 offset of the name, u32 size of the name, u32 reserved (one entry per rom)
+ * names:  names of all roms one after another
+ * roms:   bytes of every rom, each starting at a multiple of the alignment
+ * @endcode
+ */
+namespace RomPackFormat
+{
+    static const char Magic[] = "G8PACK01";
+    static const uint32_t Version = 1;
+    /// @brief Roms start on cache lines so that copying them never straddles one more line than needed
+    static const size_t Alignment = 64;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t romCount;
+        uint64_t namesOffset;
+        uint64_t namesSize;
+    };
+
+    struct Entry
+    {
+        /// @brief FNV-1a hash of the rom, see StateHash::hashBytes
+        uint64_t hash;
+        uint64_t offset;
+        uint32_t size;
+        uint32_t nameOffset;
+        uint32_t nameSize;
+        uint32_t reserved;
+    };
+}
+
+/**
+ * @brief Collects roms and writes them as a rom pack
+ *
+ */
+class RomPackWriter
+{
+public:
+    /**
+     * @brief Add the rom to the pack
+     *
+     * @param name Name the rom is found by, has to be unique within the pack
+     * @param rom Bytes of the program, at most the size of the memory
+     */
+    void add(std::string const &name, std::span<const uint8_t> rom);
+
+    size_t getRomCount() const { return m_roms.size(); }
+
+    /// @brief Write the pack, replacing the file if it exists
+    void write(std::string const &path) const;
+
+private:
+    std::map<std::string, std::vector<uint8_t>> m_roms;
+};
+
+/**
+ * @brief Read only view of a rom pack. The whole file is mapped once and checked when it is opened,
+ * roms are spans into the mapping that stay valid as long as the pack exists and can be given to Machine as they are
+ */
+class RomPack
+{
+public:
+    /**
+     * @brief Map the pack and check its index
+     *
+     * @param path Path of the pack
+     */
+    explicit RomPack(std::string const &path);
+    RomPack(RomPack const &) = delete;
+    RomPack &operator=(RomPack const &) = delete;
+    ~RomPack();
+
+    size_t getRomCount() const { return m_romCount; }
+
+    std::string_view getName(size_t index) const;
+
+    uint64_t getHash(size_t index) const { return m_entries[index].hash; }
+
+    std::span<const uint8_t> getRom(size_t index) const { return std::span<const uint8_t>(m_data + m_entries[index].offset, m_entries[index].size); }
+
+    /**
+     * @brief Find the rom by its name
+     *
+     * @param name Name of the rom
+     * @return std::optional<size_t> Index of the rom or empty value if the pack does not contain it
+     */
+    std::optional<size_t> find(std::string_view name) const;
+
+private:
+    const uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+    const RomPackFormat::Entry *m_entries = nullptr;
+    size_t m_romCount = 0;
+    const char *m_names = nullptr;
+};
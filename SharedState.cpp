@@ -0,0 +1,156 @@
+#include "SharedState.hpp"
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Machine.hpp"
+
+/// @brief Reads that keep overlapping with updates give up after this many attempts
+static const size_t MaxReadAttempts = 1024;
+
+std::string SharedState::normalizeName(std::string const &name)
+{
+    return name.starts_with('/') ? name : "/" + name;
+}
+
+SharedStateWriter::SharedStateWriter(std::string const &name, size_t slotCount)
+    : m_name(SharedState::normalizeName(name)), m_slotCount(slotCount), m_size(SharedState::SlotsOffset + slotCount * sizeof(SharedState::Slot))
+{
+    if (slotCount == 0)
+    {
+        throw SharedStateError("Shared state needs at least one slot");
+    }
+    // a region left behind by a writer that crashed could have a different size
+    shm_unlink(m_name.c_str());
+    const int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        throw SharedStateError("Unable to create shared memory " + m_name + ": " + std::strerror(errno));
+    }
+    if (ftruncate(fd, m_size) != 0)
+    {
+        const int error = errno;
+        close(fd);
+        shm_unlink(m_name.c_str());
+        throw SharedStateError("Unable to resize shared memory " + m_name + ": " + std::strerror(error));
+    }
+    m_region = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m_region == MAP_FAILED)
+    {
+        const int error = errno;
+        shm_unlink(m_name.c_str());
+        throw SharedStateError("Unable to map shared memory " + m_name + ": " + std::strerror(error));
+    }
+    // new object is filled with zeros, which is an even sequence for every slot
+    m_slots = reinterpret_cast<SharedState::Slot *>((uint8_t *)m_region + SharedState::SlotsOffset);
+    for (size_t i = 0; i < slotCount; i++)
+    {
+        new (&m_slots[i]) SharedState::Slot();
+    }
+    SharedState::Header *header = static_cast<SharedState::Header *>(m_region);
+    header->version = SharedState::Version;
+    header->slotCount = slotCount;
+    header->slotSize = sizeof(SharedState::Slot);
+    // readers check the magic first, so it is written once the rest of the header is in place
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, SharedState::Magic, sizeof(header->magic));
+}
+
+SharedStateWriter::~SharedStateWriter()
+{
+    munmap(m_region, m_size);
+    shm_unlink(m_name.c_str());
+}
+
+void SharedStateWriter::publish(size_t slot, Machine const &machine, uint64_t frame)
+{
+    SharedState::Slot &target = m_slots[slot];
+    const uint64_t sequence = target.sequence.load(std::memory_order_relaxed);
+    target.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    SharedMachineState &state = target.state;
+    state.video = machine.getCurrentVideoMemory();
+    state.registers = machine.getRegisters();
+    state.programCounter = machine.getProgramCounter();
+    state.memoryRegister = machine.getMemoryRegister();
+    state.stackPointer = machine.getStackPointer();
+    state.timer = machine.getTimer();
+    state.audioTimer = machine.getAudioTimer();
+    state.halted = machine.isHalted();
+    state.awaitingInput = machine.isAwaitingInput();
+    state.frame = frame;
+
+    target.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+SharedStateReader::SharedStateReader(std::string const &name)
+{
+    const std::string objectName = SharedState::normalizeName(name);
+    const int fd = shm_open(objectName.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        throw SharedStateError("Unable to open shared memory " + objectName + ": " + std::strerror(errno));
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < SharedState::SlotsOffset)
+    {
+        close(fd);
+        throw SharedStateError("Shared memory " + objectName + " is not a shared state region");
+    }
+    m_size = info.st_size;
+    m_region = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m_region == MAP_FAILED)
+    {
+        throw SharedStateError("Unable to map shared memory " + objectName + ": " + std::strerror(errno));
+    }
+    SharedState::Header const *header = static_cast<SharedState::Header const *>(m_region);
+    std::string error;
+    if (std::memcmp(header->magic, SharedState::Magic, sizeof(header->magic)) != 0)
+    {
+        error = "Shared memory " + objectName + " is not a shared state region";
+    }
+    else if (header->version != SharedState::Version || header->slotSize != sizeof(SharedState::Slot))
+    {
+        error = "Shared memory " + objectName + " was written by an incompatible version";
+    }
+    else if (SharedState::SlotsOffset + header->slotCount * sizeof(SharedState::Slot) > m_size)
+    {
+        error = "Shared memory " + objectName + " is smaller than its slots";
+    }
+    if (!error.empty())
+    {
+        munmap(const_cast<void *>(m_region), m_size);
+        throw SharedStateError(error);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    m_slotCount = header->slotCount;
+    m_slots = reinterpret_cast<SharedState::Slot const *>((uint8_t const *)m_region + SharedState::SlotsOffset);
+}
+
+SharedStateReader::~SharedStateReader()
+{
+    munmap(const_cast<void *>(m_region), m_size);
+}
+
+std::optional<SharedMachineState> SharedStateReader::read(size_t slot) const
+{
+    SharedMachineState copy;
+    for (size_t attempt = 0; attempt < MaxReadAttempts; attempt++)
+    {
+        if (visit(slot, [&](SharedMachineState const &state)
+                  { std::memcpy(&copy, &state, sizeof(copy)); }))
+        {
+            return copy;
+        }
+        std::this_thread::yield();
+    }
+    return {};
+}
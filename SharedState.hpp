@@ -0,0 +1,168 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+class Machine;
+
+/**
+ * @brief Exception class for errors in creating or opening shared state regions
+ *
+ */
+class SharedStateError : public std::runtime_error
+{
+public:
+    explicit SharedStateError(std::string const &msg) : std::runtime_error(msg) {}
+};
+
+/**
+ * @brief State of one machine as other processes see it. Only fixed width fields, so that readers built by another compiler agree on the layout
+ *
+ */
+struct SharedMachineState
+{
+    std::array<uint8_t, TOTAL_VIDEO_MEMORY_SIZE> video;
+    std::array<uint8_t, 16> registers;
+    uint16_t programCounter;
+    uint16_t memoryRegister;
+    uint16_t stackPointer;
+    uint8_t timer;
+    uint8_t audioTimer;
+    uint8_t halted;
+    uint8_t awaitingInput;
+    /// @brief Frame of the writer the state was published on
+    uint64_t frame;
+};
+
+/**
+ * @brief Layout of a shared state region: header followed by one slot per machine. Every slot is guarded by a sequence counter
+ * which is odd while the writer updates the slot, readers check that it was even and did not change while they read
+ * @code
+ * header: "G8STATE1", u32 version, u32 slot count, u32 slot size
+ * slot:   u64 sequence, SharedMachineState (64 byte aligned)
+ * @endcode
+ */
+namespace SharedState
+{
+    static const char Magic[] = "G8STATE1";
+    static const uint32_t Version = 1;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t slotSize;
+    };
+
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> sequence;
+        SharedMachineState state;
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "sequence counters are shared between processes");
+
+    /// @brief Offset of the first slot from the start of the region
+    static const size_t SlotsOffset = (sizeof(Header) + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+
+    /// @brief POSIX shared memory names start with a slash, add one if the name does not have it
+    std::string normalizeName(std::string const &name);
+}
+
+/**
+ * @brief Publishes the state of machines into a POSIX shared memory region that any number of other processes can map.
+ * Publishing is a copy into the region and never waits for readers, so it does not change the timing of the emulation.
+ * The region is removed when the writer is destroyed, readers that already mapped it keep the last state
+ */
+class SharedStateWriter
+{
+public:
+    /**
+     * @param name Name of the shared memory object, replaces an object with the same name
+     * @param slotCount Number of machines
+     */
+    explicit SharedStateWriter(std::string const &name, size_t slotCount);
+
+    SharedStateWriter(SharedStateWriter const &) = delete;
+    SharedStateWriter &operator=(SharedStateWriter const &) = delete;
+
+    ~SharedStateWriter();
+
+    /**
+     * @brief Copy the video, registers and timers of the machine into the slot
+     *
+     * @param slot Slot of the machine
+     * @param machine Machine to publish
+     * @param frame Frame number readers can use to tell how far the writer is
+     */
+    void publish(size_t slot, Machine const &machine, uint64_t frame);
+
+    size_t getSlotCount() const { return m_slotCount; }
+
+private:
+    std::string m_name;
+    size_t m_slotCount;
+    size_t m_size;
+    void *m_region;
+    SharedState::Slot *m_slots;
+};
+
+/**
+ * @brief Maps a region created by SharedStateWriter read only, so readers can not disturb the writer or each other
+ *
+ */
+class SharedStateReader
+{
+public:
+    explicit SharedStateReader(std::string const &name);
+
+    SharedStateReader(SharedStateReader const &) = delete;
+    SharedStateReader &operator=(SharedStateReader const &) = delete;
+
+    ~SharedStateReader();
+
+    size_t getSlotCount() const { return m_slotCount; }
+
+    /// @brief Number of times the slot was published, cheap enough to poll for changes
+    uint64_t getGeneration(size_t slot) const { return m_slots[slot].sequence.load(std::memory_order_acquire) / 2; }
+
+    /**
+     * @brief Call the visitor with the state right inside the shared memory, without copying it.
+     * The writer can change the state while the visitor runs, anything the visitor got out of it is only valid if this returns true
+     *
+     * @param slot Slot to read
+     * @param visitor Called with SharedMachineState const &
+     * @return true The state did not change while the visitor ran
+     * @return false The writer updated the slot during the visit, try again
+     */
+    template <typename Visitor>
+    bool visit(size_t slot, Visitor &&visitor) const
+    {
+        SharedState::Slot const &target = m_slots[slot];
+        const uint64_t before = target.sequence.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            return false;
+        }
+        visitor(target.state);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return target.sequence.load(std::memory_order_relaxed) == before;
+    }
+
+    /**
+     * @brief Get a consistent copy of the state
+     *
+     * @return std::optional<SharedMachineState> Copy of the state or empty value if the writer kept updating the slot for every attempt,
+     * which also happens if the writer died in the middle of an update
+     */
+    std::optional<SharedMachineState> read(size_t slot) const;
+
+private:
+    size_t m_size;
+    void const *m_region;
+    size_t m_slotCount;
+    SharedState::Slot const *m_slots;
+};
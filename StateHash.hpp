@@ -0,0 +1,80 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * @brief Building blocks of the state hash that machines keep up to date while they run. Memory and video are hashed Zobrist style,
+ * every location with its value contributes a key and the hash is the XOR of all contributions, so a write only replaces the key
+ * of the old value with the key of the new one. Keys are derived from the location alone, which makes hashes equal across builds and hosts
+ */
+namespace StateHash
+{
+    /// @brief Scramble the bits of the value, finalizer of splitmix64
+    constexpr uint64_t mix(uint64_t value)
+    {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+        return value ^ (value >> 31);
+    }
+
+    /// @brief Add the value to the hash, order of the values matters
+    constexpr uint64_t combine(uint64_t hash, uint64_t value)
+    {
+        return mix((hash ^ value) + 0x9e3779b97f4a7c15ull);
+    }
+
+    template <size_t Size>
+    constexpr std::array<uint64_t, Size> makeKeys(uint64_t seed)
+    {
+        std::array<uint64_t, Size> keys = {};
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            keys[i] = mix(i + seed);
+        }
+        return keys;
+    }
+
+    /// @brief Key of every address, made odd so that multiplying it by different values gives different results
+    inline constexpr std::array<uint64_t, TOTAL_MEMORY_SIZE> AddressKeys = []()
+    {
+        std::array<uint64_t, TOTAL_MEMORY_SIZE> keys = makeKeys<TOTAL_MEMORY_SIZE>(0x6a09e667f3bcc909ull);
+        for (uint64_t &key : keys)
+        {
+            key |= 1;
+        }
+        return keys;
+    }();
+
+    /// @brief Contribution of every lit pixel, unlit pixels contribute nothing so that clear video hashes to 0
+    inline constexpr std::array<uint64_t, TOTAL_VIDEO_MEMORY_SIZE> PixelKeys = makeKeys<TOTAL_VIDEO_MEMORY_SIZE>(0xbb67ae8584caa73bull);
+
+    /// @brief Contribution of a byte of memory holding the value, a lookup and a multiplication since stack pushes pay it for every byte
+    constexpr uint64_t getByteKey(size_t address, uint8_t value)
+    {
+        return AddressKeys[address] * (value + 1);
+    }
+
+    /// @brief Hash of memory that only holds zeros, images start from it and only hash the bytes of their program
+    inline constexpr uint64_t EmptyMemoryHash = []()
+    {
+        uint64_t hash = 0;
+        for (size_t address = 0; address < TOTAL_MEMORY_SIZE; address++)
+        {
+            hash ^= getByteKey(address, 0);
+        }
+        return hash;
+    }();
+
+    /// @brief FNV-1a hash of the bytes, for contents that are hashed once such as programs rather than kept up to date
+    inline uint64_t hashBytes(std::span<const uint8_t> bytes)
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (uint8_t byte : bytes)
+        {
+            hash = (hash ^ byte) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+}
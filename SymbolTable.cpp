@@ -0,0 +1,143 @@
+#include "SymbolTable.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+static const std::string SymbolFileMagic = "gob8sym";
+static const int SymbolFileVersion = 1;
+
+void SymbolTable::addLabel(uint16_t address, std::string const &name)
+{
+    m_labels.emplace(address, name);
+}
+
+void SymbolTable::addLine(uint16_t address, size_t line)
+{
+    m_lines[address] = line;
+}
+
+std::optional<std::pair<std::string, uint16_t>> SymbolTable::findLabel(uint16_t address) const
+{
+    std::map<uint16_t, std::string>::const_iterator it = m_labels.upper_bound(address);
+    if (it == m_labels.begin())
+    {
+        return {};
+    }
+    it--;
+    return std::make_pair(it->second, address - it->first);
+}
+
+std::optional<size_t> SymbolTable::findLine(uint16_t address) const
+{
+    std::map<uint16_t, size_t>::const_iterator it = m_lines.upper_bound(address);
+    if (it == m_lines.begin())
+    {
+        return {};
+    }
+    return std::prev(it)->second;
+}
+
+std::string SymbolTable::describe(uint16_t address) const
+{
+    std::stringstream result;
+    std::optional<std::pair<std::string, uint16_t>> label = findLabel(address);
+    if (label.has_value())
+    {
+        result << label.value().first;
+        if (label.value().second != 0)
+        {
+            result << "+0x" << std::hex << label.value().second << std::dec;
+        }
+    }
+    else
+    {
+        result << "0x" << std::hex << std::setw(3) << std::setfill('0') << address << std::dec;
+    }
+    if (std::optional<size_t> line = findLine(address); line.has_value())
+    {
+        result << " (" << (m_sourceName.empty() ? "?" : m_sourceName) << ":" << line.value() << ")";
+    }
+    return result.str();
+}
+
+void SymbolTable::save(std::ostream &stream) const
+{
+    stream << SymbolFileMagic << " " << SymbolFileVersion << "\n";
+    stream << "file " << m_sourceName << "\n";
+    stream << std::hex << std::setfill('0');
+    for (std::pair<const uint16_t, std::string> const &label : m_labels)
+    {
+        stream << "label 0x" << std::setw(3) << label.first << " " << label.second << "\n";
+    }
+    for (std::pair<const uint16_t, size_t> const &line : m_lines)
+    {
+        stream << "line 0x" << std::setw(3) << line.first << " " << std::dec << line.second << std::hex << "\n";
+    }
+    stream << std::dec;
+}
+
+std::optional<SymbolTable> SymbolTable::load(std::istream &stream)
+{
+    std::string magic;
+    int version = 0;
+    if (!(stream >> magic >> version) || magic != SymbolFileMagic || version != SymbolFileVersion)
+    {
+        return {};
+    }
+    SymbolTable table;
+    std::string kind;
+    while (stream >> kind)
+    {
+        if (kind == "file")
+        {
+            stream >> std::ws;
+            std::getline(stream, table.m_sourceName);
+            continue;
+        }
+        std::string addressText;
+        if (!(stream >> addressText))
+        {
+            return {};
+        }
+        uint16_t address = 0;
+        try
+        {
+            address = std::stoul(addressText, nullptr, 16);
+        }
+        catch (std::exception const &e)
+        {
+            return {};
+        }
+        if (kind == "label")
+        {
+            std::string name;
+            stream >> name;
+            table.addLabel(address, name);
+        }
+        else if (kind == "line")
+        {
+            size_t line = 0;
+            stream >> line;
+            table.addLine(address, line);
+        }
+        else
+        {
+            return {};
+        }
+        if (stream.fail())
+        {
+            return {};
+        }
+    }
+    return table;
+}
+
+std::optional<SymbolTable> SymbolTable::loadFromFile(std::string const &filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        return {};
+    }
+    return load(file);
+}
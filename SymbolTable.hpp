@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <istream>
+#include <ostream>
+
+/**
+ * @brief Maps addresses of the program to labels and lines of the source file it was assembled from.
+ * Stored as a small text file next to the binary:
+ * @code
+ * gob8sym 1
+ * file game.asm
+ * label 0x000 start
+ * line 0x000 12
+ * @endcode
+ * Line entries are only written for addresses where the line changes
+ */
+class SymbolTable
+{
+public:
+    void setSourceName(std::string const &name) { m_sourceName = name; }
+    std::string const &getSourceName() const { return m_sourceName; }
+
+    /**
+     * @brief Add label at the given address. If address already has a label the first one is kept
+     *
+     * @param address Address of the label
+     * @param name Name of the label
+     */
+    void addLabel(uint16_t address, std::string const &name);
+
+    /**
+     * @brief Mark that code starting at the address comes from the given line
+     *
+     * @param address Address of the first byte produced by the line
+     * @param line Line number starting from 1
+     */
+    void addLine(uint16_t address, size_t line);
+
+    /**
+     * @brief Find the closest label at or before the address
+     *
+     * @param address Address to look up
+     * @return std::optional<std::pair<std::string, uint16_t>> Name of the label and offset from it or empty value if there is none
+     */
+    std::optional<std::pair<std::string, uint16_t>> findLabel(uint16_t address) const;
+
+    /**
+     * @brief Find line of the source file the address was assembled from
+     *
+     * @param address Address to look up
+     * @return std::optional<size_t> Line number starting from 1
+     */
+    std::optional<size_t> findLine(uint16_t address) const;
+
+    /**
+     * @brief Get readable name of the address in the `label+0x6 (game.asm:142)` form, falls back to the raw address if nothing is known
+     *
+     * @param address Address to describe
+     * @return std::string
+     */
+    std::string describe(uint16_t address) const;
+
+    bool empty() const { return m_labels.empty() && m_lines.empty(); }
+
+    void save(std::ostream &stream) const;
+
+    /**
+     * @brief Load the table from the stream
+     *
+     * @param stream Stream to read from
+     * @return std::optional<SymbolTable> Loaded table or empty value if the data is not a valid symbol table
+     */
+    static std::optional<SymbolTable> load(std::istream &stream);
+
+    /**
+     * @brief Load the table from the file
+     *
+     * @param filename Path to the file
+     * @return std::optional<SymbolTable> Loaded table or empty value if the file can't be read or is not a valid symbol table
+     */
+    static std::optional<SymbolTable> loadFromFile(std::string const &filename);
+
+private:
+    std::string m_sourceName;
+    std::map<uint16_t, std::string> m_labels;
+    std::map<uint16_t, size_t> m_lines;
+};
@@ -0,0 +1,124 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+/// @brief Every thread gets about this many chunks of a loop, more chunks even out items that take longer than others
+static const size_t ChunksPerThread = 4;
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 1; i < threadCount; i++)
+    {
+        m_workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_started.notify_all();
+    for (std::thread &worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, std::function<void(size_t)> const &function)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (m_workers.empty() || count == 1)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            function(i);
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_function = &function;
+        m_count = count;
+        m_chunkSize = std::max<size_t>(1, count / (getThreadCount() * ChunksPerThread));
+        m_next = 0;
+        m_error = nullptr;
+        m_running = m_workers.size();
+        m_generation++;
+    }
+    m_started.notify_all();
+    runChunks();
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_finished.wait(lock, [this]()
+                        { return m_running == 0; });
+        m_function = nullptr;
+        error = m_error;
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::work()
+{
+    size_t generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_started.wait(lock, [&]()
+                           { return m_stopping || m_generation != generation; });
+            if (m_stopping)
+            {
+                return;
+            }
+            generation = m_generation;
+        }
+        runChunks();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running--;
+        }
+        m_finished.notify_one();
+    }
+}
+
+void ThreadPool::runChunks()
+{
+    while (true)
+    {
+        const size_t begin = m_next.fetch_add(m_chunkSize);
+        if (begin >= m_count)
+        {
+            return;
+        }
+        const size_t end = std::min(begin + m_chunkSize, m_count);
+        try
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                (*m_function)(i);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_error)
+            {
+                m_error = std::current_exception();
+            }
+            // nothing else is started once a call failed
+            m_next = m_count;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed set of worker threads that split loops over many independent items between them.
+ * Threads are started once and sleep between loops, the calling thread works on the loop as well
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief Start the workers
+     *
+     * @param threadCount Total number of threads working on a loop including the caller, 0 uses one per hardware thread
+     */
+    explicit ThreadPool(size_t threadCount = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool &operator=(ThreadPool const &) = delete;
+
+    /**
+     * @brief Call the function for every index in [0, count) and wait for all of them to finish.
+     * Indices are handed out in chunks so that threads don't fight over every single item.
+     * If any call throws, the remaining chunks are skipped and the first exception is rethrown
+     *
+     * @param count Number of items
+     * @param function Function called with the index of the item
+     */
+    void parallelFor(size_t count, std::function<void(size_t)> const &function);
+
+    size_t getThreadCount() const { return m_workers.size() + 1; }
+
+private:
+    void work();
+
+    /// @brief Take chunks of the current loop until none are left
+    void runChunks();
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_started;
+    std::condition_variable m_finished;
+    /// @brief Increased for every loop so that sleeping workers know there is a new one
+    size_t m_generation = 0;
+    /// @brief Number of workers that have not finished the current loop yet
+    size_t m_running = 0;
+    bool m_stopping = false;
+
+    std::function<void(size_t)> const *m_function = nullptr;
+    size_t m_count = 0;
+    size_t m_chunkSize = 1;
+    std::atomic<size_t> m_next = 0;
+    std::exception_ptr m_error;
+};
@@ -0,0 +1,240 @@
+#include "TiledDisplaySDL.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const int VideoWidth = 64;
+static const int VideoHeight = 32;
+
+static const char *WindowTitle = "Gob-8";
+
+/// @brief Width of the frame around every tile, drawn in the focus color around the focused tile
+static const int TileBorder = 2;
+
+/// @brief Window size used to pick the scale when the size of the display is not known
+static const int DefaultDisplayWidth = 1280;
+static const int DefaultDisplayHeight = 720;
+
+/// @brief Above this many dirty tiles the whole window is updated instead of a long list of rectangles
+static const size_t MaxDirtyRects = 256;
+
+TiledDisplaySDL::TiledDisplaySDL(size_t tileCount, int columns, int scale) : m_tiles(tileCount)
+{
+    if (tileCount == 0)
+    {
+        throw DisplayError("No tiles to display");
+    }
+    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    {
+        throw DisplayError(std::string("Failed to init sdl. Error: ") + SDL_GetError());
+    }
+    // a tile is twice as wide as it is high, so half as many columns as rows make the grid square
+    m_columns = columns > 0 ? columns : std::max(1, (int)std::ceil(std::sqrt(tileCount / 2.0)));
+    m_columns = std::min<int>(m_columns, tileCount);
+    m_rows = (tileCount + m_columns - 1) / m_columns;
+    if (scale > 0)
+    {
+        m_scale = scale;
+    }
+    else
+    {
+        SDL_DisplayMode mode;
+        int displayWidth = DefaultDisplayWidth;
+        int displayHeight = DefaultDisplayHeight;
+        if (SDL_GetCurrentDisplayMode(0, &mode) == 0)
+        {
+            // leave room for the window decorations and task bars
+            displayWidth = mode.w * 9 / 10;
+            displayHeight = mode.h * 9 / 10;
+        }
+        m_scale = std::max(1, std::min((displayWidth / m_columns - 2 * TileBorder) / VideoWidth, (displayHeight / m_rows - 2 * TileBorder) / VideoHeight));
+    }
+    const int tileWidth = VideoWidth * m_scale + 2 * TileBorder;
+    const int tileHeight = VideoHeight * m_scale + 2 * TileBorder;
+    m_window = SDL_CreateWindow(WindowTitle, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, tileWidth * m_columns, tileHeight * m_rows, SDL_WINDOW_SHOWN);
+    if (m_window == nullptr)
+    {
+        throw DisplayError(std::string("Failed to create window. Error:") + SDL_GetError());
+    }
+    m_windowSurface = SDL_GetWindowSurface(m_window);
+    if (m_windowSurface == nullptr)
+    {
+        throw DisplayError(std::string("Failed to get window surface. Error:") + SDL_GetError());
+    }
+    // tiles are written straight into the window surface, converting formats for hundreds of them would not keep up
+    if (m_windowSurface->format->BytesPerPixel != 4)
+    {
+        throw DisplayError("Window surface has to use 32 bits per pixel");
+    }
+    m_backgroundColor = SDL_MapRGB(m_windowSurface->format, 0, 0, 0);
+    m_foregroundColor = SDL_MapRGB(m_windowSurface->format, 255, 255, 255);
+    m_focusColor = SDL_MapRGB(m_windowSurface->format, 230, 200, 50);
+    m_scaledRow.resize(VideoWidth * m_scale);
+    SDL_FillRect(m_windowSurface, nullptr, m_backgroundColor);
+
+    m_dirtyTiles.reserve(tileCount);
+    m_dirtyRects.reserve(std::min(tileCount, MaxDirtyRects));
+    for (size_t i = 0; i < tileCount; i++)
+    {
+        m_dirtyTiles.push_back(i);
+    }
+}
+
+TiledDisplaySDL::~TiledDisplaySDL()
+{
+    SDL_DestroyWindow(m_window);
+    SDL_Quit();
+}
+
+void TiledDisplaySDL::update(size_t tile, VideoMemoryType const &videoData)
+{
+    Tile &target = m_tiles[tile];
+    if (target.videoChanged || std::memcmp(target.video.data(), videoData.data(), videoData.size()) != 0)
+    {
+        markDirty(tile);
+        target.video = videoData;
+        target.videoChanged = true;
+    }
+}
+
+void TiledDisplaySDL::setFocus(std::optional<size_t> tile)
+{
+    if (tile == m_focus)
+    {
+        return;
+    }
+    for (std::optional<size_t> changed : {m_focus, tile})
+    {
+        if (changed.has_value())
+        {
+            markDirty(changed.value());
+            m_tiles[changed.value()].borderChanged = true;
+        }
+    }
+    m_focus = tile;
+}
+
+void TiledDisplaySDL::markDirty(size_t tile)
+{
+    if (!m_tiles[tile].videoChanged && !m_tiles[tile].borderChanged)
+    {
+        m_dirtyTiles.push_back(tile);
+    }
+}
+
+std::optional<size_t> TiledDisplaySDL::getTileAt(int x, int y) const
+{
+    const int tileWidth = VideoWidth * m_scale + 2 * TileBorder;
+    const int tileHeight = VideoHeight * m_scale + 2 * TileBorder;
+    if (x < 0 || y < 0 || x >= tileWidth * m_columns || y >= tileHeight * m_rows)
+    {
+        return {};
+    }
+    const size_t tile = (y / tileHeight) * m_columns + x / tileWidth;
+    if (tile >= m_tiles.size())
+    {
+        return {};
+    }
+    return tile;
+}
+
+SDL_Rect TiledDisplaySDL::getTileRect(size_t tile) const
+{
+    const int tileWidth = VideoWidth * m_scale + 2 * TileBorder;
+    const int tileHeight = VideoHeight * m_scale + 2 * TileBorder;
+    return {(int)(tile % m_columns) * tileWidth, (int)(tile / m_columns) * tileHeight, tileWidth, tileHeight};
+}
+
+void TiledDisplaySDL::render()
+{
+    m_drawnTileCount = m_dirtyTiles.size();
+    if (m_dirtyTiles.empty())
+    {
+        return;
+    }
+    SDL_LockSurface(m_windowSurface);
+    for (size_t tile : m_dirtyTiles)
+    {
+        if (m_tiles[tile].videoChanged)
+        {
+            drawVideo(tile);
+        }
+        m_tiles[tile].videoChanged = false;
+    }
+    SDL_UnlockSurface(m_windowSurface);
+    // borders are filled rectangles, which needs the surface unlocked
+    for (size_t tile : m_dirtyTiles)
+    {
+        if (m_tiles[tile].borderChanged)
+        {
+            drawBorder(tile);
+        }
+        m_tiles[tile].borderChanged = false;
+    }
+    if (m_dirtyTiles.size() > MaxDirtyRects)
+    {
+        SDL_UpdateWindowSurface(m_window);
+    }
+    else
+    {
+        m_dirtyRects.clear();
+        for (size_t tile : m_dirtyTiles)
+        {
+            m_dirtyRects.push_back(getTileRect(tile));
+        }
+        SDL_UpdateWindowSurfaceRects(m_window, m_dirtyRects.data(), (int)m_dirtyRects.size());
+    }
+    m_dirtyTiles.clear();
+}
+
+void TiledDisplaySDL::drawVideo(size_t tile)
+{
+    const SDL_Rect rect = getTileRect(tile);
+    VideoMemoryType const &video = m_tiles[tile].video;
+    uint8_t *pixels = (uint8_t *)m_windowSurface->pixels + (rect.y + TileBorder) * m_windowSurface->pitch + (rect.x + TileBorder) * sizeof(uint32_t);
+    const size_t rowSize = m_scaledRow.size() * sizeof(uint32_t);
+    for (int y = 0; y < VideoHeight; y++)
+    {
+        uint32_t *row = m_scaledRow.data();
+        for (int x = 0; x < VideoWidth; x++)
+        {
+            std::fill_n(row, m_scale, video[y * VideoWidth + x] ? m_foregroundColor : m_backgroundColor);
+            row += m_scale;
+        }
+        for (int i = 0; i < m_scale; i++)
+        {
+            std::memcpy(pixels + (y * m_scale + i) * m_windowSurface->pitch, m_scaledRow.data(), rowSize);
+        }
+    }
+}
+
+void TiledDisplaySDL::drawBorder(size_t tile)
+{
+    const SDL_Rect rect = getTileRect(tile);
+    const uint32_t color = m_focus == tile ? m_focusColor : m_backgroundColor;
+    const SDL_Rect edges[] = {
+        {rect.x, rect.y, rect.w, TileBorder},
+        {rect.x, rect.y + rect.h - TileBorder, rect.w, TileBorder},
+        {rect.x, rect.y + TileBorder, TileBorder, rect.h - 2 * TileBorder},
+        {rect.x + rect.w - TileBorder, rect.y + TileBorder, TileBorder, rect.h - 2 * TileBorder},
+    };
+    for (SDL_Rect const &edge : edges)
+    {
+        SDL_FillRect(m_windowSurface, &edge, color);
+    }
+}
+
+void TiledDisplaySDL::setTitle(std::string const &text)
+{
+    SDL_SetWindowTitle(m_window, (std::string(WindowTitle) + " | " + text).c_str());
+}
+
+int TiledDisplaySDL::getRefreshRate() const
+{
+    SDL_DisplayMode mode;
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(m_window), &mode) != 0 || mode.refresh_rate <= 0)
+    {
+        return 60;
+    }
+    return mode.refresh_rate;
+}
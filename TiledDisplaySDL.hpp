@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <optional>
+#include <vector>
+#include "Display.hpp"
+
+/**
+ * @brief Single SDL window showing the video of many machines as a grid of tiles.
+ * Every tile keeps a copy of the last video it was given, only tiles whose video or focus changed are drawn again
+ * and only their rectangles are sent to the window, with one window update per rendered frame
+ */
+class TiledDisplaySDL
+{
+public:
+    using VideoMemoryType = std::array<uint8_t, TOTAL_VIDEO_MEMORY_SIZE>;
+
+    /**
+     * @param tileCount Number of tiles
+     * @param columns Tiles per row, 0 picks a count that makes the grid roughly square
+     * @param scale Size of a video pixel in window pixels, 0 picks the largest that fits the window into the display
+     */
+    explicit TiledDisplaySDL(size_t tileCount, int columns = 0, int scale = 0);
+
+    TiledDisplaySDL(TiledDisplaySDL const &) = delete;
+    TiledDisplaySDL &operator=(TiledDisplaySDL const &) = delete;
+
+    ~TiledDisplaySDL();
+
+    /// @brief Give the tile new video, the tile is only drawn again if it differs from the previous one
+    void update(size_t tile, VideoMemoryType const &videoData);
+
+    /// @brief Draw the changed tiles and present them in one window update
+    void render();
+
+    /// @brief Highlight the tile with a border, empty value removes the highlight
+    void setFocus(std::optional<size_t> tile);
+
+    std::optional<size_t> getFocus() const { return m_focus; }
+
+    /// @brief Get the tile under a point in window coordinates, empty value if the point is between tiles or outside the grid
+    std::optional<size_t> getTileAt(int x, int y) const;
+
+    size_t getTileCount() const { return m_tiles.size(); }
+
+    /// @brief Number of tiles drawn by the last render
+    size_t getDrawnTileCount() const { return m_drawnTileCount; }
+
+    void setTitle(std::string const &text);
+
+    /// @brief Get refresh rate of the display the window is on, 60 if it is not known
+    int getRefreshRate() const;
+
+private:
+    struct Tile
+    {
+        VideoMemoryType video = {};
+        bool videoChanged = true;
+        bool borderChanged = true;
+    };
+
+    /// @brief Remember the tile for the next render, once
+    void markDirty(size_t tile);
+
+    SDL_Rect getTileRect(size_t tile) const;
+
+    void drawVideo(size_t tile);
+
+    void drawBorder(size_t tile);
+
+    SDL_Window *m_window = nullptr;
+    SDL_Surface *m_windowSurface = nullptr;
+    int m_columns;
+    int m_rows;
+    int m_scale;
+    std::vector<Tile> m_tiles;
+    /// @brief Tiles to draw on the next render, each at most once
+    std::vector<size_t> m_dirtyTiles;
+    std::vector<SDL_Rect> m_dirtyRects;
+    std::optional<size_t> m_focus;
+    size_t m_drawnTileCount = 0;
+    uint32_t m_backgroundColor;
+    uint32_t m_foregroundColor;
+    uint32_t m_focusColor;
+    /// @brief Single scaled row which is then copied into the window surface as many times as the scale is
+    std::vector<uint32_t> m_scaledRow;
+};
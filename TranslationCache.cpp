@@ -0,0 +1,157 @@
+#include "TranslationCache.hpp"
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+
+#include <dlfcn.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Recompiler.hpp"
+
+#ifndef GOB8_CXX_COMPILER
+#define GOB8_CXX_COMPILER "c++"
+#endif
+#ifndef GOB8_TRANSLATION_INCLUDES
+#define GOB8_TRANSLATION_INCLUDES ""
+#endif
+
+// definitions the modules are compiled with have to match the ones of the executable
+#define STRINGIFY_VALUE(value) #value
+#define STRINGIFY(value) STRINGIFY_VALUE(value)
+
+extern char **environ;
+
+TranslationCache::TranslationCache(std::string const &directory) : m_directory(directory)
+{
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (error)
+    {
+        throw TranslationCacheError("Unable to create cache directory " + m_directory + ": " + error.message());
+    }
+}
+
+std::string TranslationCache::getModulePath(std::span<const uint8_t> program) const
+{
+    // size of the machine catches most layout changes that someone forgot to bump the version for
+    uint64_t key = StateHash::combine(StateHash::hashBytes(program), program.size());
+    key = StateHash::combine(key, Version);
+    key = StateHash::combine(key, sizeof(Machine));
+    std::stringstream name;
+    name << std::hex << std::setfill('0') << std::setw(16) << key << ".so";
+    return (std::filesystem::path(m_directory) / name.str()).string();
+}
+
+CompiledProgram const *TranslationCache::find(std::span<const uint8_t> program)
+{
+    if (CompiledProgram const *compiled = CompiledProgram::find(program); compiled != nullptr)
+    {
+        return compiled;
+    }
+    const std::string path = getModulePath(program);
+    if (!std::filesystem::exists(path))
+    {
+        return nullptr;
+    }
+    return load(path, program);
+}
+
+CompiledProgram const *TranslationCache::translate(std::span<const uint8_t> program, std::string const &name)
+{
+    if (CompiledProgram const *compiled = find(program); compiled != nullptr)
+    {
+        return compiled;
+    }
+    const std::string path = getModulePath(program);
+    // files of this process only, the module appears under its real name once it is complete
+    const std::string module = path + "." + std::to_string(getpid());
+    const std::string source = module + ".cpp";
+    {
+        std::ofstream stream(source);
+        if (!stream.is_open())
+        {
+            throw TranslationCacheError("Unable to create " + source);
+        }
+        Recompiler recompiler;
+        recompiler.generate(program, name, stream);
+    }
+    try
+    {
+        compile(source, module);
+    }
+    catch (TranslationCacheError const &)
+    {
+        std::filesystem::remove(source);
+        throw;
+    }
+    std::filesystem::remove(source);
+    std::error_code error;
+    std::filesystem::rename(module, path, error);
+    if (error)
+    {
+        std::filesystem::remove(module);
+        throw TranslationCacheError("Unable to move module into " + path + ": " + error.message());
+    }
+    CompiledProgram const *compiled = load(path, program);
+    if (compiled == nullptr)
+    {
+        const char *reason = dlerror();
+        throw TranslationCacheError("Unable to load " + path + ": " + (reason != nullptr ? reason : "module does not contain the program"));
+    }
+    return compiled;
+}
+
+CompiledProgram const *TranslationCache::load(std::string const &path, std::span<const uint8_t> program) const
+{
+    // generated code registers its program while the module is loaded, the handle is never closed since the program stays registered
+    if (dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL) == nullptr)
+    {
+        return nullptr;
+    }
+    return CompiledProgram::find(program);
+}
+
+void TranslationCache::compile(std::string const &source, std::string const &module) const
+{
+    std::vector<std::string> arguments = {
+        GOB8_CXX_COMPILER, "-std=c++20", "-O3", "-fPIC", "-shared",
+        "-DTOTAL_VIDEO_MEMORY_SIZE=" STRINGIFY(TOTAL_VIDEO_MEMORY_SIZE),
+        "-DTOTAL_MEMORY_SIZE=" STRINGIFY(TOTAL_MEMORY_SIZE)};
+    std::stringstream includes(GOB8_TRANSLATION_INCLUDES);
+    for (std::string directory; std::getline(includes, directory, ':');)
+    {
+        if (!directory.empty())
+        {
+            arguments.push_back("-I" + directory);
+        }
+    }
+    arguments.insert(arguments.end(), {source, "-o", module});
+
+    std::vector<char *> argv;
+    for (std::string &argument : arguments)
+    {
+        argv.push_back(argument.data());
+    }
+    argv.push_back(nullptr);
+    pid_t pid;
+    const int error = posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ);
+    if (error != 0)
+    {
+        throw TranslationCacheError("Unable to run " + arguments[0] + ": " + std::strerror(error));
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        std::filesystem::remove(module);
+        throw TranslationCacheError("Compiling " + source + " failed");
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include "CompiledProgram.hpp"
+
+/**
+ * @brief Exception class for errors in creating the cache or translating programs into it
+ *
+ */
+class TranslationCacheError : public std::runtime_error
+{
+public:
+    explicit TranslationCacheError(std::string const &msg) : std::runtime_error(msg) {}
+};
+
+/**
+ * @brief Native code for programs that were not linked into the executable, kept on disk between runs.
+ * The first run of a program translates it with the recompiler and compiles the source into a shared module named after
+ * the hash of the program, every later run maps the module and registers its CompiledProgram without any analysis or compiling.
+ *
+ * Modules are linked against the executable that loads them, so it has to export its symbols(ENABLE_EXPORTS).
+ * Loaded modules stay loaded until the process exits. Several processes can share one directory, each of them compiles
+ * into a file of its own and renames it into place once it is complete
+ */
+class TranslationCache
+{
+public:
+    /// @brief Bump whenever the generated code or the layout of Machine changes, modules of other versions are never loaded
+    static const uint32_t Version = 1;
+
+    /**
+     * @brief Use the directory for modules, creating it if it does not exist
+     *
+     * @param directory Directory that holds the modules
+     */
+    explicit TranslationCache(std::string const &directory);
+
+    /**
+     * @brief Find native code for the program, either linked into the executable or previously translated into the cache
+     *
+     * @param program Bytes of the program
+     * @return CompiledProgram const* Native code or nullptr if there is none yet
+     */
+    CompiledProgram const *find(std::span<const uint8_t> program);
+
+    /**
+     * @brief Find native code for the program, translating it into the cache if there is none. Compiling takes a few seconds
+     *
+     * @param program Bytes of the program
+     * @param name Name the program is registered with
+     * @return CompiledProgram const* Native code
+     */
+    CompiledProgram const *translate(std::span<const uint8_t> program, std::string const &name);
+
+    /// @brief Path of the module for the program, the name is the hash of the program and the version
+    std::string getModulePath(std::span<const uint8_t> program) const;
+
+private:
+    /// @brief Map the module and look up the program it registered, nullptr if the module can't be loaded
+    CompiledProgram const *load(std::string const &path, std::span<const uint8_t> program) const;
+
+    /// @brief Run the compiler on the generated source
+    void compile(std::string const &source, std::string const &module) const;
+
+    std::string m_directory;
+};
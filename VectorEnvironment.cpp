@@ -0,0 +1,104 @@
+#include "VectorEnvironment.hpp"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include "VideoCapture.hpp"
+
+VectorEnvironment::VectorEnvironment(std::span<const uint8_t> program, Config const &config)
+    : m_config(config), m_image(PagedMemory::createImage(program)), m_pool(config.threadCount)
+{
+    if (m_config.environmentCount == 0)
+    {
+        throw EnvironmentError("Environment count must be at least 1");
+    }
+    if (program.size() > TOTAL_MEMORY_SIZE)
+    {
+        throw EnvironmentError("Program of " + std::to_string(program.size()) + " bytes does not fit into memory");
+    }
+    m_arena.reset(::operator new(sizeof(Machine) * m_config.environmentCount, std::align_val_t(ObservationAlignment)));
+    m_machines = static_cast<Machine *>(m_arena.get());
+    for (size_t i = 0; i < m_config.environmentCount; i++)
+    {
+        new (m_machines + i) Machine(m_image);
+    }
+    // round rows up so that every observation starts at the alignment
+    m_observationStride = (getObservationSize() + ObservationAlignment - 1) / ObservationAlignment * ObservationAlignment;
+    const size_t observationsSize = m_observationStride * m_config.environmentCount;
+    m_observations.reset(static_cast<uint8_t *>(::operator new(observationsSize, std::align_val_t(ObservationAlignment))));
+    std::memset(m_observations.get(), 0, observationsSize);
+    m_halted.resize(m_config.environmentCount, 0);
+}
+
+VectorEnvironment::~VectorEnvironment()
+{
+    for (size_t i = 0; i < m_config.environmentCount; i++)
+    {
+        m_machines[i].~Machine();
+    }
+}
+
+void VectorEnvironment::reset(std::span<const uint32_t> environments)
+{
+    for (uint32_t environment : environments)
+    {
+        if (environment >= m_config.environmentCount)
+        {
+            throw EnvironmentError("Environment " + std::to_string(environment) + " does not exist, there are " + std::to_string(m_config.environmentCount));
+        }
+    }
+    if (environments.empty())
+    {
+        m_pool.parallelFor(m_config.environmentCount, [this](size_t i)
+                           { resetEnvironment(i); });
+    }
+    else
+    {
+        m_pool.parallelFor(environments.size(), [this, environments](size_t i)
+                           { resetEnvironment(environments[i]); });
+    }
+}
+
+void VectorEnvironment::step(std::span<const uint16_t> actions)
+{
+    if (actions.size() != m_config.environmentCount)
+    {
+        throw EnvironmentError("Expected " + std::to_string(m_config.environmentCount) + " actions, got " + std::to_string(actions.size()));
+    }
+    m_pool.parallelFor(m_config.environmentCount, [this, actions](size_t i)
+                       { stepEnvironment(i, actions[i]); });
+}
+
+void VectorEnvironment::resetEnvironment(size_t environment)
+{
+    m_machines[environment].reset();
+    m_halted[environment] = 0;
+    publishObservation(environment);
+}
+
+void VectorEnvironment::stepEnvironment(size_t environment, uint16_t action)
+{
+    Machine &machine = m_machines[environment];
+    machine.setKeyStates(action);
+    for (size_t frame = 0; frame < m_config.framesPerStep && !machine.isHalted(); frame++)
+    {
+        if (machine.beginFrame(action))
+        {
+            machine.run(m_config.instructionsPerFrame);
+        }
+    }
+    m_halted[environment] = machine.isHalted();
+    publishObservation(environment);
+}
+
+void VectorEnvironment::publishObservation(size_t environment)
+{
+    const Machine::VideoMemoryType &frame = m_machines[environment].getCurrentVideoMemory();
+    uint8_t *observation = m_observations.get() + environment * m_observationStride;
+    if (!m_config.packedObservations)
+    {
+        std::memcpy(observation, frame.data(), frame.size());
+        return;
+    }
+    VideoCapture::packFrame(frame, std::span<uint8_t, TOTAL_VIDEO_MEMORY_SIZE / 8>(observation, TOTAL_VIDEO_MEMORY_SIZE / 8));
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Machine.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ * @brief Exception class for invalid use of the vector environment
+ *
+ */
+class EnvironmentError : public std::runtime_error
+{
+public:
+    explicit EnvironmentError(std::string const &msg) : std::runtime_error(msg) {}
+};
+
+/**
+ * @brief Many machines running the same program that are reset and stepped as one batch, meant for driving the emulator from a training loop.
+ * Machines are kept one after another in a single aligned block of memory and share the program image, so they only own their stack pages
+ * and framebuffers. Every step runs a fixed number of frames on each machine, split between the threads of a pool.
+ *
+ * Observations of all machines are one contiguous tensor of shape [environment][32][64] with one byte per pixel,
+ * or [environment][32][8] with eight pixels per byte when packed (lowest bit is the leftmost pixel). Rows of the tensor start at
+ * ObservationAlignment. Since the machine alternates between its two framebuffers, the worker that stepped a machine writes the displayed frame
+ * into its row while it is still in cache, the tensor itself is never copied and stays valid until the next step or reset
+ */
+class VectorEnvironment
+{
+public:
+    static constexpr size_t ObservationAlignment = 64;
+    static constexpr size_t Width = 64;
+    static constexpr size_t Height = 32;
+
+    struct Config
+    {
+        size_t environmentCount = 1;
+        /// @brief Frames executed by every step, a frame advances the timers once
+        size_t framesPerStep = 1;
+        /// @brief Instructions executed per frame, the emulator itself runs one
+        size_t instructionsPerFrame = 1;
+        /// @brief Threads used for stepping, 0 uses one per hardware thread
+        size_t threadCount = 0;
+        /// @brief Store eight pixels per byte instead of one
+        bool packedObservations = false;
+    };
+
+    /**
+     * @brief Create the machines, all of them start in the reset state
+     *
+     * @param program Bytes of the program every machine runs
+     * @param config Size of the batch and the way it is stepped
+     */
+    explicit VectorEnvironment(std::span<const uint8_t> program, Config const &config);
+
+    ~VectorEnvironment();
+
+    VectorEnvironment(VectorEnvironment const &) = delete;
+    VectorEnvironment &operator=(VectorEnvironment const &) = delete;
+
+    /**
+     * @brief Put the machines back into the state they were created in
+     *
+     * @param environments Indices of the machines to reset, empty resets all of them
+     */
+    void reset(std::span<const uint32_t> environments);
+
+    /**
+     * @brief Press the keys given by the actions and run every machine for the configured number of frames.
+     * Machine waiting for input receives the lowest pressed key. Random numbers come from the shared rand, see gob8_env_step
+     *
+     * @param actions One value per machine, bit N set means key N is held down for the whole step
+     */
+    void step(std::span<const uint16_t> actions);
+
+    size_t getEnvironmentCount() const { return m_config.environmentCount; }
+
+    Config const &getConfig() const { return m_config; }
+
+    /// @brief Start of the observation tensor
+    const uint8_t *getObservations() const { return m_observations.get(); }
+
+    /// @brief Distance in bytes between observations of two consecutive machines
+    size_t getObservationStride() const { return m_observationStride; }
+
+    /// @brief Number of bytes one observation takes inside of its row
+    size_t getObservationSize() const { return m_config.packedObservations ? Width * Height / 8 : Width * Height; }
+
+    /// @brief One byte per machine, 1 once the machine halted
+    const uint8_t *getHaltedFlags() const { return m_halted.data(); }
+
+    Machine &getMachine(size_t environment) { return m_machines[environment]; }
+
+private:
+    struct ArenaDelete
+    {
+        void operator()(void *memory) const { ::operator delete(memory, std::align_val_t(ObservationAlignment)); }
+    };
+
+    void resetEnvironment(size_t environment);
+
+    void stepEnvironment(size_t environment, uint16_t action);
+
+    /// @brief Copy the displayed frame of the machine into its row of the observation tensor
+    void publishObservation(size_t environment);
+
+    Config m_config;
+    std::shared_ptr<const PagedMemory::Image> m_image;
+    /// @brief Block holding all of the machines
+    std::unique_ptr<void, ArenaDelete> m_arena;
+    Machine *m_machines = nullptr;
+    std::unique_ptr<uint8_t, ArenaDelete> m_observations;
+    size_t m_observationStride;
+    std::vector<uint8_t> m_halted;
+    ThreadPool m_pool;
+};
@@ -0,0 +1,181 @@
+#include "VideoCapture.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+/// @brief Number of frames the queue can hold before frames are dropped, about 4 MB
+static const size_t QueueCapacity = 1 << 14;
+
+/// @brief How long the writer sleeps when there is nothing to write
+static const std::chrono::milliseconds WriterIdleTime(2);
+
+static void writeWord(std::ostream &stream, uint16_t value)
+{
+    const char bytes[2] = {(char)(value & 0xff), (char)(value >> 8)};
+    stream.write(bytes, 2);
+}
+
+static bool readWord(std::istream &stream, uint16_t &value)
+{
+    uint8_t bytes[2];
+    if (!stream.read((char *)bytes, 2))
+    {
+        return false;
+    }
+    value = bytes[0] | (bytes[1] << 8);
+    return true;
+}
+
+VideoRecorder::VideoRecorder(std::string const &filename, uint16_t framesPerSecond) : m_file(filename, std::ios::binary), m_queue(QueueCapacity)
+{
+    if (!m_file.is_open())
+    {
+        throw CaptureError("Unable to open capture file " + filename);
+    }
+    m_file.write(VideoCapture::Magic, std::strlen(VideoCapture::Magic));
+    writeWord(m_file, VideoCapture::Width);
+    writeWord(m_file, VideoCapture::Height);
+    writeWord(m_file, framesPerSecond);
+    std::fill(m_previousFrame.begin(), m_previousFrame.end(), 0);
+    m_writer = std::thread(&VideoRecorder::writeFrames, this);
+}
+
+VideoRecorder::~VideoRecorder()
+{
+    stop();
+}
+
+void VideoRecorder::pushFrame(VideoCapture::FrameType const &frame)
+{
+    const size_t writeCount = m_writeCount.load(std::memory_order_relaxed);
+    if (writeCount - m_readCount.load(std::memory_order_acquire) >= m_queue.size())
+    {
+        // the previous frame stays the same so the next frame in the file is still encoded against the right one
+        m_droppedFrameCount++;
+        return;
+    }
+    VideoCapture::PackedFrameType &slot = m_queue[writeCount % m_queue.size()];
+    VideoCapture::packFrame(frame, slot);
+    for (size_t i = 0; i < slot.size(); i++)
+    {
+        const uint8_t packed = slot[i];
+        slot[i] = packed ^ m_previousFrame[i];
+        m_previousFrame[i] = packed;
+    }
+    m_frameCount++;
+    m_writeCount.store(writeCount + 1, std::memory_order_release);
+}
+
+void VideoRecorder::stop()
+{
+    if (!m_writer.joinable())
+    {
+        return;
+    }
+    m_stopping.store(true, std::memory_order_release);
+    m_writer.join();
+    m_file.close();
+}
+
+void VideoRecorder::writeFrames()
+{
+    std::vector<uint8_t> payload;
+    while (true)
+    {
+        const size_t readCount = m_readCount.load(std::memory_order_relaxed);
+        if (readCount == m_writeCount.load(std::memory_order_acquire))
+        {
+            // frames are only pushed from the thread that stops the recorder, so nothing can arrive once it is stopping
+            if (m_stopping.load(std::memory_order_acquire) && readCount == m_writeCount.load(std::memory_order_acquire))
+            {
+                break;
+            }
+            std::this_thread::sleep_for(WriterIdleTime);
+            continue;
+        }
+        VideoCapture::PackedFrameType const &delta = m_queue[readCount % m_queue.size()];
+        payload.clear();
+        for (size_t i = 0; i < delta.size();)
+        {
+            size_t skip = 0;
+            while (i + skip < delta.size() && delta[i + skip] == 0 && skip < 255)
+            {
+                skip++;
+            }
+            if (i + skip == delta.size())
+            {
+                break;
+            }
+            size_t count = 0;
+            while (i + skip + count < delta.size() && delta[i + skip + count] != 0 && count < 255)
+            {
+                count++;
+            }
+            payload.push_back(skip);
+            payload.push_back(count);
+            payload.insert(payload.end(), delta.begin() + i + skip, delta.begin() + i + skip + count);
+            i += skip + count;
+        }
+        m_readCount.store(readCount + 1, std::memory_order_release);
+        writeWord(m_file, payload.size());
+        m_file.write((const char *)payload.data(), payload.size());
+    }
+    m_file.flush();
+}
+
+VideoReader::VideoReader(std::istream &stream) : m_stream(stream)
+{
+    char magic[sizeof(VideoCapture::Magic) - 1];
+    if (!m_stream.read(magic, sizeof(magic)) || std::memcmp(magic, VideoCapture::Magic, sizeof(magic)) != 0)
+    {
+        throw CaptureError("Not a capture file");
+    }
+    if (!readWord(m_stream, m_width) || !readWord(m_stream, m_height) || !readWord(m_stream, m_framesPerSecond))
+    {
+        throw CaptureError("Capture file header is incomplete");
+    }
+    if (m_width != VideoCapture::Width || m_height != VideoCapture::Height)
+    {
+        throw CaptureError("Unsupported frame size " + std::to_string(m_width) + "x" + std::to_string(m_height));
+    }
+    std::fill(m_frame.begin(), m_frame.end(), 0);
+}
+
+bool VideoReader::readFrame(VideoCapture::FrameType &frame)
+{
+    uint16_t size;
+    if (!readWord(m_stream, size))
+    {
+        return false;
+    }
+    m_payload.resize(size);
+    if (!m_stream.read((char *)m_payload.data(), size))
+    {
+        throw CaptureError("Capture file ends in the middle of a frame");
+    }
+    size_t position = 0;
+    for (size_t i = 0; i + 1 < m_payload.size();)
+    {
+        const uint8_t skip = m_payload[i];
+        const uint8_t count = m_payload[i + 1];
+        position += skip;
+        if (position + count > m_frame.size() || i + 2 + count > m_payload.size())
+        {
+            throw CaptureError("Capture file contains a broken frame");
+        }
+        for (size_t j = 0; j < count; j++)
+        {
+            m_frame[position + j] ^= m_payload[i + 2 + j];
+        }
+        position += count;
+        i += 2 + count;
+    }
+    for (size_t i = 0; i < m_frame.size(); i++)
+    {
+        for (size_t bit = 0; bit < 8; bit++)
+        {
+            frame[i * 8 + bit] = (m_frame[i] >> bit) & 1;
+        }
+    }
+    return true;
+}
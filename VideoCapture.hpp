@@ -0,0 +1,144 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <istream>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Capture files store frames of the video memory packed into bits and XORed with the previous frame, with runs of unchanged bytes skipped.
+ * @code
+ * header: "G8VIDEO1", u16 width, u16 height, u16 frames per second (all little endian)
+ * frame:  u16 payload size, payload
+ * payload: repeated (u8 unchanged bytes to skip, u8 changed bytes count, changed bytes XORed with the previous frame)
+ * @endcode
+ * Frame identical to the previous one is just two zero bytes
+ */
+namespace VideoCapture
+{
+    using FrameType = std::array<uint8_t, TOTAL_VIDEO_MEMORY_SIZE>;
+    using PackedFrameType = std::array<uint8_t, TOTAL_VIDEO_MEMORY_SIZE / 8>;
+
+    static const uint16_t Width = 64;
+    static const uint16_t Height = 32;
+    static const char Magic[] = "G8VIDEO1";
+
+    /// @brief Pack the frame into bits, eight pixels per byte with the lowest bit being the leftmost pixel
+    inline void packFrame(FrameType const &frame, std::span<uint8_t, TOTAL_VIDEO_MEMORY_SIZE / 8> packed)
+    {
+        for (size_t i = 0; i < packed.size(); i++)
+        {
+            uint8_t byte = 0;
+            for (size_t bit = 0; bit < 8; bit++)
+            {
+                byte |= (frame[i * 8 + bit] != 0) << bit;
+            }
+            packed[i] = byte;
+        }
+    }
+}
+
+/**
+ * @brief Exception class for errors related to reading or writing capture files
+ *
+ */
+class CaptureError : public std::exception
+{
+public:
+    const char *what() const throw() override { return m_message.c_str(); }
+    CaptureError(std::string const &msg) : m_message(msg) {}
+
+private:
+    std::string m_message;
+};
+
+/**
+ * @brief Records frames of the video memory into a capture file. Frames are packed on the calling thread and passed through
+ * a lock free queue to a writer thread which does the encoding and all of the file operations, so recording never waits for the disk.
+ * If the writer falls behind so far that the queue is full, frames are dropped instead
+ */
+class VideoRecorder
+{
+public:
+    /**
+     * @brief Open the capture file and start the writer thread
+     *
+     * @param filename Path to the capture file
+     * @param framesPerSecond Frame rate stored in the file for players
+     */
+    explicit VideoRecorder(std::string const &filename, uint16_t framesPerSecond);
+
+    ~VideoRecorder();
+
+    /**
+     * @brief Add frame to the recording, never blocks
+     *
+     * @param frame Video memory of the machine
+     */
+    void pushFrame(VideoCapture::FrameType const &frame);
+
+    /// @brief Write all queued frames and close the file
+    void stop();
+
+    size_t getFrameCount() const { return m_frameCount; }
+
+    /// @brief Number of frames that were lost because the queue was full
+    size_t getDroppedFrameCount() const { return m_droppedFrameCount; }
+
+private:
+    void writeFrames();
+
+    std::ofstream m_file;
+    /// @brief Ring buffer of frames XORed with the previous frame in the queue
+    std::vector<VideoCapture::PackedFrameType> m_queue;
+    /// @brief Total number of frames taken out of the queue, only written by the writer thread
+    std::atomic<size_t> m_readCount = 0;
+    /// @brief Total number of frames put into the queue, only written by the recording thread
+    std::atomic<size_t> m_writeCount = 0;
+    std::atomic<bool> m_stopping = false;
+    /// @brief Last frame put into the queue
+    VideoCapture::PackedFrameType m_previousFrame;
+    size_t m_frameCount = 0;
+    size_t m_droppedFrameCount = 0;
+    std::thread m_writer;
+};
+
+/**
+ * @brief Reads frames from a capture file
+ *
+ */
+class VideoReader
+{
+public:
+    /**
+     * @brief Read the header of the capture
+     *
+     * @param stream Stream opened in binary mode
+     */
+    explicit VideoReader(std::istream &stream);
+
+    /**
+     * @brief Read the next frame
+     *
+     * @param frame Frame to write pixels into, one byte per pixel with 0 or 1 same as in the video memory
+     * @return true If frame was read, false at the end of the capture
+     */
+    bool readFrame(VideoCapture::FrameType &frame);
+
+    uint16_t getWidth() const { return m_width; }
+    uint16_t getHeight() const { return m_height; }
+    uint16_t getFramesPerSecond() const { return m_framesPerSecond; }
+
+private:
+    std::istream &m_stream;
+    uint16_t m_width;
+    uint16_t m_height;
+    uint16_t m_framesPerSecond;
+    VideoCapture::PackedFrameType m_frame;
+    std::vector<uint8_t> m_payload;
+};
@@ -0,0 +1,334 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define GOB8_HAS_CYCLE_COUNTER 1
+#endif
+
+#include "Machine.hpp"
+
+/**
+ * @brief Timing of a single benchmark over all repetitions
+ *
+ */
+struct BenchmarkResult
+{
+    double nanosecondsMean;
+    /// @brief Half width of the 95% confidence interval of the mean
+    double nanosecondsConfidence;
+    double nanosecondsMedian;
+    double cyclesMean;
+};
+
+/**
+ * @brief Times handlers of the Machine in isolation, each benchmark runs a fixed mix of operands many times after a warmup
+ *
+ */
+class HandlerBenchmark
+{
+public:
+    explicit HandlerBenchmark(size_t repetitions, size_t operationsPerRepetition)
+        : m_repetitions(repetitions), m_operationsPerRepetition(operationsPerRepetition), m_random(8)
+    {
+    }
+
+    void runAll(std::string const &filter)
+    {
+        std::cout << std::left << std::setw(28) << "handler" << std::right << std::setw(12) << "ns/op" << std::setw(12) << "+-95%"
+                  << std::setw(12) << "median" << std::setw(14) << "cycles/op" << std::endl;
+        for (size_t height : {1, 4, 8, 16})
+        {
+            // sprites at the corner, in the middle and at the right edge where rows wrap
+            std::vector<uint16_t> opcodes;
+            for (uint16_t position : {0x01, 0x23, 0x45})
+            {
+                opcodes.push_back(0xD000 | (position << 4) | (height - 1));
+            }
+            run("opDraw height " + std::to_string(height), filter, opcodes, [](Machine &machine)
+                {
+                    machine.m_registers = {0, 0, 28, 12, 55, 16};
+                    machine.m_memoryRegister = 0x100; },
+                [](Machine &machine, uint16_t opcode)
+                { machine.opDraw(opcode); });
+        }
+        static const char *RegisterOperations[] = {"mov", "or", "and", "xor", "add", "sub", "ror", "subn", "rol"};
+        for (uint16_t operation = 0; operation <= 8; operation++)
+        {
+            run(std::string("opRegisterToRegister ") + RegisterOperations[operation], filter, randomOperands(0x8000 | operation), randomRegisters,
+                [](Machine &machine, uint16_t opcode)
+                { machine.opRegisterToRegister(opcode); });
+        }
+        for (uint16_t operation : {0x07, 0x15, 0x18, 0x1e})
+        {
+            char name[48];
+            std::snprintf(name, sizeof(name), "opSpecialFunctions FX%02X", operation);
+            run(name, filter, randomOperands(0xF000 | operation, false), randomRegisters,
+                [](Machine &machine, uint16_t opcode)
+                { machine.opSpecialFunctions(opcode); });
+        }
+        run("pushToStack + popFromStack", filter, randomOperands(0x2000), nullptr,
+            [](Machine &machine, uint16_t opcode)
+            {
+                machine.pushToStack(opcode);
+                machine.popFromStack(); });
+        for (uint16_t operation : {0x9e, 0xa1})
+        {
+            char name[48];
+            std::snprintf(name, sizeof(name), "handleKeyOpcodes EX%02X", operation);
+            run(name, filter, randomOperands(0xE000 | operation, false), [](Machine &machine)
+                {
+                    // key numbers have to stay inside of the key array, half of the keys are pressed
+                    for (size_t i = 0; i < 16; i++)
+                    {
+                        machine.m_registers[i] = i;
+                        machine.m_keystates[i] = i % 2;
+                    } },
+                [](Machine &machine, uint16_t opcode)
+                { machine.handleKeyOpcodes(opcode); });
+        }
+        // whole step including decoding, for comparison with the handlers alone. The opcodes are written to memory in the setup and
+        // executed in order, so that the timing does not include storing them
+        const std::vector<uint16_t> additions = randomOperands(0x7000);
+        run("step 7XNN", filter, additions, loadOpcodes(additions, nullptr), [end = additions.size() * 2](Machine &machine, uint16_t)
+            {
+                machine.step();
+                if (machine.m_programCounter >= end)
+                {
+                    machine.m_programCounter = 0;
+                } });
+        // mix of instructions that don't touch memory, decoded by the opcode table and by switches
+        std::vector<uint16_t> mix;
+        for (uint16_t base : {0x3000, 0x4000, 0x5000, 0x6000, 0x7000, 0x8000, 0x8001, 0x8004, 0x8005, 0x8006, 0xA000, 0xF007, 0xF01E})
+        {
+            std::vector<uint16_t> opcodes = randomOperands(base, (base & 0xf000) == 0x5000 || (base & 0xf000) == 0x8000);
+            mix.insert(mix.end(), opcodes.begin(), opcodes.begin() + 16);
+        }
+        std::shuffle(mix.begin(), mix.end(), m_random);
+        run("step mix", filter, mix, loadOpcodes(mix, randomRegisters), [end = mix.size() * 2](Machine &machine, uint16_t)
+            {
+                machine.step();
+                if (machine.m_programCounter >= end)
+                {
+                    machine.m_programCounter = 0;
+                } });
+        run("stepReference mix", filter, mix, loadOpcodes(mix, randomRegisters), [end = mix.size() * 2](Machine &machine, uint16_t)
+            {
+                machine.stepReference();
+                if (machine.m_programCounter >= end)
+                {
+                    machine.m_programCounter = 0;
+                } });
+    }
+
+private:
+    using SetupFunction = std::function<void(Machine &)>;
+
+    static void randomRegisters(Machine &machine)
+    {
+        std::mt19937 random(1);
+        for (uint8_t &reg : machine.m_registers)
+        {
+            reg = random();
+        }
+        machine.m_memoryRegister = 0;
+    }
+
+    /**
+     * @brief Create a setup that writes the opcodes to the start of the memory and points the program counter at them
+     *
+     * @param opcodes Opcodes executed by a step benchmark, skips can jump over some of them
+     * @param setup Setup to run before or nullptr
+     */
+    static SetupFunction loadOpcodes(std::vector<uint16_t> const &opcodes, SetupFunction setup)
+    {
+        return [opcodes, setup](Machine &machine)
+        {
+            if (setup)
+            {
+                setup(machine);
+            }
+            for (size_t i = 0; i < opcodes.size(); i++)
+            {
+                machine.m_memory.write(i * 2, opcodes[i] >> 8);
+                machine.m_memory.write(i * 2 + 1, opcodes[i] & 0xff);
+            }
+            machine.m_programCounter = 0;
+        };
+    }
+
+    /**
+     * @brief Generate opcodes with random register operands
+     *
+     * @param base Opcode with operand fields set to zero
+     * @param useY Fill the second register field too
+     */
+    std::vector<uint16_t> randomOperands(uint16_t base, bool useY = true)
+    {
+        std::vector<uint16_t> opcodes(256);
+        for (uint16_t &opcode : opcodes)
+        {
+            opcode = base | ((m_random() & 0xf) << 8);
+            if (useY)
+            {
+                opcode |= (m_random() & 0xf) << 4;
+            }
+            const uint16_t group = base & 0xf000;
+            if (group == 0x2000 || group == 0xA000)
+            {
+                opcode = base | (m_random() & 0xfff);
+            }
+            else if (group == 0x3000 || group == 0x4000 || group == 0x6000 || group == 0x7000)
+            {
+                opcode |= m_random() & 0xff;
+            }
+        }
+        return opcodes;
+    }
+
+    /**
+     * @brief Time the operation, printing the result if the name contains the filter
+     *
+     * @param name Name of the benchmark
+     * @param filter Part of the name to match, empty matches everything
+     * @param opcodes Opcodes that are passed to the operation in turn
+     * @param setup Function that prepares the machine before every repetition or nullptr, it is not timed
+     * @param operation Function that executes a single opcode
+     */
+    template <typename Operation>
+    void run(std::string const &name, std::string const &filter, std::vector<uint16_t> const &opcodes, SetupFunction setup, Operation operation)
+    {
+        if (!filter.empty() && name.find(filter) == std::string::npos)
+        {
+            return;
+        }
+        Machine machine;
+        auto repetition = [&]()
+        {
+            for (size_t i = 0; i < m_operationsPerRepetition; i++)
+            {
+                operation(machine, opcodes[i % opcodes.size()]);
+            }
+            // keep the compiler from dropping work whose results are never read
+#if defined(__GNUC__)
+            asm volatile("" : : "g"(&machine) : "memory");
+#endif
+        };
+        auto prepare = [&]()
+        {
+            if (setup)
+            {
+                setup(machine);
+            }
+        };
+        for (size_t i = 0; i < m_repetitions / 10 + 1; i++)
+        {
+            prepare();
+            repetition();
+        }
+        std::vector<double> nanoseconds(m_repetitions);
+        double cycles = 0;
+        for (size_t i = 0; i < m_repetitions; i++)
+        {
+            prepare();
+#ifdef GOB8_HAS_CYCLE_COUNTER
+            const uint64_t startCycles = __rdtsc();
+#endif
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            repetition();
+            nanoseconds[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / m_operationsPerRepetition;
+#ifdef GOB8_HAS_CYCLE_COUNTER
+            cycles += (double)(__rdtsc() - startCycles) / m_operationsPerRepetition;
+#endif
+        }
+        print(name, summarize(nanoseconds, cycles / m_repetitions));
+    }
+
+    static BenchmarkResult summarize(std::vector<double> &samples, double cyclesMean)
+    {
+        BenchmarkResult result = {};
+        double sum = 0;
+        for (double sample : samples)
+        {
+            sum += sample;
+        }
+        result.nanosecondsMean = sum / samples.size();
+        double squares = 0;
+        for (double sample : samples)
+        {
+            squares += (sample - result.nanosecondsMean) * (sample - result.nanosecondsMean);
+        }
+        const double deviation = samples.size() > 1 ? std::sqrt(squares / (samples.size() - 1)) : 0;
+        result.nanosecondsConfidence = 1.96 * deviation / std::sqrt((double)samples.size());
+        std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+        result.nanosecondsMedian = samples[samples.size() / 2];
+        result.cyclesMean = cyclesMean;
+        return result;
+    }
+
+    static void print(std::string const &name, BenchmarkResult const &result)
+    {
+        std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << result.nanosecondsMean << std::setw(12) << result.nanosecondsConfidence
+                  << std::setw(12) << result.nanosecondsMedian;
+#ifdef GOB8_HAS_CYCLE_COUNTER
+        std::cout << std::setw(14) << result.cyclesMean;
+#else
+        std::cout << std::setw(14) << "n/a";
+#endif
+        std::cout << std::endl;
+    }
+
+    size_t m_repetitions;
+    size_t m_operationsPerRepetition;
+    std::mt19937 m_random;
+};
+
+int main(int argc, char **argv)
+{
+    size_t repetitions = 200;
+    size_t operations = 10000;
+    std::string filter;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = std::string(argv[i]);
+        if (arg == "-r" || arg == "--repetitions")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for repetitions flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            repetitions = std::max(2ul, std::stoul(std::string(argv[++i])));
+        }
+        if (arg == "-n" || arg == "--operations")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for operations flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            operations = std::max(1ul, std::stoul(std::string(argv[++i])));
+        }
+        if (arg == "-f" || arg == "--filter")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for filter flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            filter = std::string(argv[++i]);
+        }
+    }
+    // cycles come from the time stamp counter which runs at a constant rate, not necessarily the current core clock
+    HandlerBenchmark benchmark(repetitions, operations);
+    benchmark.runAll(filter);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+#include <iostream>
+#include <filesystem>
+#include <iomanip>
+
+#include "Assembler.hpp"
+#include "Conformance.hpp"
+#include "RomPack.hpp"
+#include "TranslationCache.hpp"
+
+/**
+ * @brief Compare every core against the reference on the program and print the results
+ *
+ * @param name Name the results are printed with
+ * @param program Bytes of the program
+ * @param coreNames Cores to check, all of them exist
+ * @param harness Harness to check with
+ * @param cache Translation cache that native code comes from, if any
+ * @return size_t Number of cores that failed
+ */
+size_t checkProgram(std::string const &name, std::span<const uint8_t> program, std::vector<std::string> const &coreNames, ConformanceHarness &harness, std::optional<TranslationCache> &cache)
+{
+    if (cache.has_value())
+    {
+        try
+        {
+            cache->translate(program, std::filesystem::path(name).filename().string());
+        }
+        catch (TranslationCacheError const &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+    size_t failures = 0;
+    for (std::string const &coreName : coreNames)
+    {
+        std::unique_ptr<ExecutionCore> core = createExecutionCore(coreName);
+        ConformanceResult result = harness.check(program, *core);
+        if (!result.supported)
+        {
+            std::cout << "SKIP " << name << " " << coreName << ": core can't run this program" << std::endl;
+        }
+        else if (result.difference.has_value())
+        {
+            std::cout << "FAIL " << name << " " << coreName << " after " << result.steps << " instructions: " << result.difference.value() << std::endl;
+            failures++;
+        }
+        else
+        {
+            std::cout << "PASS " << name << " " << coreName << ": " << result.steps << " instructions, reference "
+                      << result.referenceInstructionsPerSecond / 1e6 << " MIPS, " << coreName << " "
+                      << result.candidateInstructionsPerSecond / 1e6 << " MIPS ("
+                      << result.candidateInstructionsPerSecond / std::max(result.referenceInstructionsPerSecond, 1.0) << "x)" << std::endl;
+        }
+    }
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> coreNames;
+    std::vector<std::string> filenames;
+    size_t maxSteps = 1000000;
+    size_t compareInterval = 1;
+    size_t frameLength = 100;
+    std::string cacheDirectory;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = std::string(argv[i]);
+        if (arg == "-c" || arg == "--core" || arg == "--steps" || arg == "--compare-every" || arg == "--frame" || arg == "--cache")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << " flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            std::string value = std::string(argv[++i]);
+            if (arg == "-c" || arg == "--core")
+            {
+                coreNames.push_back(value);
+            }
+            else if (arg == "--steps")
+            {
+                maxSteps = std::stoul(value);
+            }
+            else if (arg == "--compare-every")
+            {
+                compareInterval = std::stoul(value);
+            }
+            else if (arg == "--cache")
+            {
+                cacheDirectory = value;
+            }
+            else
+            {
+                frameLength = std::stoul(value);
+            }
+        }
+        else
+        {
+            filenames.push_back(arg);
+        }
+    }
+    if (coreNames.empty())
+    {
+        for (std::string const &name : getExecutionCoreNames())
+        {
+            if (name != "reference")
+            {
+                coreNames.push_back(name);
+            }
+        }
+    }
+
+    // programs translated into the cache are found by the native core like the ones linked in
+    std::optional<TranslationCache> cache;
+    if (!cacheDirectory.empty())
+    {
+        try
+        {
+            cache.emplace(cacheDirectory);
+        }
+        catch (TranslationCacheError const &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (std::string const &coreName : coreNames)
+    {
+        if (createExecutionCore(coreName) == nullptr)
+        {
+            std::cerr << "Unknown core " << coreName << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    ConformanceHarness harness(maxSteps, compareInterval, frameLength);
+    size_t failures = 0;
+    std::cout << std::fixed << std::setprecision(2);
+    for (std::string const &filename : filenames)
+    {
+        if (std::filesystem::path(filename).extension() == ".g8p")
+        {
+            // every rom of the pack runs straight from the mapping
+            try
+            {
+                RomPack pack(filename);
+                for (size_t i = 0; i < pack.getRomCount(); i++)
+                {
+                    failures += checkProgram(filename + ":" + std::string(pack.getName(i)), pack.getRom(i), coreNames, harness, cache);
+                }
+            }
+            catch (RomPackError const &e)
+            {
+                std::cerr << e.what() << std::endl;
+                failures++;
+            }
+            continue;
+        }
+        std::optional<std::vector<uint8_t>> program = assembleOrLoad(filename);
+        if (!program.has_value())
+        {
+            failures++;
+            continue;
+        }
+        failures += checkProgram(filename, program.value(), coreNames, harness, cache);
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,30 @@
+; register operations over a range of values, including the carry flag and rotations
+    mov v0, 0
+    mov v1, 0x5a
+loop:
+    mov v2, v0
+    or v2, v1
+    mov v3, v0
+    and v3, v1
+    mov v4, v0
+    xor v4, v1
+    mov v5, v0
+    add v5, v1
+    mov v6, vf
+    mov v7, v0
+    sub v7, v1
+    mov v8, vf
+    mov v9, v0
+    dw 0x8917 ; v9 = v1 - v9
+    mov va, vf
+    mov vb, v0
+    ror vb, v1
+    mov vc, v0
+    rol vc, v1
+    dw 0x8019 ; unknown register operation
+    add vf, v0
+    add v1, 0x35
+    add v0, 7
+    neq v0, 0xfc
+    hlt
+    jmp loop
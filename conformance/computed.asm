@@ -0,0 +1,32 @@
+; random numbers and jumps by register
+    mov v5, 0
+loop:
+    dw 0xc1ff ; v1 = random & 0xff
+    dw 0xc20f ; v2 = random & 0x0f
+    mov v0, v2
+    and v0, v7
+    add v0, v0
+    ; BNNN continues two bytes past v0 + NNN
+    dw 0xb000 + table - 2
+table:
+    jmp case0
+    jmp case1
+    jmp case2
+    jmp case3
+case0:
+    add v8, 1
+    jmp next
+case1:
+    add v9, 1
+    jmp next
+case2:
+    add va, 1
+    jmp next
+case3:
+    add vb, 1
+next:
+    mov v7, 3
+    add v5, 1
+    neq v5, 100
+    hlt
+    jmp loop
@@ -0,0 +1,26 @@
+; jumps, calls, returns, screen control and opcodes the machine ignores
+; nested calls overwrite part of the previous return address since the stack only moves by one byte
+    mov v0, 0
+loop:
+    call first
+    add v0, 1
+    render
+    clear
+    dw 0x0123 ; 0NNN is ignored
+    dw 0x00e5 ; unknown control opcode
+    neq v0, 20
+    jmp done
+    jmp loop
+first:
+    add v1, 3
+    ret
+done:
+    call outer
+    hlt
+outer:
+    add v2, 1
+    call inner
+    ret
+inner:
+    add v3, 1
+    ret
@@ -0,0 +1,15 @@
+; sprite on the last row whose right edge touches the end of the video memory, lit pixels stay inside of it
+; every pixel has to be hashed with its own key, even when the row ends at the last pixel
+    mov v0, 56
+    mov v1, 31
+    mem sprite
+    draw v0, v1, 1
+    ; pixels past the end wrap around to the top instead of landing outside of the video memory
+    mov v0, 60
+    mem full
+    draw v0, v1, 1
+    hlt
+full:
+    db 0xff, 0xff
+sprite:
+    db 0b11111110
@@ -0,0 +1,31 @@
+; sprites at different positions and sizes with XOR, both video buffers and memory register arithmetic
+; draw writes past the end of the video memory if the sprite doesn't fit, so positions are kept on screen
+    mov v0, 0
+    mov v1, 0
+    mov v4, 2
+    mov v5, 15
+loop:
+    mem sprite
+    draw v0, v1, 4
+    memadd v4
+    mov v3, v0
+    and v3, v5
+    draw v1, v3, 2
+    render
+    draw v0, v1, 4
+    add v0, 5
+    add v1, 3
+    neq v1, 27
+    jmp done
+    jmp loop
+done:
+    clear
+    render
+    mem sprite
+    mov v0, 10
+    mov v1, 10
+    draw v0, v1, 8
+    hlt
+sprite:
+    db 0b10000001, 0b01000010, 0b00100100, 0b00011000
+    db 0b11111111, 0b10101010, 0b01010101, 0b11110000
@@ -0,0 +1,19 @@
+; every conditional skip with both outcomes
+    mov v0, 0
+    mov v1, 0
+loop:
+    eq v0, 7
+    add v2, 1
+    neq v0, 7
+    add v3, 1
+    eq v0, v1
+    add v4, 1
+    neq v0, v1
+    add v5, 1
+    add v1, 3
+    and v1, v6
+    add v0, 1
+    mov v6, 0x0f
+    neq v0, 64
+    hlt
+    jmp loop
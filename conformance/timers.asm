@@ -0,0 +1,28 @@
+; waiting for the timer, sound timer, keys and blocking input
+    mov v0, 3
+    mov v5, 0
+round:
+    settimer v0
+    beep v0
+wait:
+    gettimer v1
+    neq v1, 0
+    jmp waited
+    jmp wait
+waited:
+    mov v2, 0
+keys:
+    keydown v2
+    add v3, 1
+    keyup v2
+    add v4, 1
+    add v2, 1
+    neq v2, 16
+    jmp input
+    jmp keys
+input:
+    in v6
+    add v5, 1
+    neq v5, 4
+    hlt
+    jmp round
@@ -0,0 +1,204 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "Disassembler.hpp"
+
+/**
+ * @brief Read the whole file
+ *
+ * @param filename Path to the file
+ * @param bytes Vector to write the data into, existing capacity is reused
+ * @return true If file was read
+ */
+bool readFile(std::string const &filename, std::vector<uint8_t> &bytes)
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    bytes.resize(file.tellg());
+    file.seekg(0);
+    file.read((char *)bytes.data(), bytes.size());
+    return !file.fail();
+}
+
+/**
+ * @brief Disassemble every file in the list using several threads, writing results into the output directory
+ *
+ * @param inputs Paths to the programs
+ * @param outputDirectory Directory to write the source(and graph) files into, nothing is written if empty
+ * @param writeGraph If true also write graphs in DOT format
+ * @param threadCount Number of threads to use
+ * @return size_t Number of files that could not be processed
+ */
+size_t disassembleBatch(std::vector<std::string> const &inputs, std::string const &outputDirectory, bool writeGraph, size_t threadCount)
+{
+    std::atomic<size_t> nextInput = 0;
+    std::atomic<size_t> failures = 0;
+    auto worker = [&]()
+    {
+        Disassembler disassembler;
+        std::vector<uint8_t> bytes;
+        for (size_t i = nextInput++; i < inputs.size(); i = nextInput++)
+        {
+            if (!readFile(inputs[i], bytes))
+            {
+                failures++;
+                continue;
+            }
+            disassembler.analyze(bytes);
+            if (outputDirectory.empty())
+            {
+                continue;
+            }
+            std::filesystem::path output = std::filesystem::path(outputDirectory) / std::filesystem::path(inputs[i]).filename();
+            std::ofstream source(output.replace_extension(".asm"));
+            disassembler.writeSource(source);
+            if (writeGraph)
+            {
+                std::ofstream graph(output.replace_extension(".dot"));
+                disassembler.writeDot(graph, output.stem().string());
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    std::string inputFilename = "./game.bin";
+    std::string outputFilename;
+    std::string graphFilename;
+    std::string batchDirectory;
+    bool batch = false;
+    bool writeGraph = false;
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> batchInputs;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = std::string(argv[i]);
+        if (arg == "-i" || arg == "--input")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing filename for input flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            inputFilename = std::string(argv[++i]);
+        }
+        else if (arg == "-o" || arg == "--output")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing filename for output flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            outputFilename = std::string(argv[++i]);
+        }
+        else if (arg == "--dot")
+        {
+            // in batch mode graphs are written next to the sources
+            writeGraph = true;
+            if (!batch && i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                graphFilename = std::string(argv[++i]);
+            }
+        }
+        else if (arg == "--batch")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing output directory for batch flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            batch = true;
+            batchDirectory = std::string(argv[++i]);
+        }
+        else if (arg == "-j" || arg == "--jobs")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for jobs flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            threadCount = std::max(1ul, std::stoul(std::string(argv[++i])));
+        }
+        else if (batch)
+        {
+            batchInputs.push_back(arg);
+        }
+    }
+
+    if (batch)
+    {
+        if (!batchDirectory.empty() && batchDirectory != "-")
+        {
+            std::filesystem::create_directories(batchDirectory);
+        }
+        else
+        {
+            // only analyse, useful for measuring
+            batchDirectory.clear();
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const size_t failures = disassembleBatch(batchInputs, batchDirectory, writeGraph, threadCount);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Disassembled " << batchInputs.size() - failures << " programs in " << seconds * 1000.0 << " ms ("
+                  << (batchInputs.size() - failures) / std::max(seconds, 1e-9) << " programs/s)" << std::endl;
+        if (failures > 0)
+        {
+            std::cerr << failures << " files could not be read" << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    std::vector<uint8_t> bytes;
+    if (!readFile(inputFilename, bytes))
+    {
+        std::cerr << "Unable to open the input file" << std::endl;
+        return EXIT_FAILURE;
+    }
+    Disassembler disassembler;
+    disassembler.analyze(bytes);
+    if (outputFilename.empty())
+    {
+        disassembler.writeSource(std::cout);
+    }
+    else
+    {
+        std::ofstream output(outputFilename);
+        disassembler.writeSource(output);
+    }
+    if (writeGraph)
+    {
+        const std::string name = std::filesystem::path(inputFilename).stem().string();
+        if (graphFilename.empty())
+        {
+            graphFilename = std::filesystem::path(inputFilename).replace_extension(".dot").string();
+        }
+        std::ofstream graph(graphFilename);
+        disassembler.writeDot(graph, name);
+    }
+    if (disassembler.hasIndirectJumps())
+    {
+        std::cerr << "Warning: program uses jumps by register, code reached by them is written as data" << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
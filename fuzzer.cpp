@@ -0,0 +1,169 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <chrono>
+#include <iomanip>
+
+#include "Assembler.hpp"
+#include "Fuzzer.hpp"
+
+/**
+ * @brief Save the input that caused the finding into the output directory, named after the kind of the bug and its address
+ *
+ * @return std::string Path of the file
+ */
+std::string saveFinding(std::filesystem::path const &directory, Fuzzer::Finding const &finding)
+{
+    std::stringstream name;
+    name << getFuzzOutcomeName(finding.outcome) << "-" << std::hex << std::setw(3) << std::setfill('0') << finding.programCounter << ".txt";
+    std::filesystem::path path = directory / name.str();
+    std::ofstream file(path);
+    file << "# " << getFuzzOutcomeName(finding.outcome) << " at " << std::hex << finding.programCounter << "\n"
+         << finding.input.serialize();
+    return path.string();
+}
+
+int main(int argc, char **argv)
+{
+    std::string inputFilename;
+    std::string outputDirectory = "./findings";
+    std::string replayFilename;
+    double seconds = 10;
+    size_t maxExecutions = 0;
+    Fuzzer::Config config;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = std::string(argv[i]);
+        if (arg == "--keys-only")
+        {
+            config.mutateProgram = false;
+        }
+        else if (arg == "-i" || arg == "--input" || arg == "-o" || arg == "--output" || arg == "-t" || arg == "--time" || arg == "-n" || arg == "--executions" ||
+                 arg == "--frames" || arg == "--instructions-per-frame" || arg == "--seed" || arg == "--replay")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << " flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            std::string value = std::string(argv[++i]);
+            if (arg == "-i" || arg == "--input")
+            {
+                inputFilename = value;
+            }
+            else if (arg == "-o" || arg == "--output")
+            {
+                outputDirectory = value;
+            }
+            else if (arg == "-t" || arg == "--time")
+            {
+                seconds = std::stod(value);
+            }
+            else if (arg == "-n" || arg == "--executions")
+            {
+                maxExecutions = std::stoul(value);
+            }
+            else if (arg == "--frames")
+            {
+                config.maxFrames = std::stoul(value);
+            }
+            else if (arg == "--instructions-per-frame")
+            {
+                config.instructionsPerFrame = std::stoul(value);
+            }
+            else if (arg == "--seed")
+            {
+                config.seed = std::stoul(value);
+            }
+            else
+            {
+                replayFilename = value;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown flag " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (inputFilename.empty())
+    {
+        std::cerr << "Missing program, use -i <program>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::optional<std::vector<uint8_t>> program = assembleOrLoad(inputFilename);
+    if (!program.has_value())
+    {
+        return EXIT_FAILURE;
+    }
+    try
+    {
+        Fuzzer fuzzer(program.value(), config);
+        if (!replayFilename.empty())
+        {
+            std::ifstream file(replayFilename);
+            if (!file.is_open())
+            {
+                std::cerr << "Unable to open " << replayFilename << std::endl;
+                return EXIT_FAILURE;
+            }
+            std::stringstream text;
+            text << file.rdbuf();
+            const FuzzInput input = FuzzInput::parse(text.str());
+            size_t programCounter;
+            const FuzzOutcome outcome = fuzzer.execute(input, programCounter);
+            // a finding is only useful if it can be reproduced, so the input is executed a second time to check for that
+            size_t replayProgramCounter;
+            if (fuzzer.execute(input, replayProgramCounter) != outcome || replayProgramCounter != programCounter)
+            {
+                std::cerr << "Input does not replay the same way twice" << std::endl;
+                return EXIT_FAILURE;
+            }
+            std::cout << getFuzzOutcomeName(outcome) << " at " << std::hex << programCounter << std::endl;
+            return outcome > FuzzOutcome::Halted ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+
+        std::filesystem::create_directories(outputDirectory);
+        using Clock = std::chrono::steady_clock;
+        const Clock::time_point start = Clock::now();
+        Clock::time_point lastReport = start;
+        size_t savedFindings = 0;
+        while (maxExecutions == 0 || fuzzer.getExecutionCount() < maxExecutions)
+        {
+            // checking the clock on every execution would cost more than the execution itself
+            for (size_t i = 0; i < 1024 && (maxExecutions == 0 || fuzzer.getExecutionCount() < maxExecutions); i++)
+            {
+                fuzzer.fuzzOnce();
+            }
+            for (; savedFindings < fuzzer.getFindings().size(); savedFindings++)
+            {
+                Fuzzer::Finding const &finding = fuzzer.getFindings()[savedFindings];
+                std::cout << "Found " << getFuzzOutcomeName(finding.outcome) << " at " << std::hex << finding.programCounter << std::dec
+                          << ", saved to " << saveFinding(outputDirectory, finding) << std::endl;
+            }
+            const Clock::time_point now = Clock::now();
+            const double elapsed = std::chrono::duration<double>(now - start).count();
+            if (now - lastReport >= std::chrono::seconds(1))
+            {
+                lastReport = now;
+                std::cout << std::fixed << std::setprecision(0) << fuzzer.getExecutionCount() << " executions, " << fuzzer.getExecutionCount() / elapsed
+                          << "/s, corpus " << fuzzer.getCorpusSize() << ", edges " << fuzzer.getEdgeCount() << ", findings " << fuzzer.getFindings().size() << std::endl;
+            }
+            if (elapsed >= seconds)
+            {
+                break;
+            }
+        }
+        const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        std::cout << std::fixed << std::setprecision(0) << "Done: " << fuzzer.getExecutionCount() << " executions in " << std::setprecision(1) << elapsed << " s ("
+                  << std::setprecision(0) << fuzzer.getExecutionCount() / elapsed << "/s), corpus " << fuzzer.getCorpusSize() << ", edges "
+                  << fuzzer.getEdgeCount() << ", findings " << fuzzer.getFindings().size() << std::endl;
+    }
+    catch (FuzzError const &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
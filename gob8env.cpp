@@ -0,0 +1,113 @@
+#include "gob8env.h"
+#include "VectorEnvironment.hpp"
+#include <exception>
+#include <string>
+
+struct gob8_env
+{
+    VectorEnvironment environment;
+};
+
+/// @brief Message of the last error, errors can't be thrown across the C interface
+static thread_local std::string lastError;
+
+/// @brief Run the function, turning exceptions into the error code
+template <typename Function>
+static int guard(Function function)
+{
+    try
+    {
+        function();
+        return 0;
+    }
+    catch (std::exception const &e)
+    {
+        lastError = e.what();
+    }
+    catch (...)
+    {
+        lastError = "Unknown error";
+    }
+    return -1;
+}
+
+void gob8_env_default_config(gob8_env_config *config)
+{
+    const VectorEnvironment::Config defaults;
+    config->environment_count = defaults.environmentCount;
+    config->frames_per_step = defaults.framesPerStep;
+    config->instructions_per_frame = defaults.instructionsPerFrame;
+    config->thread_count = defaults.threadCount;
+    config->packed_observations = defaults.packedObservations;
+}
+
+gob8_env *gob8_env_create(const uint8_t *program, size_t program_size, const gob8_env_config *config)
+{
+    gob8_env *env = nullptr;
+    guard([&]()
+          {
+        gob8_env_config defaults;
+        if (config == nullptr)
+        {
+            gob8_env_default_config(&defaults);
+            config = &defaults;
+        }
+        if (program == nullptr && program_size != 0)
+        {
+            throw EnvironmentError("Program is missing");
+        }
+        VectorEnvironment::Config environmentConfig;
+        environmentConfig.environmentCount = config->environment_count;
+        environmentConfig.framesPerStep = config->frames_per_step;
+        environmentConfig.instructionsPerFrame = config->instructions_per_frame;
+        environmentConfig.threadCount = config->thread_count;
+        environmentConfig.packedObservations = config->packed_observations != 0;
+        env = new gob8_env{VectorEnvironment(std::span<const uint8_t>(program, program_size), environmentConfig)}; });
+    return env;
+}
+
+void gob8_env_destroy(gob8_env *env)
+{
+    delete env;
+}
+
+int gob8_env_reset(gob8_env *env, const uint32_t *indices, size_t count)
+{
+    return guard([&]()
+                 { env->environment.reset(indices == nullptr ? std::span<const uint32_t>() : std::span<const uint32_t>(indices, count)); });
+}
+
+int gob8_env_step(gob8_env *env, const uint16_t *actions)
+{
+    return guard([&]()
+                 {
+        if (actions == nullptr)
+        {
+            throw EnvironmentError("Actions are missing");
+        }
+        env->environment.step(std::span<const uint16_t>(actions, env->environment.getEnvironmentCount())); });
+}
+
+const uint8_t *gob8_env_observations(const gob8_env *env, size_t *stride)
+{
+    if (stride != nullptr)
+    {
+        *stride = env->environment.getObservationStride();
+    }
+    return env->environment.getObservations();
+}
+
+const uint8_t *gob8_env_halted(const gob8_env *env)
+{
+    return env->environment.getHaltedFlags();
+}
+
+uint32_t gob8_env_environment_count(const gob8_env *env)
+{
+    return env->environment.getEnvironmentCount();
+}
+
+const char *gob8_env_last_error(void)
+{
+    return lastError.c_str();
+}
@@ -0,0 +1,79 @@
+#pragma once
+/**
+ * @brief C interface of the batched environment, for driving many machines from other languages.
+ * Functions that can fail return 0 on success and -1 on error, gob8_env_last_error describes the last error of the calling thread
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct gob8_env gob8_env;
+
+    typedef struct gob8_env_config
+    {
+        /// @brief Number of machines in the batch
+        uint32_t environment_count;
+        /// @brief Frames executed by every step, a frame advances the timers once
+        uint32_t frames_per_step;
+        /// @brief Instructions executed per frame
+        uint32_t instructions_per_frame;
+        /// @brief Threads used for stepping, 0 uses one per hardware thread
+        uint32_t thread_count;
+        /// @brief Non zero stores eight pixels per byte, lowest bit is the leftmost pixel
+        int32_t packed_observations;
+    } gob8_env_config;
+
+    /// @brief Fill the config with one machine, one frame of one instruction per step, all hardware threads and a byte per pixel
+    void gob8_env_default_config(gob8_env_config *config);
+
+    /**
+     * @brief Create a batch of machines running the program
+     *
+     * @param program Bytes of the program
+     * @param program_size Number of bytes in the program
+     * @param config Configuration of the batch, NULL uses the default one
+     * @return gob8_env* New environment or NULL on error
+     */
+    gob8_env *gob8_env_create(const uint8_t *program, size_t program_size, const gob8_env_config *config);
+
+    void gob8_env_destroy(gob8_env *env);
+
+    /**
+     * @brief Put machines back into their initial state
+     *
+     * @param indices Indices of the machines to reset, NULL resets all of them
+     * @param count Number of indices
+     */
+    int gob8_env_reset(gob8_env *env, const uint32_t *indices, size_t count);
+
+    /**
+     * @brief Run every machine for the configured number of frames.
+     * CXNN draws from the process wide rand, so with more than one thread the numbers a machine gets depend on how the threads interleave
+     * and the results of programs using it are not reproducible. The lock inside rand also makes such programs step one machine at a time
+     *
+     * @param actions environment_count values, bit N set holds key N down for the step
+     */
+    int gob8_env_step(gob8_env *env, const uint16_t *actions);
+
+    /**
+     * @brief Get the observations of all machines, updated in place by every step and reset. Shape is [environment][32][64],
+     * or [environment][32][8] when packed, rows start at 64 byte boundaries
+     *
+     * @param stride Set to the distance in bytes between two machines if not NULL
+     */
+    const uint8_t *gob8_env_observations(const gob8_env *env, size_t *stride);
+
+    /// @brief One byte per machine, 1 once the machine halted
+    const uint8_t *gob8_env_halted(const gob8_env *env);
+
+    uint32_t gob8_env_environment_count(const gob8_env *env);
+
+    const char *gob8_env_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
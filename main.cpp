@@ -5,42 +5,132 @@
 #include <SDL.h>
 #include <fstream>
 #include <map>
+#include <memory>
 #include <algorithm>
+#include <filesystem>
+#include <sstream>
+#include <iomanip>
 
 #include "DisplaySDL.hpp"
+#include "Keymap.hpp"
 #include "Machine.hpp"
+#include "Assembler.hpp"
+#include "CompiledProgram.hpp"
+#include "TranslationCache.hpp"
+#include "RomPack.hpp"
+#include "VideoCapture.hpp"
+#include "Metrics.hpp"
+#include "SharedState.hpp"
 
-static const std::vector<SDL_Scancode> Keymap = {
-    // wasd
-    SDL_Scancode::SDL_SCANCODE_W, // 0x1
-    SDL_Scancode::SDL_SCANCODE_A, // 0x2
-    SDL_Scancode::SDL_SCANCODE_S, // 0x3
-    SDL_Scancode::SDL_SCANCODE_D, // 0x4
-    // arrows
-    SDL_Scancode::SDL_SCANCODE_UP,    // 0x5
-    SDL_Scancode::SDL_SCANCODE_DOWN,  // 0x6
-    SDL_Scancode::SDL_SCANCODE_LEFT,  // 0x7
-    SDL_Scancode::SDL_SCANCODE_RIGHT, // 0x8
-    // input right
-    SDL_Scancode::SDL_SCANCODE_LSHIFT, // 0x9
-    SDL_Scancode::SDL_SCANCODE_SPACE,  // 0xa
-    // input left
-    SDL_Scancode::SDL_SCANCODE_RSHIFT, // 0xb
-    SDL_Scancode::SDL_SCANCODE_RCTRL,  // 0xc
-    // pause
-    SDL_Scancode::SDL_SCANCODE_ESCAPE,   // 0xd
-    SDL_Scancode::SDL_SCANCODE_TAB,      // 0xe
-    SDL_Scancode::SDL_SCANCODE_BACKSPACE // 0xf
-};
+/// @brief How often the watched source file is checked for changes
+static const uint32_t WatchIntervalMs = 250;
+
+/// @brief Key that toggles turbo mode
+static const SDL_Scancode TurboKey = SDL_Scancode::SDL_SCANCODE_GRAVE;
+
+/// @brief Key that toggles the performance overlay
+static const SDL_Scancode OverlayKey = SDL_Scancode::SDL_SCANCODE_F1;
+
+/// @brief Upper limit for the number of frames emulated between two presented frames in turbo mode
+static const size_t MaxTurboFrameSkip = 1 << 20;
 
-std::optional<uint8_t> handleInput(SDL_Scancode key)
+/**
+ * @brief Assemble the source file in process
+ *
+ * @param filename Path to the source file
+ * @param symbols Table to write labels and lines of the program into
+ * @return std::optional<std::vector<uint8_t>> Assembled program or empty value if file could not be read or assembled
+ */
+std::optional<std::vector<uint8_t>> assembleFile(std::string const &filename, SymbolTable &symbols)
 {
-    std::vector<SDL_Scancode>::const_iterator it = std::find(Keymap.begin(), Keymap.end(), key);
-    if (it == Keymap.end())
+    std::ifstream file(filename);
+    if (!file.is_open())
     {
+        std::cerr << "Unable to open the source file " << filename << std::endl;
         return {};
     }
-    return (it - Keymap.begin() + 1);
+    std::stringstream code;
+    code << file.rdbuf();
+    try
+    {
+        Assembler assembler(prepareCode(code.str()));
+        assembler.parse();
+        std::span<const uint8_t> result = assembler.getResult();
+        symbols = assembler.getSymbols(std::filesystem::path(filename).filename().string());
+        return std::vector<uint8_t>(result.begin(), result.end());
+    }
+    catch (AssemblingError const &e)
+    {
+        std::cerr << filename << ": " << e.what() << std::endl;
+    }
+    return {};
+}
+
+/**
+ * @brief Print registers and location of the machine, used when the machine halts
+ *
+ * @param machine Machine to print
+ * @param symbols Symbols of the program
+ * @param lastProgramCounter Address of the last executed instruction
+ */
+void dumpMachineState(Machine const &machine, SymbolTable const &symbols, uint16_t lastProgramCounter)
+{
+    std::cerr << "Machine halted at " << symbols.describe(lastProgramCounter) << std::endl;
+    std::cerr << std::hex << std::setfill('0');
+    for (size_t i = 0; i < machine.getRegisters().size(); i++)
+    {
+        std::cerr << "v" << i << "=" << std::setw(2) << (int)machine.getRegisters()[i] << (i % 8 == 7 ? "\n" : " ");
+    }
+    std::cerr << "I=" << std::setw(3) << machine.getMemoryRegister() << " (" << symbols.describe(machine.getMemoryRegister()) << ")"
+              << " SP=" << std::setw(3) << machine.getStackPointer() << std::dec << std::endl;
+}
+
+/**
+ * @brief Print where the program spent its time, grouped by labels and by individual addresses
+ *
+ * @param samples Number of executed instructions for every address
+ * @param symbols Symbols of the program
+ */
+void printProfile(std::vector<uint64_t> const &samples, SymbolTable const &symbols)
+{
+    const size_t maxEntries = 20;
+    uint64_t total = 0;
+    std::map<std::string, uint64_t> perLabel;
+    std::vector<std::pair<uint64_t, uint16_t>> perAddress;
+    for (size_t address = 0; address < samples.size(); address++)
+    {
+        if (samples[address] == 0)
+        {
+            continue;
+        }
+        total += samples[address];
+        std::optional<std::pair<std::string, uint16_t>> label = symbols.findLabel(address);
+        perLabel[label.has_value() ? label.value().first : "<unknown>"] += samples[address];
+        perAddress.push_back({samples[address], address});
+    }
+    if (total == 0)
+    {
+        return;
+    }
+    std::vector<std::pair<uint64_t, std::string>> labels;
+    for (std::pair<const std::string, uint64_t> const &label : perLabel)
+    {
+        labels.push_back({label.second, label.first});
+    }
+    std::sort(labels.rbegin(), labels.rend());
+    std::sort(perAddress.rbegin(), perAddress.rend());
+
+    std::cerr << "Profile: " << total << " instructions" << std::endl;
+    std::cerr << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < labels.size() && i < maxEntries; i++)
+    {
+        std::cerr << std::setw(7) << labels[i].first * 100.0 / total << "%  " << labels[i].second << std::endl;
+    }
+    std::cerr << "Hottest instructions:" << std::endl;
+    for (size_t i = 0; i < perAddress.size() && i < maxEntries; i++)
+    {
+        std::cerr << std::setw(7) << perAddress[i].first * 100.0 / total << "%  " << symbols.describe(perAddress[i].second) << std::endl;
+    }
 }
 
 struct AudioData
@@ -55,6 +145,20 @@ int main(int argc, char **argv)
 {
     uint32_t frameCap = 60;
     std::string inputFilename = "./game.bin";
+    std::string watchFilename;
+    std::string symbolsFilename;
+    bool trace = false;
+    bool profile = false;
+    bool interpret = false;
+    bool turbo = false;
+    bool phosphor = false;
+    std::string recordFilename;
+    std::string exportName;
+    std::string cacheDirectory;
+    std::string romName;
+    bool metricsEnabled = false;
+    std::string metricsFilename;
+    bool overlay = false;
     for (int i = 0; i < argc; i++)
     {
         std::string arg = std::string(argv[i]);
@@ -76,28 +180,318 @@ int main(int argc, char **argv)
             }
             frameCap = std::stoul(std::string(argv[i + 1]));
         }
+        if (arg == "-w" || arg == "--watch")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing filename for watch flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            watchFilename = std::string(argv[i + 1]);
+        }
+        if (arg == "-s" || arg == "--symbols")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing filename for symbols flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            symbolsFilename = std::string(argv[i + 1]);
+        }
+        if (arg == "--trace")
+        {
+            trace = true;
+        }
+        if (arg == "--profile")
+        {
+            profile = true;
+        }
+        if (arg == "--interpret")
+        {
+            interpret = true;
+        }
+        if (arg == "--turbo")
+        {
+            turbo = true;
+        }
+        if (arg == "--phosphor")
+        {
+            phosphor = true;
+        }
+        if (arg == "--metrics")
+        {
+            metricsEnabled = true;
+        }
+        if (arg == "--metrics-file")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing filename for metrics file flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            metricsEnabled = true;
+            metricsFilename = std::string(argv[i + 1]);
+        }
+        if (arg == "--overlay")
+        {
+            overlay = true;
+        }
+        if (arg == "-r" || arg == "--record")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing filename for record flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            recordFilename = std::string(argv[i + 1]);
+        }
+        if (arg == "--export")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing name for export flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            exportName = std::string(argv[i + 1]);
+        }
+        if (arg == "--cache")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing directory for cache flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            cacheDirectory = std::string(argv[i + 1]);
+        }
+        if (arg == "--rom")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing name for rom flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            romName = std::string(argv[i + 1]);
+        }
     }
-    std::ifstream file(inputFilename, std::ios::binary);
-    if (!file.is_open())
+    std::vector<uint8_t> bytes;
+    // rom from a pack is used straight from the mapping, which stays open until the emulator exits
+    std::unique_ptr<RomPack> pack;
+    size_t romIndex = 0;
+    SymbolTable symbols;
+    std::filesystem::file_time_type lastWriteTime;
+    if (!watchFilename.empty())
+    {
+        // assemble the source directly instead of reading the binary and reload it whenever it changes
+        std::error_code error;
+        lastWriteTime = std::filesystem::last_write_time(watchFilename, error);
+        std::optional<std::vector<uint8_t>> program = assembleFile(watchFilename, symbols);
+        if (!program.has_value())
+        {
+            return EXIT_FAILURE;
+        }
+        bytes = program.value();
+    }
+    else if (!romName.empty())
+    {
+        try
+        {
+            pack = std::make_unique<RomPack>(inputFilename);
+            std::optional<size_t> index = pack->find(romName);
+            if (!index.has_value())
+            {
+                std::cerr << inputFilename << " does not contain " << romName << std::endl;
+                return EXIT_FAILURE;
+            }
+            romIndex = index.value();
+        }
+        catch (RomPackError const &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    else
     {
-        std::cerr << "Unable to open the input file" << std::endl;
-        return EXIT_FAILURE;
+        std::ifstream file(inputFilename, std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cerr << "Unable to open the input file" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // read the data:
+        bytes = std::vector<uint8_t>((std::istreambuf_iterator<char>(file)),
+                                     std::istreambuf_iterator<char>());
+
+        // symbols are optional, by default they are next to the binary
+        const bool symbolsRequested = !symbolsFilename.empty();
+        if (!symbolsRequested)
+        {
+            symbolsFilename = std::filesystem::path(inputFilename).replace_extension(".sym").string();
+        }
+        if (std::optional<SymbolTable> loaded = SymbolTable::loadFromFile(symbolsFilename); loaded.has_value())
+        {
+            symbols = loaded.value();
+        }
+        else if (symbolsRequested)
+        {
+            std::cerr << "Unable to load symbols from " << symbolsFilename << std::endl;
+        }
     }
+    std::vector<uint64_t> profileSamples(TOTAL_MEMORY_SIZE, 0);
+    bool haltReported = false;
 
-    // read the data:
-    std::vector<uint8_t> bytes = std::vector<uint8_t>((std::istreambuf_iterator<char>(file)),
-                                                      std::istreambuf_iterator<char>());
+    const std::span<const uint8_t> rom = pack != nullptr ? pack->getRom(romIndex) : std::span<const uint8_t>(bytes);
+    Machine machine(rom);
 
-    Machine machine(bytes);
+    // tracing and profiling need to see every instruction so they always use the interpreter
+    CompiledProgram const *native = nullptr;
+    if (!interpret && !trace && !profile)
+    {
+        native = CompiledProgram::find(rom);
+        if (native == nullptr && !cacheDirectory.empty())
+        {
+            try
+            {
+                native = TranslationCache(cacheDirectory).translate(rom, romName.empty() ? std::filesystem::path(inputFilename).filename().string() : romName);
+            }
+            catch (TranslationCacheError const &e)
+            {
+                std::cerr << e.what() << std::endl;
+            }
+        }
+        if (native != nullptr)
+        {
+            std::cout << "Running native code for " << native->getName() << std::endl;
+        }
+    }
+    // frames execute a single instruction, so the program is only compared again when something else writes memory
+    bool nativeIntact = native != nullptr;
 
     DisplaySDL display;
+    display.setPhosphorEnabled(phosphor);
+
+    // every emulated frame is recorded, even the ones turbo mode does not present
+    std::optional<VideoRecorder> recorder;
+    if (!recordFilename.empty())
+    {
+        try
+        {
+            recorder.emplace(recordFilename, frameCap);
+        }
+        catch (CaptureError const &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // presented frames are published for other processes, see SharedStateReader
+    std::optional<SharedStateWriter> exporter;
+    if (!exportName.empty())
+    {
+        try
+        {
+            exporter.emplace(exportName, 1);
+        }
+        catch (SharedStateError const &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    uint64_t emulatedFrames = 0;
+
+    // metrics are written to stderr unless a file is given
+    std::ofstream metricsFile;
+    std::ostream *metricsStream = nullptr;
+    if (!metricsFilename.empty())
+    {
+        metricsFile.open(metricsFilename);
+        if (!metricsFile.is_open())
+        {
+            std::cerr << "Unable to open metrics file " << metricsFilename << std::endl;
+            return EXIT_FAILURE;
+        }
+        metricsStream = &metricsFile;
+    }
+    else if (metricsEnabled)
+    {
+        metricsStream = &std::cerr;
+    }
+    Metrics metrics;
 
     SDL_Event e;
     bool quit = false;
     uint32_t timePrev = SDL_GetTicks();
     uint32_t timeNow = SDL_GetTicks();
     double delta = 0;
+    uint32_t lastWatchCheck = SDL_GetTicks();
     std::optional<uint8_t> lastKeyPressed;
+    // in turbo mode only one of this many emulated frames is presented, adjusted so that a presented frame takes about one display refresh
+    size_t turboFrameSkip = 1;
+    const uint32_t turboFrameTimeMs = 1000 / display.getRefreshRate();
+
+    // one frame of the emulated machine: timers advance and a single instruction is executed
+    auto emulateFrame = [&]()
+    {
+        if (!machine.beginFrame(lastKeyPressed.has_value() ? 1 << lastKeyPressed.value() : 0))
+        {
+            // the key was delivered if the machine stopped waiting
+            if (!machine.isAwaitingInput())
+            {
+                lastKeyPressed.reset();
+            }
+        }
+        else
+        {
+            const uint16_t programCounter = machine.getProgramCounter();
+            if (trace)
+            {
+                const uint16_t opcode = machine.getMemory().readWord(programCounter);
+                std::cerr << symbols.describe(programCounter) << ": " << std::hex << std::setw(4) << std::setfill('0') << opcode << std::dec << std::endl;
+            }
+            if (profile)
+            {
+                profileSamples[programCounter]++;
+            }
+            if (native != nullptr)
+            {
+                native->run(machine, 1, nativeIntact);
+            }
+            else
+            {
+                machine.step();
+            }
+            metrics.addInstructions(1);
+            if (machine.isHalted() && !haltReported)
+            {
+                dumpMachineState(machine, symbols, programCounter);
+                haltReported = true;
+            }
+        }
+        if (recorder.has_value())
+        {
+            recorder->pushFrame(machine.getCurrentVideoMemory());
+        }
+        emulatedFrames++;
+    };
+    auto presentFrame = [&]()
+    {
+        Metrics::Clock::time_point start = Metrics::Clock::now();
+        display.update(machine.getCurrentVideoMemory());
+        if (exporter.has_value())
+        {
+            exporter->publish(0, machine, emulatedFrames);
+        }
+        Metrics::Clock::time_point updated = Metrics::Clock::now();
+        display.render();
+        Metrics::Clock::time_point rendered = Metrics::Clock::now();
+        metrics.addStageTime(Metrics::Stage::Update, updated - start);
+        metrics.addStageTime(Metrics::Stage::Render, rendered - updated);
+        metrics.framePresented(rendered);
+        metrics.sampleAudioQueue(display.getQueuedAudioSize());
+    };
     while (!quit)
     {
         SDL_Event e;
@@ -109,7 +503,20 @@ int main(int argc, char **argv)
                 quit = true;
                 break;
             case SDL_KEYDOWN:
-
+                if (e.key.keysym.scancode == TurboKey && !e.key.repeat)
+                {
+                    turbo = !turbo;
+                    turboFrameSkip = 1;
+                    std::cout << "Turbo mode " << (turbo ? "on" : "off") << std::endl;
+                }
+                if (e.key.keysym.scancode == OverlayKey && !e.key.repeat)
+                {
+                    overlay = !overlay;
+                    if (!overlay)
+                    {
+                        display.hideOverlay();
+                    }
+                }
                 if (std::optional<uint8_t> inp = handleInput(e.key.keysym.scancode); inp.has_value())
                 {
                     if (machine.isAwaitingInput())
@@ -127,26 +534,61 @@ int main(int argc, char **argv)
                 break;
             }
         }
-        timeNow = SDL_GetTicks();
-        delta = timeNow - timePrev;
-        if (frameCap == 0 || delta > 1000.0 / (double)frameCap)
+        if (!watchFilename.empty() && SDL_GetTicks() - lastWatchCheck > WatchIntervalMs)
         {
-            machine.advanceTimers();
-            if (machine.isAwaitingInput())
+            lastWatchCheck = SDL_GetTicks();
+            std::error_code error;
+            std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(watchFilename, error);
+            if (!error && writeTime != lastWriteTime)
             {
-                if (lastKeyPressed.has_value())
+                lastWriteTime = writeTime;
+                if (std::optional<std::vector<uint8_t>> program = assembleFile(watchFilename, symbols); program.has_value())
                 {
-                    machine.receiveInput(lastKeyPressed.value());
-                    lastKeyPressed.reset();
+                    machine.loadProgram(program.value());
+                    nativeIntact = native != nullptr && native->matches(machine.getMemory());
+                    std::cout << "Reloaded " << watchFilename << " (" << program.value().size() << " bytes)" << std::endl;
                 }
             }
-            else
+        }
+        timeNow = SDL_GetTicks();
+        delta = timeNow - timePrev;
+        if (turbo)
+        {
+            if (machine.isHalted())
             {
-                machine.step();
+                // nothing left to fast forward
+                SDL_Delay(turboFrameTimeMs);
+            }
+            Metrics::Clock::time_point start = Metrics::Clock::now();
+            size_t frames = 0;
+            for (; frames < turboFrameSkip && !machine.isHalted(); frames++)
+            {
+                emulateFrame();
+            }
+            metrics.addStageTime(Metrics::Stage::Emulation, Metrics::Clock::now() - start);
+            metrics.addEmulatedFrames(frames);
+            // sound is muted since beeps would pile up far faster than they can be played
+            presentFrame();
+
+            const uint32_t frameTime = SDL_GetTicks() - timeNow;
+            if (frameTime < turboFrameTimeMs / 2 && turboFrameSkip < MaxTurboFrameSkip)
+            {
+                turboFrameSkip *= 2;
+            }
+            else if (frameTime > turboFrameTimeMs && turboFrameSkip > 1)
+            {
+                turboFrameSkip /= 2;
             }
+            timePrev = timeNow;
+        }
+        else if (frameCap == 0 || delta > 1000.0 / (double)frameCap)
+        {
+            Metrics::Clock::time_point start = Metrics::Clock::now();
+            emulateFrame();
+            metrics.addStageTime(Metrics::Stage::Emulation, Metrics::Clock::now() - start);
+            metrics.addEmulatedFrames(1);
 
-            display.update(machine.getCurrentVideoMemory());
-            display.render();
+            presentFrame();
 
             if (machine.shouldBeep())
             {
@@ -155,6 +597,34 @@ int main(int argc, char **argv)
             timePrev = timeNow;
             delta = 0;
         }
+        if (metrics.update(Metrics::Clock::now()))
+        {
+            if (metricsStream != nullptr)
+            {
+                metrics.writeReport(*metricsStream);
+            }
+            if (overlay)
+            {
+                Metrics::Report const &report = metrics.getReport();
+                std::vector<double> parts(report.stageFractions.begin(), report.stageFractions.end());
+                parts.push_back(report.idleFraction);
+                display.setOverlay(metrics.getSummary(), parts);
+            }
+        }
+    }
+    if (profile)
+    {
+        printProfile(profileSamples, symbols);
+    }
+    if (recorder.has_value())
+    {
+        recorder->stop();
+        std::cout << "Recorded " << recorder->getFrameCount() << " frames to " << recordFilename;
+        if (recorder->getDroppedFrameCount() > 0)
+        {
+            std::cout << ", " << recorder->getDroppedFrameCount() << " frames were dropped because the writer could not keep up";
+        }
+        std::cout << std::endl;
     }
     return EXIT_SUCCESS;
 }
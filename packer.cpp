@@ -0,0 +1,110 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <iomanip>
+
+#include "RomPack.hpp"
+
+/**
+ * @brief Add the file to the pack under its filename, directories add every file in them
+ *
+ * @return true If everything was added
+ */
+bool addPath(RomPackWriter &writer, std::filesystem::path const &path)
+{
+    if (std::filesystem::is_directory(path))
+    {
+        for (std::filesystem::directory_entry const &entry : std::filesystem::directory_iterator(path))
+        {
+            if (entry.is_regular_file() && !addPath(writer, entry.path()))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Unable to open " << path.string() << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    try
+    {
+        writer.add(path.filename().string(), bytes);
+    }
+    catch (RomPackError const &e)
+    {
+        std::cerr << path.string() << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    std::string outputFilename;
+    std::string listFilename;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = std::string(argv[i]);
+        if (arg == "-o" || arg == "--output" || arg == "-l" || arg == "--list")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing filename for " << arg << " flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            std::string value = std::string(argv[++i]);
+            if (arg == "-o" || arg == "--output")
+            {
+                outputFilename = value;
+            }
+            else
+            {
+                listFilename = value;
+            }
+        }
+        else
+        {
+            inputs.push_back(arg);
+        }
+    }
+    try
+    {
+        if (!listFilename.empty())
+        {
+            RomPack pack(listFilename);
+            std::cout << std::hex << std::setfill('0');
+            for (size_t i = 0; i < pack.getRomCount(); i++)
+            {
+                std::cout << std::setw(16) << pack.getHash(i) << " " << std::dec << std::setfill(' ') << std::setw(5) << pack.getRom(i).size()
+                          << " " << pack.getName(i) << std::hex << std::setfill('0') << std::endl;
+            }
+            return EXIT_SUCCESS;
+        }
+        if (outputFilename.empty() || inputs.empty())
+        {
+            std::cerr << "Usage: gob8pack -o <pack> <roms or directories>... or gob8pack -l <pack>" << std::endl;
+            return EXIT_FAILURE;
+        }
+        RomPackWriter writer;
+        for (std::string const &input : inputs)
+        {
+            if (!addPath(writer, input))
+            {
+                return EXIT_FAILURE;
+            }
+        }
+        writer.write(outputFilename);
+        std::cout << "Packed " << writer.getRomCount() << " roms into " << outputFilename << std::endl;
+    }
+    catch (RomPackError const &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+
+#include "Recompiler.hpp"
+
+int main(int argc, char **argv)
+{
+    std::string inputFilename = "./game.bin";
+    std::string outputFilename;
+    std::string name;
+    for (int i = 0; i < argc; i++)
+    {
+        std::string arg = std::string(argv[i]);
+        if (arg == "-i" || arg == "--input")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing filename for input flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            inputFilename = std::string(argv[i + 1]);
+        }
+        if (arg == "-o" || arg == "--output")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing filename for output flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            outputFilename = std::string(argv[i + 1]);
+        }
+        if (arg == "-n" || arg == "--name")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for name flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            name = std::string(argv[i + 1]);
+        }
+    }
+    if (outputFilename.empty())
+    {
+        outputFilename = std::filesystem::path(inputFilename).replace_extension(".cpp").string();
+    }
+    if (name.empty())
+    {
+        name = std::filesystem::path(inputFilename).filename().string();
+    }
+
+    std::ifstream file(inputFilename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Unable to open the input file" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (bytes.empty())
+    {
+        std::cerr << "Input file is empty" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream output(outputFilename);
+    if (!output.is_open())
+    {
+        std::cerr << "Unable to open the output file" << std::endl;
+        return EXIT_FAILURE;
+    }
+    Recompiler recompiler;
+    recompiler.generate(bytes, name, output);
+    std::cout << "Translated " << recompiler.getBlockCount() << " blocks (" << recompiler.getCodeSize() << " of " << bytes.size() << " bytes)" << std::endl;
+    if (recompiler.hasIndirectJumps())
+    {
+        std::cout << "Program uses jumps by register, code that is only reachable through them runs in the interpreter" << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
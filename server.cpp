@@ -0,0 +1,72 @@
+#include <iostream>
+#include <csignal>
+
+#include "MachineServer.hpp"
+
+/// @brief Server stopped by the signal handlers
+static MachineServer *RunningServer = nullptr;
+
+void handleStopSignal(int)
+{
+    if (RunningServer != nullptr)
+    {
+        RunningServer->stop();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string socketPath = "./gob8.sock";
+    std::string cacheDirectory;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = std::string(argv[i]);
+        if (arg == "-s" || arg == "--socket" || arg == "--cache")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << " flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            std::string value = std::string(argv[++i]);
+            if (arg == "--cache")
+            {
+                cacheDirectory = value;
+            }
+            else
+            {
+                socketPath = value;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown flag " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    try
+    {
+        MachineServer server;
+        if (!cacheDirectory.empty())
+        {
+            server.useTranslationCache(cacheDirectory);
+        }
+        server.listen(socketPath);
+        RunningServer = &server;
+        // without SA_RESTART the signal interrupts poll, so the server notices the request right away
+        struct sigaction action = {};
+        action.sa_handler = handleStopSignal;
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+        std::cout << "Listening on " << socketPath << std::endl;
+        server.run();
+        RunningServer = nullptr;
+        std::cout << "Stopped, " << server.getMachineCount() << " machines were still running" << std::endl;
+    }
+    catch (ServerError const &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+
+#include "SharedState.hpp"
+
+/// @brief How often the slot is checked for a new frame
+static const std::chrono::milliseconds PollInterval(10);
+
+/// @brief Draw the state as text, two rows of pixels per line using half blocks
+std::string describeState(SharedMachineState const &state, size_t slot)
+{
+    static const char *Blocks[] = {" ", "▀", "▄", "█"};
+    std::stringstream text;
+    for (size_t y = 0; y < 32; y += 2)
+    {
+        for (size_t x = 0; x < 64; x++)
+        {
+            text << Blocks[(state.video[y * 64 + x] ? 1 : 0) | (state.video[(y + 1) * 64 + x] ? 2 : 0)];
+        }
+        text << "\n";
+    }
+    text << "slot " << slot << " frame " << state.frame << std::hex << std::setfill('0') << " pc " << std::setw(3) << state.programCounter
+         << " i " << std::setw(3) << state.memoryRegister << " sp " << std::setw(3) << state.stackPointer << " dt " << std::setw(2) << (int)state.timer
+         << " st " << std::setw(2) << (int)state.audioTimer << (state.halted ? " halted" : "") << (state.awaitingInput ? " awaiting input" : "") << "\n";
+    for (size_t i = 0; i < state.registers.size(); i++)
+    {
+        text << "v" << i << " " << std::setw(2) << (int)state.registers[i] << (i % 8 == 7 ? "\n" : " ");
+    }
+    return text.str();
+}
+
+int main(int argc, char **argv)
+{
+    std::string name;
+    size_t slot = 0;
+    bool once = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = std::string(argv[i]);
+        if (arg == "--once")
+        {
+            once = true;
+        }
+        else if (arg == "-n" || arg == "--name" || arg == "--slot")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << " flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            std::string value = std::string(argv[++i]);
+            if (arg == "--slot")
+            {
+                slot = std::stoul(value);
+            }
+            else
+            {
+                name = value;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown flag " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (name.empty())
+    {
+        std::cerr << "Missing name of the shared state, use -n <name>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    try
+    {
+        SharedStateReader reader(name);
+        if (slot >= reader.getSlotCount())
+        {
+            std::cerr << "Slot " << slot << " does not exist, there are " << reader.getSlotCount() << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!once)
+        {
+            std::cout << "\x1b[2J";
+        }
+        uint64_t shownGeneration = UINT64_MAX;
+        while (true)
+        {
+            const uint64_t generation = reader.getGeneration(slot);
+            if (generation != shownGeneration)
+            {
+                std::optional<SharedMachineState> state = reader.read(slot);
+                if (state.has_value())
+                {
+                    shownGeneration = generation;
+                    // move the cursor home instead of clearing so that the picture does not flicker
+                    std::cout << (once ? "" : "\x1b[H") << describeState(state.value(), slot) << std::flush;
+                    if (once)
+                    {
+                        break;
+                    }
+                }
+            }
+            std::this_thread::sleep_for(PollInterval);
+        }
+    }
+    catch (SharedStateError const &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,423 @@
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Conformance.hpp"
+#include "MachineScheduler.hpp"
+#include "VectorEnvironment.hpp"
+
+/// @brief Steps every check runs a program for
+static const size_t StepsPerProgram = 200;
+
+/**
+ * @brief Generate a short program that waits for keys, reads timers, tests keys and loops, so that frontends hit every path of a frame.
+ * Machines stepped on different threads would draw different random numbers, so the program must never execute one. It has no calls and
+ * no jumps by a register, every jump lands on one of its instructions, memory is only written far above it and the end jumps back to the start
+ *
+ * @param random Source of the program
+ * @return std::vector<uint8_t> Bytes of the program
+ */
+std::vector<uint8_t> generateProgram(std::mt19937 &random)
+{
+    const size_t length = 16 + random() % 60;
+    std::vector<uint8_t> program;
+    for (size_t i = 0; i < length; i++)
+    {
+        uint16_t opcode = random();
+        if ((opcode >> 12) == 0xc || (opcode >> 12) == 0xe)
+        {
+            opcode &= 0x0fff;
+        }
+        if ((opcode >> 12) == 0x0)
+        {
+            // returns would pop whatever the memory holds
+            opcode = random() % 2 ? 0x00e0 : 0x00e2;
+        }
+        else if ((opcode >> 12) == 0x1 || (opcode >> 12) == 0x2 || (opcode >> 12) == 0xb)
+        {
+            opcode = 0x1000 | ((random() % length) * 2);
+        }
+        else if ((opcode >> 12) == 0xa)
+        {
+            opcode = 0xa800 | (random() % 0x700);
+        }
+        else if ((opcode >> 12) == 0xf)
+        {
+            // no instruction that moves the memory register, so writes through it stay above the program
+            static const uint8_t Operations[] = {0x07, 0x0a, 0x15, 0x18, 0x33, 0x55, 0x65};
+            opcode = (opcode & 0x0f00) | 0xf000 | Operations[random() % std::size(Operations)];
+        }
+        switch (random() % 16)
+        {
+        case 0:
+            opcode = 0xf00a | ((random() % 16) << 8);
+            break;
+        case 1:
+            opcode = 0xf007 | ((random() % 16) << 8);
+            break;
+        case 2:
+            opcode = 0xf015 | ((random() % 16) << 8);
+            break;
+        case 3:
+            // short loop backwards, the kind of idle loop run skips
+            opcode = 0x1000 | ((i - std::min<size_t>(i, random() % 3)) * 2);
+            break;
+        case 4:
+            if (i + 1 < length)
+            {
+                const uint8_t reg = random() % 4;
+                program.push_back(0x60 | reg);
+                program.push_back(random() % 4);
+                opcode = (random() % 2 ? 0xe09e : 0xe0a1) | (reg << 8);
+                i++;
+            }
+            break;
+        }
+        program.push_back(opcode >> 8);
+        program.push_back(opcode & 0xff);
+    }
+    // twice so that a skip on the last instruction lands on a jump as well
+    program.insert(program.end(), {0x10, 0x00, 0x10, 0x00});
+    return program;
+}
+
+/**
+ * @brief Run one frame the way the emulator does it, one instruction at a time
+ *
+ * @param machine Machine to run
+ * @param keys Keys held down during the frame
+ * @param instructionsPerFrame Instructions the frame executes
+ */
+void runReferenceFrame(Machine &machine, uint16_t keys, size_t instructionsPerFrame)
+{
+    machine.advanceTimers();
+    if (machine.isAwaitingInput())
+    {
+        for (uint8_t key = 0; key < 16; key++)
+        {
+            if ((keys >> key) & 1)
+            {
+                machine.receiveInput(key);
+                break;
+            }
+        }
+        return;
+    }
+    for (size_t i = 0; i < instructionsPerFrame && !machine.isHalted() && !machine.isAwaitingInput(); i++)
+    {
+        machine.stepReference();
+    }
+}
+
+/**
+ * @brief Step vector environments with random configurations and actions and compare every machine and observation with
+ * machines that are stepped one by one
+ *
+ * @param random Source of programs, configurations and actions
+ * @param programCount Number of programs to check
+ * @return size_t Number of programs that failed
+ */
+size_t checkEnvironment(std::mt19937 &random, size_t programCount)
+{
+    size_t failures = 0;
+    for (size_t programIndex = 0; programIndex < programCount; programIndex++)
+    {
+        const std::vector<uint8_t> program = generateProgram(random);
+        VectorEnvironment::Config config;
+        config.environmentCount = 1 + random() % 16;
+        config.framesPerStep = 1 + random() % 4;
+        config.instructionsPerFrame = 1 + random() % 8;
+        config.threadCount = 1 + random() % 4;
+        config.packedObservations = random() % 2;
+        VectorEnvironment environment(program, config);
+        std::vector<Machine> machines(config.environmentCount, Machine(program));
+        std::vector<uint16_t> actions(config.environmentCount);
+        std::optional<std::string> difference;
+        for (size_t step = 0; step < StepsPerProgram && !difference.has_value(); step++)
+        {
+            if (step == StepsPerProgram / 2)
+            {
+                const uint32_t resets[] = {0, (uint32_t)(random() % config.environmentCount)};
+                environment.reset(resets);
+                for (uint32_t index : resets)
+                {
+                    machines[index] = Machine(program);
+                }
+            }
+            for (uint16_t &action : actions)
+            {
+                action = random() % 4 == 0 ? random() : 0;
+            }
+            environment.step(actions);
+            for (size_t index = 0; index < machines.size() && !difference.has_value(); index++)
+            {
+                Machine &machine = machines[index];
+                for (uint8_t key = 0; key < 16; key++)
+                {
+                    machine.setKeyState(key, (actions[index] >> key) & 1);
+                }
+                for (size_t frame = 0; frame < config.framesPerStep && !machine.isHalted(); frame++)
+                {
+                    runReferenceFrame(machine, actions[index], config.instructionsPerFrame);
+                }
+                difference = MachineSnapshot::capture(machine).findDifference(MachineSnapshot::capture(environment.getMachine(index)));
+                const uint8_t *observation = environment.getObservations() + index * environment.getObservationStride();
+                Machine::VideoMemoryType const &video = machine.getCurrentVideoMemory();
+                for (size_t pixel = 0; pixel < video.size() && !difference.has_value(); pixel++)
+                {
+                    const uint8_t value = config.packedObservations ? (observation[pixel / 8] >> (pixel % 8)) & 1 : observation[pixel];
+                    if (value != (video[pixel] != 0))
+                    {
+                        difference = "observation of pixel " + std::to_string(pixel) + " is " + std::to_string(value);
+                    }
+                }
+                if (!difference.has_value() && environment.getHaltedFlags()[index] != machine.isHalted())
+                {
+                    difference = "halted flag is " + std::to_string(environment.getHaltedFlags()[index]);
+                }
+                if (difference.has_value())
+                {
+                    difference = "environment " + std::to_string(index) + " after step " + std::to_string(step) + ": " + difference.value();
+                }
+            }
+        }
+        if (difference.has_value())
+        {
+            std::cout << "FAIL environment program " << programIndex << ", " << difference.value() << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+/**
+ * @brief Run the machine for a number of instructions, advancing timers every 50 of them and answering key waits with a key that depends on the instruction
+ *
+ * @param machine Machine to run
+ * @param count Number of instructions
+ */
+void runInstructions(Machine &machine, size_t count)
+{
+    for (size_t i = 0; i < count && !machine.isHalted(); i++)
+    {
+        if (i % 50 == 0)
+        {
+            machine.advanceTimers();
+        }
+        if (machine.isAwaitingInput())
+        {
+            machine.receiveInput(i % 16);
+        }
+        else
+        {
+            machine.step();
+        }
+    }
+}
+
+/**
+ * @brief Reset machines and clones sharing their snapshot after random runs and compare them with a copy of the state reset returns to,
+ * then run the reset machine next to that copy to catch state reset forgot that only shows up later
+ *
+ * @param random Source of programs and run lengths
+ * @param programCount Number of programs to check
+ * @return size_t Number of programs that failed
+ */
+size_t checkReset(std::mt19937 &random, size_t programCount)
+{
+    size_t failures = 0;
+    for (size_t programIndex = 0; programIndex < programCount; programIndex++)
+    {
+        const std::vector<uint8_t> program = generateProgram(random);
+        Machine machine(program);
+        if (random() % 2 == 0)
+        {
+            runInstructions(machine, random() % 300);
+            machine.saveSnapshot();
+        }
+        Machine initial = machine;
+        const MachineSnapshot expected = MachineSnapshot::capture(initial);
+        std::optional<std::string> difference;
+        for (size_t round = 0; round < 3 && !difference.has_value(); round++)
+        {
+            runInstructions(machine, random() % 500);
+            Machine clone = machine;
+            machine.reset();
+            clone.reset();
+            if ((difference = expected.findDifference(MachineSnapshot::capture(machine))).has_value())
+            {
+                difference = "reset in round " + std::to_string(round) + ": " + difference.value();
+            }
+            else if ((difference = expected.findDifference(MachineSnapshot::capture(clone))).has_value())
+            {
+                difference = "reset of the clone in round " + std::to_string(round) + ": " + difference.value();
+            }
+            else
+            {
+                Machine reset = machine;
+                Machine reference = initial;
+                runInstructions(reset, StepsPerProgram);
+                runInstructions(reference, StepsPerProgram);
+                if ((difference = MachineSnapshot::capture(reference).findDifference(MachineSnapshot::capture(reset))).has_value())
+                {
+                    difference = "run after reset in round " + std::to_string(round) + ": " + difference.value();
+                }
+            }
+        }
+        if (difference.has_value())
+        {
+            std::cout << "FAIL reset program " << programIndex << ", " << difference.value() << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+/**
+ * @brief Run sessions of a scheduler with random key events and compare every session that is runnable after a frame with a machine
+ * that runs every frame the way the emulator does. Sleeping sessions are behind until they wake up, so they are compared once they run again
+ *
+ * @param random Source of programs, frame lengths and key events
+ * @param programCount Number of programs to check
+ * @return size_t Number of programs that failed
+ */
+size_t checkScheduler(std::mt19937 &random, size_t programCount)
+{
+    size_t failures = 0;
+    for (size_t programIndex = 0; programIndex < programCount; programIndex++)
+    {
+        const size_t instructionsPerFrame = 1 + random() % 40;
+        MachineScheduler scheduler(instructionsPerFrame);
+        std::vector<MachineScheduler::SessionId> sessions;
+        std::vector<Machine> machines;
+        // key the emulator delivers on the next frame, the last one pressed while the machine waits for input
+        std::vector<std::optional<uint8_t>> lastPressed;
+        for (size_t i = 1 + random() % 8; i > 0; i--)
+        {
+            const std::vector<uint8_t> program = generateProgram(random);
+            sessions.push_back(scheduler.addSession(PagedMemory::createImage(program)));
+            machines.emplace_back(program);
+            lastPressed.emplace_back();
+        }
+        std::optional<std::string> difference;
+        for (size_t frame = 0; frame < StepsPerProgram * 2 && !difference.has_value(); frame++)
+        {
+            for (size_t index = 0; index < sessions.size(); index++)
+            {
+                if (random() % 20 == 0)
+                {
+                    const uint8_t key = random() % 4;
+                    const bool pressed = random() % 2;
+                    scheduler.setKeyState(sessions[index], key, pressed);
+                    if (pressed && machines[index].isAwaitingInput())
+                    {
+                        lastPressed[index] = key;
+                    }
+                    machines[index].setKeyState(key, pressed);
+                }
+            }
+            scheduler.runFrame();
+            for (size_t index = 0; index < sessions.size() && !difference.has_value(); index++)
+            {
+                Machine &machine = machines[index];
+                machine.advanceTimers();
+                if (machine.isAwaitingInput())
+                {
+                    if (lastPressed[index].has_value())
+                    {
+                        machine.receiveInput(lastPressed[index].value());
+                        lastPressed[index].reset();
+                    }
+                }
+                else
+                {
+                    for (size_t i = 0; i < instructionsPerFrame && !machine.isHalted() && !machine.isAwaitingInput(); i++)
+                    {
+                        machine.stepReference();
+                    }
+                }
+                if (scheduler.getState(sessions[index]) != MachineScheduler::SessionState::Runnable)
+                {
+                    continue;
+                }
+                Machine session = scheduler.getMachine(sessions[index]);
+                if ((difference = MachineSnapshot::capture(machine).findDifference(MachineSnapshot::capture(session))).has_value())
+                {
+                    difference = "session " + std::to_string(index) + " after frame " + std::to_string(frame) + ": " + difference.value();
+                }
+            }
+        }
+        if (difference.has_value())
+        {
+            std::cout << "FAIL scheduler program " << programIndex << ", " << difference.value() << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> checkNames;
+    size_t programCount = 50;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = std::string(argv[i]);
+        if (arg == "--programs" || arg == "--seed")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << " flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            std::string value = std::string(argv[++i]);
+            if (arg == "--programs")
+            {
+                programCount = std::stoul(value);
+            }
+            else
+            {
+                seed = std::stoul(value);
+            }
+        }
+        else
+        {
+            checkNames.push_back(arg);
+        }
+    }
+
+    const std::vector<std::pair<std::string, size_t (*)(std::mt19937 &, size_t)>> checks = {
+        {"environment", checkEnvironment},
+        {"reset", checkReset},
+        {"scheduler", checkScheduler}};
+    if (checkNames.empty())
+    {
+        for (auto const &[name, check] : checks)
+        {
+            checkNames.push_back(name);
+        }
+    }
+    size_t failures = 0;
+    for (std::string const &checkName : checkNames)
+    {
+        auto check = std::find_if(checks.begin(), checks.end(), [&](auto const &check)
+                                  { return check.first == checkName; });
+        if (check == checks.end())
+        {
+            std::cerr << "Unknown check " << checkName << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::mt19937 random(seed);
+        const size_t checkFailures = check->second(random, programCount);
+        if (checkFailures == 0)
+        {
+            std::cout << "PASS " << checkName << ": " << programCount << " programs" << std::endl;
+        }
+        failures += checkFailures;
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,98 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+
+#include "VideoCapture.hpp"
+
+int main(int argc, char **argv)
+{
+    std::string inputFilename = "./capture.g8v";
+    std::string outputFilename;
+    size_t scale = 1;
+    for (int i = 0; i < argc; i++)
+    {
+        std::string arg = std::string(argv[i]);
+        if (arg == "-i" || arg == "--input")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing filename for input flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            inputFilename = std::string(argv[i + 1]);
+        }
+        if (arg == "-o" || arg == "--output")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing filename for output flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            outputFilename = std::string(argv[i + 1]);
+        }
+        if (arg == "--scale")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for scale flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            scale = std::max(1ul, std::stoul(std::string(argv[i + 1])));
+        }
+    }
+    if (outputFilename.empty())
+    {
+        outputFilename = std::filesystem::path(inputFilename).replace_extension(".y4m").string();
+    }
+    // anything that is not y4m is written as raw 8 bit grayscale frames one after another
+    const bool y4m = std::filesystem::path(outputFilename).extension() == ".y4m";
+
+    std::ifstream input(inputFilename, std::ios::binary);
+    if (!input.is_open())
+    {
+        std::cerr << "Unable to open the input file" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::ofstream output(outputFilename, std::ios::binary);
+    if (!output.is_open())
+    {
+        std::cerr << "Unable to open the output file" << std::endl;
+        return EXIT_FAILURE;
+    }
+    size_t frameCount = 0;
+    try
+    {
+        VideoReader reader(input);
+        const size_t width = reader.getWidth() * scale;
+        const size_t height = reader.getHeight() * scale;
+        if (y4m)
+        {
+            output << "YUV4MPEG2 W" << width << " H" << height << " F" << std::max<uint16_t>(reader.getFramesPerSecond(), 1) << ":1 Ip A1:1 Cmono\n";
+        }
+        VideoCapture::FrameType frame;
+        std::vector<uint8_t> image(width * height);
+        while (reader.readFrame(frame))
+        {
+            for (size_t y = 0; y < height; y++)
+            {
+                for (size_t x = 0; x < width; x++)
+                {
+                    image[y * width + x] = frame[(y / scale) * reader.getWidth() + x / scale] ? 255 : 0;
+                }
+            }
+            if (y4m)
+            {
+                output << "FRAME\n";
+            }
+            output.write((const char *)image.data(), image.size());
+            frameCount++;
+        }
+    }
+    catch (CaptureError const &e)
+    {
+        std::cerr << inputFilename << ": " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Converted " << frameCount << " frames" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,213 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+#include "TiledDisplaySDL.hpp"
+#include "MachineScheduler.hpp"
+#include "Assembler.hpp"
+#include "Keymap.hpp"
+#include "SharedState.hpp"
+
+/// @brief Machines advance at the rate of their timers no matter how fast the display refreshes
+static const uint32_t FrameRate = 60;
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> inputFilenames;
+    size_t count = 16;
+    size_t instructionsPerFrame = 1;
+    int columns = 0;
+    int scale = 0;
+    std::string exportName;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = std::string(argv[i]);
+        if (arg == "-i" || arg == "--input" || arg == "-n" || arg == "--count" || arg == "--columns" || arg == "--scale" || arg == "--instructions-per-frame" ||
+            arg == "--export")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << " flag" << std::endl;
+                return EXIT_FAILURE;
+            }
+            std::string value = std::string(argv[++i]);
+            if (arg == "-i" || arg == "--input")
+            {
+                inputFilenames.push_back(value);
+            }
+            else if (arg == "-n" || arg == "--count")
+            {
+                count = std::stoul(value);
+            }
+            else if (arg == "--columns")
+            {
+                columns = std::stoi(value);
+            }
+            else if (arg == "--scale")
+            {
+                scale = std::stoi(value);
+            }
+            else if (arg == "--export")
+            {
+                exportName = value;
+            }
+            else
+            {
+                instructionsPerFrame = std::stoul(value);
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown flag " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (inputFilenames.empty())
+    {
+        std::cerr << "Missing program, use -i <program>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (count == 0)
+    {
+        std::cerr << "Need at least one machine" << std::endl;
+        return EXIT_FAILURE;
+    }
+    // machines running the same program share its pages until they write to them
+    std::vector<std::shared_ptr<const PagedMemory::Image>> images;
+    for (std::string const &filename : inputFilenames)
+    {
+        std::optional<std::vector<uint8_t>> program = assembleOrLoad(filename);
+        if (!program.has_value())
+        {
+            return EXIT_FAILURE;
+        }
+        if (program.value().size() > TOTAL_MEMORY_SIZE)
+        {
+            std::cerr << filename << " does not fit into memory" << std::endl;
+            return EXIT_FAILURE;
+        }
+        images.push_back(PagedMemory::createImage(program.value()));
+    }
+
+    MachineScheduler scheduler(instructionsPerFrame);
+    std::vector<MachineScheduler::SessionId> sessions;
+    for (size_t i = 0; i < count; i++)
+    {
+        sessions.push_back(scheduler.addSession(images[i % images.size()]));
+    }
+
+    try
+    {
+        TiledDisplaySDL display(count, columns, scale);
+        // every machine gets the slot with the same index as its tile
+        std::optional<SharedStateWriter> exporter;
+        if (!exportName.empty())
+        {
+            exporter.emplace(exportName, count);
+        }
+        display.setFocus(0);
+        // keys held down on the focused machine, released when the focus moves so that no machine is left with a stuck key
+        uint16_t heldKeys = 0;
+        auto releaseKeys = [&]()
+        {
+            for (uint8_t key = 0; key < 16; key++)
+            {
+                if (heldKeys & (1 << key))
+                {
+                    scheduler.setKeyState(sessions[display.getFocus().value()], key, false);
+                }
+            }
+            heldKeys = 0;
+        };
+
+        bool quit = false;
+        SDL_Event e;
+        uint32_t timePrev = SDL_GetTicks();
+        uint32_t lastReport = timePrev;
+        size_t reportFrames = 0;
+        size_t reportResumed = 0;
+        size_t reportDrawn = 0;
+        double reportFrameTime = 0;
+        while (!quit)
+        {
+            while (SDL_PollEvent(&e))
+            {
+                switch (e.type)
+                {
+                case SDL_QUIT:
+                    quit = true;
+                    break;
+                case SDL_MOUSEBUTTONDOWN:
+                    if (e.button.button == SDL_BUTTON_LEFT)
+                    {
+                        if (std::optional<size_t> tile = display.getTileAt(e.button.x, e.button.y); tile.has_value() && tile != display.getFocus())
+                        {
+                            releaseKeys();
+                            display.setFocus(tile);
+                        }
+                    }
+                    break;
+                case SDL_KEYDOWN:
+                    if (std::optional<uint8_t> inp = handleInput(e.key.keysym.scancode); inp.has_value())
+                    {
+                        heldKeys |= 1 << inp.value();
+                        scheduler.setKeyState(sessions[display.getFocus().value()], inp.value(), true);
+                    }
+                    break;
+                case SDL_KEYUP:
+                    if (std::optional<uint8_t> inp = handleInput(e.key.keysym.scancode); inp.has_value())
+                    {
+                        heldKeys &= ~(1 << inp.value());
+                        scheduler.setKeyState(sessions[display.getFocus().value()], inp.value(), false);
+                    }
+                    break;
+                }
+            }
+            const uint32_t timeNow = SDL_GetTicks();
+            if (timeNow - timePrev < 1000 / FrameRate)
+            {
+                SDL_Delay(1);
+                continue;
+            }
+            timePrev = timeNow;
+            const uint64_t start = SDL_GetPerformanceCounter();
+            reportResumed += scheduler.runFrame();
+            // machines that were not resumed still have the same video, comparing it is cheaper than tracking them
+            for (size_t i = 0; i < sessions.size(); i++)
+            {
+                Machine const &machine = scheduler.getMachine(sessions[i]);
+                display.update(i, machine.getCurrentVideoMemory());
+                if (exporter.has_value())
+                {
+                    exporter->publish(i, machine, scheduler.getFrame());
+                }
+            }
+            display.render();
+            reportFrameTime += (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+            reportDrawn += display.getDrawnTileCount();
+            reportFrames++;
+            if (timeNow - lastReport >= 1000)
+            {
+                std::stringstream title;
+                title << std::fixed << std::setprecision(1) << count << " machines, " << reportResumed / (double)reportFrames << " running, "
+                      << reportDrawn / (double)reportFrames << " drawn, " << reportFrameTime * 1000 / reportFrames << " ms per frame, focus "
+                      << display.getFocus().value();
+                display.setTitle(title.str());
+                lastReport = timeNow;
+                reportFrames = reportResumed = reportDrawn = 0;
+                reportFrameTime = 0;
+            }
+        }
+    }
+    catch (DisplayError const &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    catch (SharedStateError const &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}